@@ -741,21 +741,108 @@ WILC_Uint8 get_current_channel(WILC_Uint8 *pu8msa, WILC_Uint16 u16RxLen)
 #endif /* PHY_802_11n */
 }
 
+/**
+*  @brief 			builds the IE offset table of a beacon/probe response
+*  @details 		Walks the IEs once and records the offset of the first occurrence of
+*				every element needed by the scan and join paths. Elements that are
+*				truncated by the end of the frame are ignored.
+*  @param[in] 	pu8IEs start of the IEs
+*  @param[in] 	u16IEsLen length of the IEs
+*  @param[out] 	pu16IEOffset offset table indexed by tenuIEOffset
+*  @return 		None
+*/
+void ParseIEsOffsets(WILC_Uint8* pu8IEs, WILC_Uint16 u16IEsLen, WILC_Uint16* pu16IEOffset)
+{
+	WILC_Uint16 u16Index = 0;
+	WILC_Uint8 u8ElemLen;
+	tenuIEOffset enuOffset;
+
+	for(enuOffset = IE_OFST_SSID; enuOffset < IE_OFST_MAX; enuOffset++)
+		pu16IEOffset[enuOffset] = IE_NOT_FOUND;
+
+	while(u16Index + IE_HDR_LEN <= u16IEsLen)
+	{
+		u8ElemLen = pu8IEs[u16Index + 1];
+		if(u16Index + IE_HDR_LEN + u8ElemLen > u16IEsLen)
+			break;
+
+		enuOffset = IE_OFST_MAX;
+		switch(pu8IEs[u16Index])
+		{
+			case ISSID:
+				enuOffset = IE_OFST_SSID;
+				break;
+			case ISUPRATES:
+				enuOffset = IE_OFST_SUPP_RATES;
+				break;
+			case IEXSUPRATES:
+				enuOffset = IE_OFST_EXT_SUPP_RATES;
+				break;
+			case IDSPARMS:
+				enuOffset = IE_OFST_DS_PARAMS;
+				break;
+			case ITIM:
+				enuOffset = IE_OFST_TIM;
+				break;
+			case IHTCAP:
+				enuOffset = IE_OFST_HT_CAP;
+				break;
+			case IRSNELEMENT:
+				enuOffset = IE_OFST_RSN;
+				break;
+			case IWPAELEMENT:
+				/* WMM Info/Param element: OUI 00:50:F2, type 2, subtype 0/1, version 1 */
+				if((u8ElemLen >= 7) &&
+				   (pu8IEs[u16Index + 2] == 0x00) && (pu8IEs[u16Index + 3] == 0x50) &&
+				   (pu8IEs[u16Index + 4] == 0xF2) && (pu8IEs[u16Index + 5] == 0x02) &&
+				   ((pu8IEs[u16Index + 6] == 0x00) || (pu8IEs[u16Index + 6] == 0x01)) &&
+				   (pu8IEs[u16Index + 7] == 0x01))
+				{
+					enuOffset = IE_OFST_WMM;
+				}
+				/* P2P element: OUI 50:6F:9A, type 9, starting with the NoA attribute */
+				else if((u8ElemLen >= 22) &&
+				        (pu8IEs[u16Index + 2] == 0x50) && (pu8IEs[u16Index + 3] == 0x6f) &&
+				        (pu8IEs[u16Index + 4] == 0x9a) && (pu8IEs[u16Index + 5] == 0x09) &&
+				        (pu8IEs[u16Index + 6] == 0x0c))
+				{
+					enuOffset = IE_OFST_P2P_NOA;
+				}
+				/* WPA element: OUI 00:50:F2, type 1 */
+				else if((u8ElemLen >= 4) &&
+				        (pu8IEs[u16Index + 2] == 0x00) && (pu8IEs[u16Index + 3] == 0x50) &&
+				        (pu8IEs[u16Index + 4] == 0xF2) && (pu8IEs[u16Index + 5] == 0x01))
+				{
+					enuOffset = IE_OFST_WPA;
+				}
+				break;
+			default:
+				break;
+		}
+
+		if((enuOffset != IE_OFST_MAX) && (pu16IEOffset[enuOffset] == IE_NOT_FOUND))
+			pu16IEOffset[enuOffset] = u16Index;
+
+		u16Index += IE_HDR_LEN + u8ElemLen;
+	}
+}
+
 /**
 *  @brief 			parses the received 'N' message
-*  @details 	
+*  @details 		The frame is parsed in place: the IEs of the returned Network Info
+*				point into pu8MsgBuffer and are only valid as long as the message buffer
+*				is. The IEs are copied once, when the network is added to the scan cache.
 *  @param[in] 	pu8MsgBuffer The message to be parsed
-*  @param[out] 	ppstrNetworkInfo pointer to pointer to the structure containing the parsed Network Info
+*  @param[out] 	pstrNetworkInfo structure to be filled with the parsed Network Info
 *  @return 		Error code indicating success/failure
 *  @note 		
 *  @author		mabubakr
 *  @date			1 Mar 2012
 *  @version		1.0
 */
-WILC_Sint32 ParseNetworkInfo(WILC_Uint8* pu8MsgBuffer, struct tstrNetworkInfo** ppstrNetworkInfo)
+WILC_Sint32 ParseNetworkInfo(WILC_Uint8* pu8MsgBuffer, struct tstrNetworkInfo* pstrNetworkInfo)
 {
 	WILC_Sint32 s32Error = WILC_SUCCESS;
-	struct tstrNetworkInfo* pstrNetworkInfo = WILC_NULL;
 	WILC_Uint8  u8MsgType = 0;
 	WILC_Uint8  u8MsgID = 0;
     WILC_Uint16 u16MsgLen = 0;
@@ -792,14 +879,16 @@ WILC_Sint32 ParseNetworkInfo(WILC_Uint8* pu8MsgBuffer, struct tstrNetworkInfo**
 	{		
 		WILC_Uint8  *pu8msa = 0;
 		WILC_Uint16 u16RxLen = 0;					
-		WILC_Uint8 *pu8TimElm = 0;
-		WILC_Uint8 *pu8IEs = 0;
-		WILC_Uint16 u16IEsLen = 0;
-		WILC_Uint8 u8index = 0;
+		WILC_Uint16 u16Offset;
 		WILC_Uint32 u32Tsf_Lo;
 		WILC_Uint32 u32Tsf_Hi;
-		
-		pstrNetworkInfo = (struct tstrNetworkInfo*)WILC_MALLOC(sizeof(struct tstrNetworkInfo));
+
+		if(u16WidLen < 1 + MAC_HDR_LEN + TIME_STAMP_LEN + BEACON_INTERVAL_LEN + CAP_INFO_LEN)
+		{
+			PRINT_ER("Received network info too short: %d\n", u16WidLen);
+			WILC_ERRORREPORT(s32Error, WILC_FAIL);
+		}
+
 		WILC_memset((void*)(pstrNetworkInfo), 0, sizeof(struct tstrNetworkInfo));
 
 		pstrNetworkInfo->s8rssi = pu8WidVal[0];
@@ -827,83 +916,45 @@ WILC_Sint32 ParseNetworkInfo(WILC_Uint8* pu8MsgBuffer, struct tstrNetworkInfo**
 		pstrNetworkInfo->u64Tsf = u32Tsf_Hi;
 		pstrNetworkInfo->u64Tsf = ((pstrNetworkInfo->u64Tsf) << 32) | u32Tsf_Lo;
 		
-		/* Get SSID */
-		get_ssid(pu8msa, pstrNetworkInfo->au8ssid, &(pstrNetworkInfo->u8SsidLen));
-		
 		/* Get BSSID */
 		get_BSSID(pu8msa, pstrNetworkInfo->au8bssid);
 
-		/* Get the current channel */
-		pstrNetworkInfo->u8channel = get_current_channel(pu8msa, (u16RxLen + FCS_LEN));
-		
 		/* Get beacon period */
-		u8index = (MAC_HDR_LEN + TIME_STAMP_LEN);
+		pstrNetworkInfo->u16BeaconPeriod = get_beacon_period(pu8msa + MAC_HDR_LEN + TIME_STAMP_LEN);
 
-		pstrNetworkInfo->u16BeaconPeriod = get_beacon_period(pu8msa + u8index);
+		pstrNetworkInfo->pu8IEs = &pu8msa[MAC_HDR_LEN + TIME_STAMP_LEN + BEACON_INTERVAL_LEN + CAP_INFO_LEN];
+		pstrNetworkInfo->u16IEsLen = u16RxLen - (MAC_HDR_LEN + TIME_STAMP_LEN + BEACON_INTERVAL_LEN + CAP_INFO_LEN);
 
-		u8index += BEACON_INTERVAL_LEN + CAP_INFO_LEN;
-
-		/* Get DTIM Period */
-        pu8TimElm = get_tim_elm(pu8msa, (u16RxLen + FCS_LEN), u8index);
-        if(pu8TimElm != 0)
-        {
-			pstrNetworkInfo->u8DtimPeriod = pu8TimElm[3];
-        }
-		pu8IEs = &pu8msa[MAC_HDR_LEN + TIME_STAMP_LEN + BEACON_INTERVAL_LEN + CAP_INFO_LEN];
-		u16IEsLen = u16RxLen - (MAC_HDR_LEN + TIME_STAMP_LEN + BEACON_INTERVAL_LEN + CAP_INFO_LEN);
+		/* Locate all the IEs needed in a single pass */
+		ParseIEsOffsets(pstrNetworkInfo->pu8IEs, pstrNetworkInfo->u16IEsLen, pstrNetworkInfo->au16IEOffset);
 
-		if(u16IEsLen > 0)
+		/* Get SSID */
+		u16Offset = pstrNetworkInfo->au16IEOffset[IE_OFST_SSID];
+		if((u16Offset != IE_NOT_FOUND) && (pstrNetworkInfo->pu8IEs[u16Offset + 1] < MAX_SSID_LEN))
 		{
-			pstrNetworkInfo->pu8IEs = (WILC_Uint8*)WILC_MALLOC(u16IEsLen);
-			WILC_memset((void*)(pstrNetworkInfo->pu8IEs), 0, u16IEsLen);
-			
-			WILC_memcpy(pstrNetworkInfo->pu8IEs, pu8IEs, u16IEsLen);
+			pstrNetworkInfo->u8SsidLen = pstrNetworkInfo->pu8IEs[u16Offset + 1];
+			WILC_memcpy(pstrNetworkInfo->au8ssid, &pstrNetworkInfo->pu8IEs[u16Offset + IE_HDR_LEN],
+						pstrNetworkInfo->u8SsidLen);
 		}
-		pstrNetworkInfo->u16IEsLen = u16IEsLen;
-		
-	}
-	
-	*ppstrNetworkInfo = pstrNetworkInfo;
+		pstrNetworkInfo->au8ssid[pstrNetworkInfo->u8SsidLen] = '\0';
 
-ERRORHANDLER:
-	return s32Error;
-}
-
-/**
-*  @brief 		Deallocates the parsed Network Info
-*  @details 	
-*  @param[in] 	pstrNetworkInfo Network Info to be deallocated
-*  @return 		Error code indicating success/failure
-*  @note 		
-*  @author		mabubakr
-*  @date		1 Mar 2012
-*  @version		1.0
-*/
-WILC_Sint32 DeallocateNetworkInfo(struct tstrNetworkInfo* pstrNetworkInfo)
-{
-	WILC_Sint32 s32Error = WILC_SUCCESS;
-	
-	if(pstrNetworkInfo != WILC_NULL)
-	{
-		if(pstrNetworkInfo->pu8IEs != WILC_NULL)
-		{
-			WILC_FREE(pstrNetworkInfo->pu8IEs);
-			pstrNetworkInfo->pu8IEs = WILC_NULL;
-		}
-		else
-		{
-			s32Error = WILC_FAIL;
-		}
-		
-		WILC_FREE(pstrNetworkInfo);
-		pstrNetworkInfo = WILC_NULL;
+		/* Get the current channel */
+#if defined(PHY_802_11n) && defined(FIVE_GHZ_BAND)
+		/* Not set in 802.11a beacons/probe responses, use the current RF channel */
+		pstrNetworkInfo->u8channel = get_rf_channel() + 1;
+#else
+		u16Offset = pstrNetworkInfo->au16IEOffset[IE_OFST_DS_PARAMS];
+		if((u16Offset != IE_NOT_FOUND) && (pstrNetworkInfo->pu8IEs[u16Offset + 1] >= 1))
+			pstrNetworkInfo->u8channel = pstrNetworkInfo->pu8IEs[u16Offset + 2];
+#endif /* PHY_802_11n && FIVE_GHZ_BAND */
 
-	}
-	else
-	{
-		s32Error = WILC_FAIL;
+		/* Get DTIM Period */
+		u16Offset = pstrNetworkInfo->au16IEOffset[IE_OFST_TIM];
+		if((u16Offset != IE_NOT_FOUND) && (pstrNetworkInfo->pu8IEs[u16Offset + 1] >= 2))
+			pstrNetworkInfo->u8DtimPeriod = pstrNetworkInfo->pu8IEs[u16Offset + 3];
 	}
 
+ERRORHANDLER:
 	return s32Error;
 }
 
@@ -145,6 +145,24 @@ struct tstrWID
     
 };
 
+/* Elements located by ParseIEsOffsets() in a received beacon/probe response */
+typedef enum {
+	IE_OFST_SSID = 0,
+	IE_OFST_SUPP_RATES,
+	IE_OFST_EXT_SUPP_RATES,
+	IE_OFST_DS_PARAMS,
+	IE_OFST_TIM,
+	IE_OFST_HT_CAP,
+	IE_OFST_RSN,
+	IE_OFST_WPA,
+	IE_OFST_WMM,
+	IE_OFST_P2P_NOA,
+	IE_OFST_MAX
+} tenuIEOffset;
+
+/* Marks an element that is not present in the IEs */
+#define IE_NOT_FOUND	0xFFFF
+
 typedef struct
 {
 	WILC_Uint8 u8Full;
@@ -173,9 +191,16 @@ struct tstrNetworkInfo
 #endif
     	WILC_Uint8 *pu8IEs;
 	WILC_Uint16 u16IEsLen;
+	/* Offsets of the elements of interest, relative to pu8IEs */
+	WILC_Uint16 au16IEOffset[IE_OFST_MAX];
 	void* pJoinParams;
 	tstrRSSI strRssi;
 	WILC_Uint64 u64Tsf; /* time-stamp [Low and High 64 bit] */
+	/* Change detection of the cached copy, used to skip re-reporting unchanged networks */
+	WILC_Uint32 u32IEsHash;
+	WILC_Uint8 u8Changed;
+	WILC_Sint8 s8RssiInformed;
+	unsigned long u32TimeInformed;
 };
 
 /* This structure is used to support parsing of the received Association Response frame */
@@ -227,8 +252,8 @@ extern WILC_Sint32 CoreConfiguratorDeInit(void);
 
 extern WILC_Sint32 SendConfigPkt(WILC_Uint8 u8Mode, struct tstrWID* pstrWIDs,
        WILC_Uint32 u32WIDsCount,WILC_Bool bRespRequired,WILC_Uint32 drvHandler);
-extern WILC_Sint32 ParseNetworkInfo(WILC_Uint8* pu8MsgBuffer, struct tstrNetworkInfo** ppstrNetworkInfo);
-extern WILC_Sint32 DeallocateNetworkInfo(struct tstrNetworkInfo* pstrNetworkInfo);
+extern void ParseIEsOffsets(WILC_Uint8* pu8IEs, WILC_Uint16 u16IEsLen, WILC_Uint16* pu16IEOffset);
+extern WILC_Sint32 ParseNetworkInfo(WILC_Uint8* pu8MsgBuffer, struct tstrNetworkInfo* pstrNetworkInfo);
 
 extern WILC_Sint32 ParseAssocRespInfo(WILC_Uint8* pu8Buffer, WILC_Uint32 u32BufferLen, 
 									      struct tstrConnectRespInfo** ppstrConnectRespInfo);
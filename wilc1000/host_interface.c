@@ -25,6 +25,7 @@
 #include "linux_wlan.h"
 #include <linux/kthread.h>
 #include <linux/semaphore.h>
+#include <linux/completion.h>
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/kernel.h>
@@ -93,12 +94,16 @@ extern WILC_Uint8 g_wilc_initialized;
 #define HOST_IF_MSG_SET_TX_POWER			((u16)38)
 #define HOST_IF_MSG_GET_TX_POWER			((u16)39)
 #define HOST_IF_MSG_SET_ANTENNA_MODE		((u16)40)
-#define HOST_IF_MSG_SEND_BUFFERED_EAP		((u16)41)
+#define HOST_IF_MSG_SCAN_NEXT_CHUNK			((u16)42)
+#define HOST_IF_MSG_INITIALIZED				((u16)43)
 
 #define HOST_IF_MSG_EXIT					((u16)100)
 
 #define HOST_IF_SCAN_TIMEOUT				4000
 #define HOST_IF_CONNECT_TIMEOUT				9500
+#define HOST_IF_REQ_TIMEOUT					5000
+/* everything queued before has to be handled, scans and connects included */
+#define HOST_IF_Q_IDLE_TIMEOUT				20000
 
 #define BA_SESSION_DEFAULT_BUFFER_SIZE		16
 #define BA_SESSION_DEFAULT_TIMEOUT			1000
@@ -156,17 +161,6 @@ struct tstrHostIFkeyAttr {
 	union tuniHostIFkeyAttr uniHostIFkeyAttr;
 };
 
-/*
- * Structure to hold Host IF Scan Attributes
- */
-struct tstrHostIFSendBufferedEAP {
-	tWILCpfFrmToLinux pfFrmToLinux;
-	tWILCpfFreeEAPBuffParams pfFreeEAPBuffParams;
-	u8 *pu8Buff;
-	unsigned int u32Size;
-	unsigned int u32PktOffset;
-	void *pvUserArg;
-};
 
 /*
  * Structure to hold Host IF Scan Attributes
@@ -333,10 +327,6 @@ struct tstrHostIFTxPwr
 {
 	u8 u8TxPwr;
 };
-struct tstrHostIFGetTxPwr
-{
-	u8* u8TxPwr;
-};
 
 /*
  * Message body for the Host Interface message_q
@@ -374,7 +364,6 @@ union tuniHostIFmsgBody {
 	struct tstrHostIFSetMulti strHostIfSetMulti;
 	struct tstrHostIfSetOperationMode strHostIfSetOperationMode;
 	struct tstrHostIfSetMacAddress strHostIfSetMacAddress;
-	struct tstrHostIfGetMacAddress strHostIfGetMacAddress;
 	struct tstrHostIfBASessionInfo strHostIfBASessionInfo;
 #ifdef WILC_P2P
 	struct tstrHostIfRemainOnChan strHostIfRemainOnChan;
@@ -382,9 +371,37 @@ union tuniHostIFmsgBody {
 #endif /* WILC_P2P */
 	char *pUserData;
 	struct tstrHostIFDelAllSta strHostIFDelAllSta;
-	struct tstrHostIFSendBufferedEAP strHostIFSendBufferedEAP;
 	struct tstrHostIFTxPwr strHostIFTxPwr;
-	struct tstrHostIFGetTxPwr strHostIFGetTxPwr;
+};
+
+/*
+ * Synchronous request: the caller waits on strDone and the handler
+ * leaves the result here. It is shared by reference between both, so a
+ * caller that timed out doesn't leave the handler writing into a stack
+ * frame that is gone.
+ */
+struct tstrHostIFreq {
+	struct completion strDone;
+	atomic_t s32Refs;
+	signed int s32Result;
+	ktime_t tStart;
+	union {
+		s8 s8Val;
+		u8 u8Val;
+		unsigned int u32Val;
+		u8 au8MacAddress[ETH_ALEN];
+		struct tstrStatistics strStatistics;
+	} uniResult;
+};
+
+/* Latency of the synchronous requests, per message ID */
+#define HOST_IF_REQ_STATS_MAX		64
+
+struct tstrHostIFreqStats {
+	unsigned int u32Count;
+	unsigned int u32Timeouts;
+	unsigned int u32MaxUs;
+	u64 u64SumUs;
 };
 
 /*
@@ -394,6 +411,25 @@ struct tstrHostIFmsg {
 	u16 u16MsgId; /* Message ID */
 	union tuniHostIFmsgBody uniHostIFmsgBody; /* Message body */
 	void *drvHandler;
+	struct tstrHostIFreq *pstrReq; /* NULL unless the sender waits */
+};
+
+/*
+ * Priority classes of the message queue, lowest value is served first.
+ * Messages keep their order inside a class only.
+ */
+enum tenuHostIFmsgClass {
+	HOST_IF_CLASS_SECURITY	= 0,	/* anything changing firmware or connection state */
+	HOST_IF_CLASS_USER	= 1,	/* read only queries from the upper layers */
+	HOST_IF_CLASS_SCAN	= 2,	/* scan results and scan scheduling */
+	HOST_IF_CLASS_STATS	= 3,	/* periodic refresh, queue drain, exit */
+	HOST_IF_CLASS_MAX	= WILC_MSG_QUEUE_PRIOS
+};
+
+/* Message held by the host IF thread until it can be handled */
+struct tstrHostIFparked {
+	struct list_head strList;
+	struct tstrHostIFmsg strHostIFmsg;
 };
 
 #ifdef CONNECT_DIRECT
@@ -468,7 +504,6 @@ static WILC_MsgQueueHandle gMsgQHostIF;
 static struct semaphore hSemHostIFthrdEnd;
 
 struct semaphore hSemDeinitDrvHandle;
-static struct semaphore hWaitResponse;
 struct semaphore hSemHostIntDeinit;
 struct timer_list g_hPeriodicRSSI;
 
@@ -482,13 +517,23 @@ static u8 gapu8RcvdAssocResp[MAX_ASSOC_RESP_FRAME_SIZE];
 
 bool gbScanWhileConnected = false;
 
-static s8 gs8Rssi = 0;
-static s8 gs8lnkspd = 0;
-static u8 gu8Chnl = 0;
+#ifdef WILC_SCAN_SCHEDULER
+/* Decaying count of networks found per channel, used to order the scan */
+static u8 gau8ChnlScore[SCAN_SCHED_MAX_CHNLS];
+static struct tstrScanSchedStats gstrScanSchedStats;
+#endif /* WILC_SCAN_SCHEDULER */
+
+static struct tstrHostIFreqStats gastrReqStats[HOST_IF_REQ_STATS_MAX];
+static DEFINE_SPINLOCK(gReqStatsLock);
+static const char * const gapcHostIFclass[HOST_IF_CLASS_MAX] = {
+	"security", "user", "scan", "stats"
+};
+/* only touched by the host IF thread */
+static LIST_HEAD(gHostIFparked);
+
 static u8 gs8SetIP[2][4] = {{0}};
 static u8 gs8GetIP[2][4] = {{0}};
 #ifdef WILC_AP_EXTERNAL_MLME
-static unsigned int gu32InactiveTime = 0;
 static u8 gu8DelBcn = 0;
 #endif /* WILC_AP_EXTERNAL_MLME */
 #ifndef SIMULATION
@@ -549,40 +594,10 @@ static struct WILC_WFIDrv *get_handler_from_id(int id){
 	return wfidrv_list[id]; 
 } 
 
-/*TicketId1001*/
-/*
- * Callback to frm_to_linux function to pass a buffered eapol frame
- */
-static signed int Handle_SendBufferedEAP(void *drvHandler,
-		   struct tstrHostIFSendBufferedEAP *pstrHostIFSendBufferedEAP)
-{
-	signed int s32Error = WILC_SUCCESS;
-
-	PRINT_D(HOSTINF_DBG, "Sending bufferd eapol to WPAS\n");
-
-	if (pstrHostIFSendBufferedEAP->pu8Buff == NULL)
-		WILC_ERRORREPORT(s32Error, WILC_INVALID_ARGUMENT);
-	if (pstrHostIFSendBufferedEAP->pfFrmToLinux)
-		pstrHostIFSendBufferedEAP->pfFrmToLinux(pstrHostIFSendBufferedEAP->pu8Buff
-							, pstrHostIFSendBufferedEAP->u32Size
-							, pstrHostIFSendBufferedEAP->u32PktOffset);
-
-	/*Call a fucntion to free allocated eapol buffers in priv struct*/
-	if (pstrHostIFSendBufferedEAP->pfFreeEAPBuffParams)
-		pstrHostIFSendBufferedEAP->pfFreeEAPBuffParams(pstrHostIFSendBufferedEAP->pvUserArg);
-
-	/*Free allocated buffer*/
-	if (pstrHostIFSendBufferedEAP->pu8Buff != NULL)	{
-		kfree(pstrHostIFSendBufferedEAP->pu8Buff);
-		pstrHostIFSendBufferedEAP->pu8Buff = NULL;
-	}
-
-	WILC_CATCH(s32Error){
-	}
-	return s32Error;
-}
-
 extern void chip_sleep_manually(WILC_Uint32 u32SleepTime);
+#ifdef WILC_SCAN_SCHEDULER
+extern int wilc_wlan_txq_pressure(uint32_t *pu32OldestMs);
+#endif /* WILC_SCAN_SCHEDULER */
 
 /*
  * Sending config packet to firmware to set channel
@@ -882,11 +897,309 @@ static signed int Handle_SetMacAddress(void *drvHandler,
 	return s32Error;
 }
 
+static u32 host_if_msg_class(struct tstrHostIFmsg *pstrHostIFmsg)
+{
+	switch (pstrHostIFmsg->u16MsgId) {
+	/* queries may overtake configuration, nothing depends on them */
+	case HOST_IF_MSG_GET_RSSI:
+	case HOST_IF_MSG_GET_CHNL:
+	case HOST_IF_MSG_GET_INACTIVETIME:
+	case HOST_IF_MSG_GET_LINKSPEED:
+	case HOST_IF_MSG_GET_MAC_ADDRESS:
+	case HOST_IF_MSG_GET_IPADDRESS:
+	case HOST_IF_MSG_GET_TX_POWER:
+		return HOST_IF_CLASS_USER;
+
+	case HOST_IF_MSG_RCVD_NTWRK_INFO:
+	case HOST_IF_MSG_RCVD_SCAN_COMPLETE:
+	case HOST_IF_MSG_SCAN_TIMER_FIRED:
+	case HOST_IF_MSG_SCAN_NEXT_CHUNK:
+		return HOST_IF_CLASS_SCAN;
+
+	case HOST_IF_MSG_GET_STATISTICS:
+		/* a waiting caller is user traffic, the periodic refresh is not */
+		if (pstrHostIFmsg->pstrReq != NULL)
+			return HOST_IF_CLASS_USER;
+		return HOST_IF_CLASS_STATS;
+
+	/* have to come after everything already queued */
+	case HOST_IF_MSG_Q_IDLE:
+	case HOST_IF_MSG_EXIT:
+		return HOST_IF_CLASS_STATS;
+
+	/*
+	 * keys and connect depend on stations, channel, mode and handler
+	 * set before them, so all of them share one class
+	 */
+	default:
+		return HOST_IF_CLASS_SECURITY;
+	}
+}
+
+static signed int host_if_msg_post(struct tstrHostIFmsg *pstrHostIFmsg)
+{
+	return WILC_MsgQueueSendPrio(&gMsgQHostIF, pstrHostIFmsg,
+				     sizeof(struct tstrHostIFmsg),
+				     host_if_msg_class(pstrHostIFmsg), WILC_NULL);
+}
+
+/*
+ * Returns true while pstrHostIFmsg can not be handled yet
+ */
+static bool host_if_msg_blocked(struct tstrHostIFmsg *pstrHostIFmsg)
+{
+	struct WILC_WFIDrv *pstrWFIDrv = pstrHostIFmsg->drvHandler;
+
+	if (!g_wilc_initialized)
+		return true;
+
+	/* connect has to wait for the scan on the same interface */
+	if (pstrHostIFmsg->u16MsgId == HOST_IF_MSG_CONNECT && pstrWFIDrv != NULL &&
+	    pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult != NULL)
+		return true;
+
+	return false;
+}
+
+static signed int host_if_msg_park(struct tstrHostIFmsg *pstrHostIFmsg)
+{
+	struct tstrHostIFparked *pstrParked;
+
+	pstrParked = kmalloc(sizeof(struct tstrHostIFparked), GFP_KERNEL);
+	if (pstrParked == NULL)
+		return WILC_NO_MEM;
+
+	memcpy(&pstrParked->strHostIFmsg, pstrHostIFmsg, sizeof(struct tstrHostIFmsg));
+	list_add_tail(&pstrParked->strList, &gHostIFparked);
+	return WILC_SUCCESS;
+}
+
+/*
+ * Takes the oldest parked message that can be handled now
+ */
+static bool host_if_msg_unpark(struct tstrHostIFmsg *pstrHostIFmsg)
+{
+	struct tstrHostIFparked *pstrParked;
+
+	list_for_each_entry(pstrParked, &gHostIFparked, strList) {
+		if (host_if_msg_blocked(&pstrParked->strHostIFmsg))
+			continue;
+
+		memcpy(pstrHostIFmsg, &pstrParked->strHostIFmsg, sizeof(struct tstrHostIFmsg));
+		list_del(&pstrParked->strList);
+		kfree(pstrParked);
+		return true;
+	}
+
+	return false;
+}
+
+static bool host_if_msg_pending(void)
+{
+	tstrWILC_MsgQueueStats strStats;
+	u32 u32Class;
+
+	for (u32Class = 0; u32Class < HOST_IF_CLASS_MAX; u32Class++) {
+		WILC_MsgQueueGetStats(&gMsgQHostIF, u32Class, &strStats, WILC_FALSE);
+		if (strStats.u32Depth)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Allocates a synchronous request, one reference for the caller and one
+ * for the handler
+ */
+static struct tstrHostIFreq *host_if_req_alloc(void)
+{
+	struct tstrHostIFreq *pstrReq;
+
+	pstrReq = kzalloc(sizeof(struct tstrHostIFreq), GFP_KERNEL);
+	if (pstrReq == NULL)
+		return NULL;
+
+	init_completion(&pstrReq->strDone);
+	atomic_set(&pstrReq->s32Refs, 2);
+	return pstrReq;
+}
+
+static void host_if_req_put(struct tstrHostIFreq *pstrReq)
+{
+	if (atomic_dec_and_test(&pstrReq->s32Refs))
+		kfree(pstrReq);
+}
+
+/*
+ * Called by the handler once the result is in place
+ */
+static void host_if_req_done(struct tstrHostIFreq *pstrReq, signed int s32Result)
+{
+	if (pstrReq == NULL)
+		return;
+
+	pstrReq->s32Result = s32Result;
+	complete(&pstrReq->strDone);
+	host_if_req_put(pstrReq);
+}
+
+/*
+ * Frees what the sender allocated for a connect message, the handler
+ * and the flush paths own it once it is queued
+ */
+static void host_if_connect_attr_free(struct tstrHostIFconnectAttr *pstrHostIFconnectAttr)
+{
+	kfree(pstrHostIFconnectAttr->pu8bssid);
+	pstrHostIFconnectAttr->pu8bssid = NULL;
+	kfree(pstrHostIFconnectAttr->pu8ssid);
+	pstrHostIFconnectAttr->pu8ssid = NULL;
+	kfree(pstrHostIFconnectAttr->pu8IEs);
+	pstrHostIFconnectAttr->pu8IEs = NULL;
+	host_int_freeJoinParams(pstrHostIFconnectAttr->pJoinParams);
+	pstrHostIFconnectAttr->pJoinParams = NULL;
+}
+
+/*
+ * Fails a message that will never reach its handler
+ */
+static void host_if_msg_drop(struct tstrHostIFmsg *pstrHostIFmsg)
+{
+	if (pstrHostIFmsg->u16MsgId == HOST_IF_MSG_CONNECT)
+		host_if_connect_attr_free(&pstrHostIFmsg->uniHostIFmsgBody.strHostIFconnectAttr);
+	host_if_req_done(pstrHostIFmsg->pstrReq, WILC_FAIL);
+}
+
+static void host_if_msg_flush_parked(void)
+{
+	struct tstrHostIFparked *pstrParked, *pstrTmp;
+
+	list_for_each_entry_safe(pstrParked, pstrTmp, &gHostIFparked, strList) {
+		list_del(&pstrParked->strList);
+		host_if_msg_drop(&pstrParked->strHostIFmsg);
+		kfree(pstrParked);
+	}
+}
+
+/*
+ * Fails the messages still queued behind HOST_IF_MSG_EXIT
+ */
+static void host_if_msg_flush_queued(void)
+{
+	struct tstrHostIFmsg strHostIFmsg;
+	unsigned int u32Ret;
+
+	while (host_if_msg_pending()) {
+		if (WILC_MsgQueueRecv(&gMsgQHostIF, &strHostIFmsg,
+				      sizeof(struct tstrHostIFmsg), &u32Ret,
+				      WILC_NULL) != WILC_SUCCESS)
+			break;
+		host_if_msg_drop(&strHostIFmsg);
+	}
+}
+
+/*
+ * Posts a message carrying pstrReq and waits up to u32TimeoutMs for
+ * its handler. The caller still owns its reference and reads the
+ * result from pstrReq->uniResult before dropping it.
+ */
+static signed int host_if_req_send(struct tstrHostIFmsg *pstrHostIFmsg,
+				   struct tstrHostIFreq *pstrReq,
+				   unsigned int u32TimeoutMs)
+{
+	struct tstrHostIFreqStats *pstrStats = NULL;
+	signed int s32Error;
+	unsigned int u32Us;
+	unsigned long flags;
+
+	if (pstrHostIFmsg->u16MsgId < HOST_IF_REQ_STATS_MAX)
+		pstrStats = &gastrReqStats[pstrHostIFmsg->u16MsgId];
+
+	pstrHostIFmsg->pstrReq = pstrReq;
+	pstrReq->tStart = ktime_get();
+	s32Error = host_if_msg_post(pstrHostIFmsg);
+	if (s32Error) {
+		PRINT_ER("Failed to send message %d to the message queue\n",
+			 pstrHostIFmsg->u16MsgId);
+		/* the handler will never get it */
+		host_if_req_put(pstrReq);
+		return WILC_FAIL;
+	}
+
+	if (!wait_for_completion_timeout(&pstrReq->strDone,
+					 msecs_to_jiffies(u32TimeoutMs))) {
+		PRINT_ER("Message %d timed out\n", pstrHostIFmsg->u16MsgId);
+		if (pstrStats != NULL) {
+			spin_lock_irqsave(&gReqStatsLock, flags);
+			pstrStats->u32Timeouts++;
+			spin_unlock_irqrestore(&gReqStatsLock, flags);
+		}
+		return WILC_TIMEOUT;
+	}
+
+	u32Us = (unsigned int)ktime_us_delta(ktime_get(), pstrReq->tStart);
+	if (pstrStats != NULL) {
+		spin_lock_irqsave(&gReqStatsLock, flags);
+		pstrStats->u32Count++;
+		pstrStats->u64SumUs += u32Us;
+		if (u32Us > pstrStats->u32MaxUs)
+			pstrStats->u32MaxUs = u32Us;
+		spin_unlock_irqrestore(&gReqStatsLock, flags);
+	}
+
+	return pstrReq->s32Result;
+}
+
+int host_int_req_stats(char *buf, int size)
+{
+	tstrWILC_MsgQueueStats strQStats;
+	int res = 0;
+	u16 i;
+
+	for (i = 0; i < HOST_IF_CLASS_MAX; i++) {
+		WILC_MsgQueueGetStats(&gMsgQHostIF, i, &strQStats, WILC_FALSE);
+		res += scnprintf(buf + res, size - res,
+				 "queue %s: depth %u max %u count %u avg wait %u us max wait %u us\n",
+				 gapcHostIFclass[i], strQStats.u32Depth,
+				 strQStats.u32MaxDepth, strQStats.u32Count,
+				 strQStats.u32Count ? (unsigned int)div_u64(strQStats.u64WaitUs, strQStats.u32Count) : 0,
+				 strQStats.u32MaxWaitUs);
+	}
+
+	for (i = 0; i < HOST_IF_REQ_STATS_MAX; i++) {
+		struct tstrHostIFreqStats *pstrStats = &gastrReqStats[i];
+
+		if (!pstrStats->u32Count && !pstrStats->u32Timeouts)
+			continue;
+		res += scnprintf(buf + res, size - res,
+				 "msg %u: count %u avg %u us max %u us timeouts %u\n",
+				 i, pstrStats->u32Count,
+				 pstrStats->u32Count ? (unsigned int)div_u64(pstrStats->u64SumUs, pstrStats->u32Count) : 0,
+				 pstrStats->u32MaxUs, pstrStats->u32Timeouts);
+	}
+
+	return res;
+}
+
+void host_int_req_stats_reset(void)
+{
+	tstrWILC_MsgQueueStats strQStats;
+	unsigned long flags;
+	u32 u32Class;
+
+	for (u32Class = 0; u32Class < HOST_IF_CLASS_MAX; u32Class++)
+		WILC_MsgQueueGetStats(&gMsgQHostIF, u32Class, &strQStats, WILC_TRUE);
+
+	spin_lock_irqsave(&gReqStatsLock, flags);
+	memset(gastrReqStats, 0, sizeof(gastrReqStats));
+	spin_unlock_irqrestore(&gReqStatsLock, flags);
+}
+
 /*
  * Getting mac address
  */
 static signed int Handle_GetMacAddress(void *drvHandler,
-				       struct tstrHostIfGetMacAddress *pstrHostIfGetMacAddress)
+				       struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrWID strWID;
@@ -904,7 +1217,7 @@ static signed int Handle_GetMacAddress(void *drvHandler,
 	
 	strWID.u16WIDid = (u16)WID_MAC_ADDR;
 	strWID.enuWIDtype = WID_STR;
-	strWID.ps8WidVal = pstrHostIfGetMacAddress->u8MacAddress;
+	strWID.ps8WidVal = pstrReq->uniResult.au8MacAddress;
 	strWID.s32ValueSize = ETH_ALEN;
 
 	s32Error = SendConfigPkt(GET_CFG, &strWID, 1, false, driver_handler_id);
@@ -915,7 +1228,7 @@ static signed int Handle_GetMacAddress(void *drvHandler,
 	WILC_CATCH(s32Error){
 
 	}
-	up(&hWaitResponse);
+	host_if_req_done(pstrReq, s32Error);
 
 	return s32Error;
 }
@@ -1249,15 +1562,325 @@ static signed int Handle_CfgParam(void *drvHandler,
 /*
  * this should be the last msg and then the msg Q becomes idle
  */
-static signed int Handle_wait_msg_q_empty(void)
+static signed int Handle_wait_msg_q_empty(struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 
 	g_wilc_initialized = 0;
-	up(&hWaitResponse);
+	host_if_req_done(pstrReq, s32Error);
 	return s32Error;
 }
 
+#ifdef WILC_SCAN_SCHEDULER
+/*
+ * Whether the request is long enough to be split in chunks
+ */
+static bool scan_sched_eligible(struct tstrHostIFscanAttr *pstrHostIFscanAttr)
+{
+	return (pstrHostIFscanAttr->u8ChnlListLen > SCAN_SCHED_CHUNK_LEN) &&
+	       (pstrHostIFscanAttr->u8ChnlListLen <= SCAN_SCHED_MAX_CHNLS);
+}
+
+/*
+ * Takes over the scan request if it can be scheduled by the host, the
+ * channels are ordered so that the ones with known networks come first
+ */
+static bool scan_sched_init(struct WILC_WFIDrv *pstrWFIDrv,
+			    struct tstrHostIFscanAttr *pstrHostIFscanAttr,
+			    u8 *pu8HdnNtwrksWidVal, unsigned int u32HdnNtwrksLen)
+{
+	struct tstrScanSched *pstrSched = &pstrWFIDrv->strScanSched;
+	u8 i, j, u8Chnl;
+
+	if (!scan_sched_eligible(pstrHostIFscanAttr) || (pu8HdnNtwrksWidVal == NULL))
+		return false;
+
+	for (i = 0; i < pstrHostIFscanAttr->u8ChnlListLen; i++)
+		if (pstrHostIFscanAttr->pu8ChnlFreqList[i] >= SCAN_SCHED_MAX_CHNLS)
+			return false;
+
+	/* insertion sort on the channel score, keeping the requested order on ties */
+	for (i = 0; i < pstrHostIFscanAttr->u8ChnlListLen; i++) {
+		u8Chnl = pstrHostIFscanAttr->pu8ChnlFreqList[i];
+		for (j = i; j > 0 && gau8ChnlScore[pstrSched->au8ChnlList[j - 1]] < gau8ChnlScore[u8Chnl]; j--)
+			pstrSched->au8ChnlList[j] = pstrSched->au8ChnlList[j - 1];
+		pstrSched->au8ChnlList[j] = u8Chnl;
+	}
+
+	/* age the scores so that networks which went away lose their priority */
+	pstrSched->u16KnownChnls = 0;
+	for (i = 0; i < SCAN_SCHED_MAX_CHNLS; i++) {
+		if (gau8ChnlScore[i])
+			pstrSched->u16KnownChnls |= BIT(i);
+		gau8ChnlScore[i] >>= 1;
+	}
+
+	pstrSched->u8ChnlCount = pstrHostIFscanAttr->u8ChnlListLen;
+	pstrSched->u8NextChnl = 0;
+	pstrSched->u8ScanSource = pstrHostIFscanAttr->u8ScanSource;
+	pstrSched->u8ScanType = pstrHostIFscanAttr->u8ScanType;
+	pstrSched->pu8IEs = pstrHostIFscanAttr->pu8IEs;
+	pstrSched->IEsLen = pstrHostIFscanAttr->IEsLen;
+	pstrSched->pu8HdnNtwrksWidVal = pu8HdnNtwrksWidVal;
+	pstrSched->u32HdnNtwrksLen = u32HdnNtwrksLen;
+	pstrSched->u32StartJiffies = jiffies;
+	pstrSched->bPaused = false;
+	pstrSched->u32PausedMs = 0;
+	pstrSched->bBusy = false;
+	pstrSched->bActive = true;
+
+	gstrScanSchedStats.u32Scans++;
+
+	return true;
+}
+
+/*
+ * Sends the next chunk of channels to the firmware
+ */
+static signed int scan_sched_send_chunk(struct WILC_WFIDrv *pstrWFIDrv)
+{
+	struct tstrScanSched *pstrSched = &pstrWFIDrv->strScanSched;
+	struct tstrWID strWIDList[6];
+	unsigned int u32WidsCount = 0;
+	bool bKnownChnl = false;
+	u8 i;
+
+	pstrSched->u8ChunkStart = pstrSched->u8NextChnl;
+	pstrSched->u8ChunkLen = pstrSched->u8ChnlCount - pstrSched->u8NextChnl;
+	if (pstrSched->u8ChunkLen > SCAN_SCHED_CHUNK_LEN)
+		pstrSched->u8ChunkLen = SCAN_SCHED_CHUNK_LEN;
+	pstrSched->u8NextChnl += pstrSched->u8ChunkLen;
+	pstrSched->u32ChunkRcvd = 0;
+
+	for (i = pstrSched->u8ChunkStart; i < pstrSched->u8NextChnl; i++)
+		if (pstrSched->u16KnownChnls & BIT(pstrSched->au8ChnlList[i]))
+			bKnownChnl = true;
+
+	if (bKnownChnl || pstrSched->bBusy) {
+		pstrSched->u16Dwell = SCAN_SCHED_DWELL_MAX;
+	} else {
+		pstrSched->u16Dwell = SCAN_SCHED_DWELL_MIN;
+		gstrScanSchedStats.u32ShortDwellChunks++;
+	}
+	gstrScanSchedStats.u32Chunks++;
+
+	PRINT_D(HOSTINF_DBG, "Scan chunk: %d channel(s) from ch %d, dwell %d ms\n",
+		pstrSched->u8ChunkLen, pstrSched->au8ChnlList[pstrSched->u8ChunkStart] + 1,
+		pstrSched->u16Dwell);
+
+	strWIDList[u32WidsCount].u16WIDid = (u16)WID_SSID_PROBE_REQ;
+	strWIDList[u32WidsCount].enuWIDtype = WID_STR;
+	strWIDList[u32WidsCount].ps8WidVal = pstrSched->pu8HdnNtwrksWidVal;
+	strWIDList[u32WidsCount].s32ValueSize = (signed int)pstrSched->u32HdnNtwrksLen;
+	u32WidsCount++;
+
+	strWIDList[u32WidsCount].u16WIDid = WID_INFO_ELEMENT_PROBE;
+	strWIDList[u32WidsCount].enuWIDtype = WID_BIN_DATA;
+	strWIDList[u32WidsCount].ps8WidVal = pstrSched->pu8IEs;
+	strWIDList[u32WidsCount].s32ValueSize = pstrSched->IEsLen;
+	u32WidsCount++;
+
+	strWIDList[u32WidsCount].u16WIDid = WID_SCAN_TYPE;
+	strWIDList[u32WidsCount].enuWIDtype = WID_CHAR;
+	strWIDList[u32WidsCount].s32ValueSize = sizeof(char);
+	strWIDList[u32WidsCount].ps8WidVal = (s8 *)(&(pstrSched->u8ScanType));
+	u32WidsCount++;
+
+	strWIDList[u32WidsCount].u16WIDid = WID_ACTIVE_SCAN_TIME;
+	strWIDList[u32WidsCount].enuWIDtype = WID_SHORT;
+	strWIDList[u32WidsCount].s32ValueSize = sizeof(u16);
+	strWIDList[u32WidsCount].ps8WidVal = (s8 *)(&(pstrSched->u16Dwell));
+	u32WidsCount++;
+
+	strWIDList[u32WidsCount].u16WIDid = WID_SCAN_CHANNEL_LIST;
+	strWIDList[u32WidsCount].enuWIDtype = WID_BIN_DATA;
+	strWIDList[u32WidsCount].ps8WidVal = &pstrSched->au8ChnlList[pstrSched->u8ChunkStart];
+	strWIDList[u32WidsCount].s32ValueSize = pstrSched->u8ChunkLen;
+	u32WidsCount++;
+
+	strWIDList[u32WidsCount].u16WIDid = WID_START_SCAN_REQ;
+	strWIDList[u32WidsCount].enuWIDtype = WID_CHAR;
+	strWIDList[u32WidsCount].s32ValueSize = sizeof(char);
+	strWIDList[u32WidsCount].ps8WidVal = (s8 *)(&(pstrSched->u8ScanSource));
+	u32WidsCount++;
+
+	/* the scan timeout guards each chunk rather than the whole scan */
+	pstrWFIDrv->hScanTimer.data = (unsigned long)pstrWFIDrv;
+	mod_timer(&(pstrWFIDrv->hScanTimer),
+		  (jiffies + msecs_to_jiffies(HOST_IF_SCAN_TIMEOUT)));
+
+	return SendConfigPkt(SET_CFG, strWIDList, u32WidsCount, false,
+			     pstrWFIDrv->driver_handler_id);
+}
+
+/*
+ * While connected, holds the next chunk back as long as the data path is
+ * backed up, within the pause budget of the scan, or DHCP is running. When
+ * held, the chunk timer polls again and the scan timeout is pushed out as it
+ * only guards the time the firmware spends on a chunk
+ */
+static bool scan_sched_hold(struct WILC_WFIDrv *pstrWFIDrv)
+{
+	struct tstrScanSched *pstrSched = &pstrWFIDrv->strScanSched;
+	unsigned int u32OldestMs = 0;
+	unsigned int u32Held = 0;
+	bool bWaitForIP = false;
+	bool bBusy;
+
+	if (pstrWFIDrv->enuHostIFstate != HOST_IF_CONNECTED)
+		return false;
+
+	bBusy = (wilc_wlan_txq_pressure(&u32OldestMs) > SCAN_SCHED_TXQ_DEPTH) ||
+		(u32OldestMs > SCAN_SCHED_TXQ_AGE);
+#ifdef DISABLE_PWRSAVE_AND_SCAN_DURING_IP
+	bWaitForIP = g_obtainingIP;
+#endif /* DISABLE_PWRSAVE_AND_SCAN_DURING_IP */
+
+	if (pstrSched->bPaused)
+		u32Held = jiffies_to_msecs(jiffies - pstrSched->u32PauseStart);
+
+	if (!bWaitForIP &&
+	    (!bBusy || (pstrSched->u32PausedMs + u32Held >= SCAN_SCHED_PAUSE_BUDGET))) {
+		if (bBusy)
+			gstrScanSchedStats.u32ForcedChunks++;
+		pstrSched->u32PausedMs += u32Held;
+		gstrScanSchedStats.u32PausedMs += u32Held;
+		pstrSched->bPaused = false;
+		return false;
+	}
+
+	if (!pstrSched->bPaused) {
+		if (bWaitForIP)
+			PRINT_D(HOSTINF_DBG, "Obtaining an IP, holding scan chunk\n");
+		else
+			PRINT_D(HOSTINF_DBG, "Data path busy (oldest TX frame %u ms), holding scan chunk\n",
+				u32OldestMs);
+		pstrSched->bPaused = true;
+		pstrSched->u32PauseStart = jiffies;
+		gstrScanSchedStats.u32Pauses++;
+	}
+
+	pstrSched->hChunkTimer.data = (unsigned long)pstrWFIDrv;
+	mod_timer(&(pstrSched->hChunkTimer),
+		  (jiffies + msecs_to_jiffies(SCAN_SCHED_PAUSE_POLL)));
+	pstrWFIDrv->hScanTimer.data = (unsigned long)pstrWFIDrv;
+	mod_timer(&(pstrWFIDrv->hScanTimer),
+		  (jiffies + msecs_to_jiffies(HOST_IF_SCAN_TIMEOUT)));
+
+	return true;
+}
+
+/*
+ * Releases the scheduler and restores the configured active dwell
+ */
+static void scan_sched_stop(struct WILC_WFIDrv *pstrWFIDrv)
+{
+	struct tstrScanSched *pstrSched = &pstrWFIDrv->strScanSched;
+	struct tstrWID strWID;
+
+	if (!pstrSched->bActive)
+		return;
+
+	pstrSched->bActive = false;
+	del_timer(&(pstrSched->hChunkTimer));
+
+	strWID.u16WIDid = WID_ACTIVE_SCAN_TIME;
+	strWID.enuWIDtype = WID_SHORT;
+	strWID.s32ValueSize = sizeof(u16);
+	strWID.ps8WidVal = (s8 *)(&(pstrWFIDrv->strCfgValues.active_scan_time));
+	if (SendConfigPkt(SET_CFG, &strWID, 1, false, pstrWFIDrv->driver_handler_id))
+		PRINT_ER("Failed to restore active scan time\n");
+
+	kfree(pstrSched->pu8IEs);
+	pstrSched->pu8IEs = NULL;
+	kfree(pstrSched->pu8HdnNtwrksWidVal);
+	pstrSched->pu8HdnNtwrksWidVal = NULL;
+}
+
+/*
+ * Called when the firmware is done with a chunk, returns true if the scan
+ * continues with another chunk
+ */
+static bool scan_sched_chunk_done(struct WILC_WFIDrv *pstrWFIDrv)
+{
+	struct tstrScanSched *pstrSched = &pstrWFIDrv->strScanSched;
+	unsigned int u32Duration;
+
+	if (!pstrSched->bActive)
+		return false;
+
+	if (pstrSched->u32ChunkRcvd == 0)
+		gstrScanSchedStats.u32EmptyChunks++;
+	else if (pstrSched->u16Dwell == SCAN_SCHED_DWELL_MIN)
+		pstrSched->bBusy = true;
+
+	if (pstrSched->u8NextChnl < pstrSched->u8ChnlCount) {
+		if (pstrWFIDrv->enuHostIFstate == HOST_IF_CONNECTED) {
+			/* go back to the operating channel for a while */
+			pstrSched->hChunkTimer.data = (unsigned long)pstrWFIDrv;
+			mod_timer(&(pstrSched->hChunkTimer),
+				  (jiffies + msecs_to_jiffies(SCAN_SCHED_CHUNK_GAP)));
+		} else if (scan_sched_send_chunk(pstrWFIDrv)) {
+			PRINT_ER("Failed to send scan chunk\n");
+			return false;
+		}
+		return true;
+	}
+
+	u32Duration = jiffies_to_msecs(jiffies - pstrSched->u32StartJiffies);
+	gstrScanSchedStats.u32LastDuration = u32Duration;
+	if (u32Duration > gstrScanSchedStats.u32MaxDuration)
+		gstrScanSchedStats.u32MaxDuration = u32Duration;
+	PRINT_D(HOSTINF_DBG, "Scan of %d channel(s) took %d ms\n",
+		pstrSched->u8ChnlCount, u32Duration);
+
+	return false;
+}
+
+/*
+ * Accounts a network found during a scheduled scan
+ */
+static void scan_sched_ntwrk_found(struct WILC_WFIDrv *pstrWFIDrv, u8 u8Chnl)
+{
+	/* channel numbers from the DS param IE start from 1 */
+	if (u8Chnl == 0 || u8Chnl > SCAN_SCHED_MAX_CHNLS)
+		return;
+
+	if (gau8ChnlScore[u8Chnl - 1] < 0xFF)
+		gau8ChnlScore[u8Chnl - 1]++;
+
+	if (pstrWFIDrv->strScanSched.bActive) {
+		pstrWFIDrv->strScanSched.u32ChunkRcvd++;
+		gstrScanSchedStats.au32ChnlResults[u8Chnl - 1]++;
+	}
+}
+
+int host_int_scan_sched_stats(char *buf, int size)
+{
+	int res;
+	int i;
+
+	res = scnprintf(buf, size, "scans: %u chunks: %u short dwell: %u empty: %u\n"
+			"held: %u for %u ms forced: %u\n"
+			"duration last: %u ms max: %u ms\nresults per channel:",
+			gstrScanSchedStats.u32Scans, gstrScanSchedStats.u32Chunks,
+			gstrScanSchedStats.u32ShortDwellChunks, gstrScanSchedStats.u32EmptyChunks,
+			gstrScanSchedStats.u32Pauses, gstrScanSchedStats.u32PausedMs,
+			gstrScanSchedStats.u32ForcedChunks,
+			gstrScanSchedStats.u32LastDuration, gstrScanSchedStats.u32MaxDuration);
+	for (i = 0; i < SCAN_SCHED_MAX_CHNLS; i++)
+		res += scnprintf(buf + res, size - res, " %u", gstrScanSchedStats.au32ChnlResults[i]);
+	res += scnprintf(buf + res, size - res, "\n");
+
+	return res;
+}
+
+void host_int_scan_sched_stats_reset(void)
+{
+	memset(&gstrScanSchedStats, 0, sizeof(gstrScanSchedStats));
+}
+#endif /* WILC_SCAN_SCHEDULER */
+
 /*
  * Sending config packet to firmware to set the scan params
  */
@@ -1382,6 +2005,15 @@ static signed int Handle_Scan(void *drvHandler,
 	else if (pstrWFIDrv->enuHostIFstate == HOST_IF_IDLE)
 		gbScanWhileConnected = false;
 
+#ifdef WILC_SCAN_SCHEDULER
+	if (scan_sched_init(pstrWFIDrv, pstrHostIFscanAttr, pu8HdnNtwrksWidVal, valuesize + 1)) {
+		/* the scheduler owns the probe IEs and hidden networks list till the scan is done */
+		pstrHostIFscanAttr->pu8IEs = NULL;
+		pu8HdnNtwrksWidVal = NULL;
+		if (!scan_sched_hold(pstrWFIDrv))
+			s32Error = scan_sched_send_chunk(pstrWFIDrv);
+	} else
+#endif /* WILC_SCAN_SCHEDULER */
 	s32Error = SendConfigPkt(SET_CFG, strWIDList, u32WidsCount, false, driver_handler_id);
 
 	if (s32Error) {
@@ -1472,6 +2104,10 @@ signed int Handle_ScanDone(void *drvHandler, enum tenuScanEvent enuEvent)
 		return s32Error;
 	}
 
+#ifdef WILC_SCAN_SCHEDULER
+	scan_sched_stop(pstrWFIDrv);
+#endif /* WILC_SCAN_SCHEDULER */
+
 	/*if there is an ongoing scan request*/	
 	if (pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult) {
 		pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult(enuEvent, NULL,
@@ -1483,6 +2119,16 @@ signed int Handle_ScanDone(void *drvHandler, enum tenuScanEvent enuEvent)
 	return s32Error;
 }
 
+/*
+ * Drops the statistics snapshot, it belongs to the link being left
+ */
+static void host_if_stats_invalidate(struct WILC_WFIDrv *pstrWFIDrv)
+{
+	down(&pstrWFIDrv->hSemStatsCache);
+	pstrWFIDrv->bStatsValid = false;
+	up(&pstrWFIDrv->hSemStatsCache);
+}
+
 /*
  * Sending config packet to firmware to starting connection
  */
@@ -1657,6 +2303,7 @@ static signed int Handle_Connect(void *drvHandler,
 	if (memcmp(pstrHostIFconnectAttr->pu8bssid, u8ConnectedSSID, ETH_ALEN) == 0) {
 		s32Error = WILC_SUCCESS;
 		PRINT_ER("Trying to connect to an already connected AP, Discard connect request\n");
+		host_if_connect_attr_free(pstrHostIFconnectAttr);
 		return s32Error;
 	}
 
@@ -1997,23 +2644,7 @@ static signed int Handle_Connect(void *drvHandler,
 	}
 
 	PRINT_D(HOSTINF_DBG, "Deallocating connection parameters\n");
-	/* Deallocate pstrHostIFconnectAttr->pu8bssid which was prevoisuly allocated by the sending thread */
-	if (pstrHostIFconnectAttr->pu8bssid != NULL) {
-		kfree(pstrHostIFconnectAttr->pu8bssid);
-		pstrHostIFconnectAttr->pu8bssid = NULL;
-	}
-
-	/* Deallocate pstrHostIFconnectAttr->pu8ssid which was prevoisuly allocated by the sending thread */
-	if (pstrHostIFconnectAttr->pu8ssid != NULL) {
-		kfree(pstrHostIFconnectAttr->pu8ssid);
-		pstrHostIFconnectAttr->pu8ssid = NULL;
-	}
-
-	/* Deallocate pstrHostIFconnectAttr->pu8IEs which was prevoisuly allocated by the sending thread */
-	if (pstrHostIFconnectAttr->pu8IEs != NULL) {
-		kfree(pstrHostIFconnectAttr->pu8IEs);
-		pstrHostIFconnectAttr->pu8IEs = NULL;
-	}
+	host_if_connect_attr_free(pstrHostIFconnectAttr);
 
 	if (pu8CurrByte != NULL)
 		kfree(pu8CurrByte);
@@ -2207,7 +2838,8 @@ static signed int Handle_RcvdNtwrkInfo(void *drvHandler,
 	bool bNewNtwrkFound;
 
 	signed int s32Error = WILC_SUCCESS;
-	struct tstrNetworkInfo *pstrNetworkInfo = NULL;
+	struct tstrNetworkInfo strNetworkInfo;
+	struct tstrNetworkInfo *pstrNetworkInfo = &strNetworkInfo;
 	void *pJoinParams = NULL;
 
 	struct WILC_WFIDrv *pstrWFIDrv  = (struct WILC_WFIDrv *)drvHandler;
@@ -2218,20 +2850,23 @@ static signed int Handle_RcvdNtwrkInfo(void *drvHandler,
 	/*if there is a an ongoing scan request*/
 	if (pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult) {
 		PRINT_D(HOSTINF_DBG, "State: Scanning, parsing network information received\n");
-		ParseNetworkInfo(pstrRcvdNetworkInfo->pu8Buffer, &pstrNetworkInfo);
-		if ((pstrNetworkInfo == NULL)
-		    || (pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult == NULL))
+		/* parsed in place, the IEs point into the received buffer */
+		if (ParseNetworkInfo(pstrRcvdNetworkInfo->pu8Buffer, pstrNetworkInfo) != WILC_SUCCESS)
 			WILC_ERRORREPORT(s32Error, WILC_INVALID_ARGUMENT);
 
+#ifdef WILC_SCAN_SCHEDULER
+		scan_sched_ntwrk_found(pstrWFIDrv, pstrNetworkInfo->u8channel);
+#endif /* WILC_SCAN_SCHEDULER */
+
 		/* check whether this network is discovered before */
 		for (i = 0; i < pstrWFIDrv->strWILC_UsrScanReq.u32RcvdChCount; i++) {
 			if ((pstrWFIDrv->strWILC_UsrScanReq.astrFoundNetworkInfo[i].au8bssid != NULL) &&
 			    (pstrNetworkInfo->au8bssid != NULL))
 				if (memcmp(pstrWFIDrv->strWILC_UsrScanReq.astrFoundNetworkInfo[i].au8bssid,
 					   pstrNetworkInfo->au8bssid, 6) == 0) {
-					if (pstrNetworkInfo->s8rssi <= pstrWFIDrv->strWILC_UsrScanReq.astrFoundNetworkInfo[i].s8rssi)	{
-						/*we have already found this network with better rssi, so keep the old cached one and don't 
-						*send anything to the upper layer 
+					if (pstrNetworkInfo->s8rssi < pstrWFIDrv->strWILC_UsrScanReq.astrFoundNetworkInfo[i].s8rssi + SCAN_RSSI_REPORT_DELTA) {
+						/*we have already found this network with better rssi, or the rssi improvement is too small
+						*to be worth reporting, so keep the old cached one and don't send anything to the upper layer
 						*/
 						PRINT_D(HOSTINF_DBG, "Network previously discovered\n");
 						goto done;
@@ -2295,12 +2930,6 @@ done:
 		pstrRcvdNetworkInfo->pu8Buffer = NULL;
 	}
 
-	/*free structure allocated*/
-	if (pstrNetworkInfo != NULL) {
-		DeallocateNetworkInfo(pstrNetworkInfo);
-		pstrNetworkInfo = NULL;
-	}
-
 	return s32Error;
 }
 
@@ -2475,6 +3104,8 @@ static signed int Handle_RcvdGnrlAsyncInfo(void *drvHandler,
 
 				PRINT_D(HOSTINF_DBG, "MAC status : CONNECTED and Connect Status : Successful\n");
 				pstrWFIDrv->enuHostIFstate = HOST_IF_CONNECTED;
+				/* don't serve the previous AP's statistics */
+				host_if_stats_invalidate(pstrWFIDrv);
 
 #ifdef DISABLE_PWRSAVE_AND_SCAN_DURING_IP
 				PRINT_D(GENERIC_DBG, "Obtaining an IP, Disable Scan\n");
@@ -2584,6 +3215,7 @@ static signed int Handle_RcvdGnrlAsyncInfo(void *drvHandler,
 			}
 
 			pstrWFIDrv->enuHostIFstate = HOST_IF_IDLE;
+			host_if_stats_invalidate(pstrWFIDrv);
 			gbScanWhileConnected = false;
 		} else if ((u8MacStatus == MAC_DISCONNECTED) &&
 			   (pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult != NULL)) {
@@ -3034,6 +3666,7 @@ static void Handle_Disconnect(void *drvHandler)
 		gbScanWhileConnected = false;
 
 		pstrWFIDrv->enuHostIFstate = HOST_IF_IDLE;
+		host_if_stats_invalidate(pstrWFIDrv);
 
 		memset(pstrWFIDrv->au8AssociatedBSSID, 0, ETH_ALEN);
 
@@ -3125,7 +3758,7 @@ static signed int Switch_Log_Terminal(void *drvHandler)
 /*
  * Sending config packet to get channel
  */
-static signed int Handle_GetChnl(void *drvHandler)
+static signed int Handle_GetChnl(void *drvHandler, struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrWID strWID;
@@ -3143,7 +3776,7 @@ static signed int Handle_GetChnl(void *drvHandler)
 	
 	strWID.u16WIDid = (u16)WID_CURRENT_CHANNEL;
 	strWID.enuWIDtype = WID_CHAR;
-	strWID.ps8WidVal = (s8 *)&gu8Chnl;
+	strWID.ps8WidVal = (s8 *)&pstrReq->uniResult.u8Val;
 	strWID.s32ValueSize = sizeof(char);
 
 	PRINT_D(HOSTINF_DBG, "Getting channel value\n");
@@ -3158,7 +3791,7 @@ static signed int Handle_GetChnl(void *drvHandler)
 	WILC_CATCH(s32Error){
 	}
 
-	up(&(pstrWFIDrv->hSemGetCHNL));
+	host_if_req_done(pstrReq, s32Error);
 
 	return s32Error;
 }
@@ -3166,7 +3799,7 @@ static signed int Handle_GetChnl(void *drvHandler)
 /*
  * Sending config packet to get RSSI
  */
-static void Handle_GetRssi(void *drvHandler)
+static void Handle_GetRssi(void *drvHandler, struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrWID strWID;
@@ -3184,7 +3817,7 @@ static void Handle_GetRssi(void *drvHandler)
 	
 	strWID.u16WIDid = (u16)WID_RSSI;
 	strWID.enuWIDtype = WID_CHAR;
-	strWID.ps8WidVal = &gs8Rssi;
+	strWID.ps8WidVal = &pstrReq->uniResult.s8Val;
 	strWID.s32ValueSize = sizeof(char);
 
 	/*Sending Cfg*/
@@ -3199,10 +3832,10 @@ static void Handle_GetRssi(void *drvHandler)
 	WILC_CATCH(s32Error){
 	}
 
-	up(&(pstrWFIDrv->hSemGetRSSI));
+	host_if_req_done(pstrReq, s32Error);
 }
 
-static void Handle_GetLinkspeed(void *drvHandler)
+static void Handle_GetLinkspeed(void *drvHandler, struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrWID strWID;
@@ -3218,11 +3851,11 @@ static void Handle_GetLinkspeed(void *drvHandler)
 		driver_handler_id = 0;
 	}
 	
-	gs8lnkspd = 0;
+	pstrReq->uniResult.s8Val = 0;
 
 	strWID.u16WIDid = (u16)WID_LINKSPEED;
 	strWID.enuWIDtype = WID_CHAR;
-	strWID.ps8WidVal = &gs8lnkspd;
+	strWID.ps8WidVal = &pstrReq->uniResult.s8Val;
 	strWID.s32ValueSize = sizeof(char);
 	/*Sending Cfg*/
 	PRINT_D(HOSTINF_DBG, "Getting LINKSPEED value\n");
@@ -3236,7 +3869,7 @@ static void Handle_GetLinkspeed(void *drvHandler)
 	WILC_CATCH(s32Error){
 	}
 
-	up(&(pstrWFIDrv->hSemGetLINKSPEED));
+	host_if_req_done(pstrReq, s32Error);
 }
 
 #ifdef TCP_ENHANCEMENTS
@@ -3245,14 +3878,31 @@ static void Handle_GetLinkspeed(void *drvHandler)
 extern void Enable_TCP_ACK_Filter(WILC_Bool value);
 #endif
 
-struct tstrStatistics gDummyStatistics;
+/*
+ * GetPeriodicRSSI() refreshes the statistics cache every STATS_PERIOD_MS,
+ * or every STATS_FAST_PERIOD_MS while it was read in the last
+ * STATS_READER_IDLE_MS.
+ */
+#define STATS_PERIOD_MS		5000
+#define STATS_FAST_PERIOD_MS	2000
+#define STATS_READER_IDLE_MS	10000
+#define STATS_STALE_MS		(2 * STATS_PERIOD_MS)
+
+/*
+ * Without a request this only refreshes the statistics cache
+ */
 signed int Handle_GetStatistics(void *drvHandler,
-				struct tstrStatistics *pstrStatistics)
+				struct tstrHostIFreq *pstrReq)
 {
 	struct tstrWID strWIDList[5];
 	uint32_t u32WidsCount = 0, s32Error = 0;
 	int driver_handler_id = 0;
 	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)drvHandler;
+	struct tstrStatistics strRefresh;
+	struct tstrStatistics *pstrStatistics = &strRefresh;
+
+	if (pstrReq != NULL)
+		pstrStatistics = &pstrReq->uniResult.strStatistics;
 
 	if(pstrWFIDrv != NULL)
 	{
@@ -3295,8 +3945,16 @@ signed int Handle_GetStatistics(void *drvHandler,
 
 	s32Error = SendConfigPkt(GET_CFG, strWIDList, u32WidsCount, false, driver_handler_id);
 
-	if (s32Error)
+	if (s32Error) {
 		PRINT_ER("Failed to send scan paramters config packet\n");
+	} else if (pstrWFIDrv != NULL) {
+		down(&pstrWFIDrv->hSemStatsCache);
+		pstrWFIDrv->strStatsCache = *pstrStatistics;
+		pstrWFIDrv->u32StatsStamp = jiffies;
+		/* a refresh finishing after a disconnect doesn't revive the cache */
+		pstrWFIDrv->bStatsValid = (pstrWFIDrv->enuHostIFstate == HOST_IF_CONNECTED);
+		up(&pstrWFIDrv->hSemStatsCache);
+	}
 	#ifdef TCP_ENHANCEMENTS
 	if((pstrStatistics->u8LinkSpeed > TCP_ACK_FILTER_LINK_SPEED_THRESH) && (pstrStatistics->u8LinkSpeed != DEFAULT_LINK_SPEED))
 	{
@@ -3309,8 +3967,7 @@ signed int Handle_GetStatistics(void *drvHandler,
 		Enable_TCP_ACK_Filter(WILC_FALSE);
 	}
 	#endif
-	if(pstrStatistics != &gDummyStatistics)
-		up(&hWaitResponse);
+	host_if_req_done(pstrReq, s32Error ? WILC_FAIL : WILC_SUCCESS);
 
 	return 0;
 }
@@ -3320,7 +3977,8 @@ signed int Handle_GetStatistics(void *drvHandler,
  * Sending config packet to set mac adddress for station and get inactive time
  */
 static signed int Handle_Get_InActiveTime(void *drvHandler,
-					  struct tstrHostIfStaInactive *strHostIfStaInactiveT)
+					  struct tstrHostIfStaInactive *strHostIfStaInactiveT,
+					  struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 	u8 *stamac;
@@ -3356,7 +4014,7 @@ static signed int Handle_Get_InActiveTime(void *drvHandler,
 
 	strWID.u16WIDid = (u16)WID_GET_INACTIVE_TIME;
 	strWID.enuWIDtype = WID_INT;
-	strWID.ps8WidVal = (s8 *)&gu32InactiveTime;
+	strWID.ps8WidVal = (s8 *)&pstrReq->uniResult.u32Val;
 	strWID.s32ValueSize = sizeof(unsigned int);
 
 	s32Error = SendConfigPkt(GET_CFG, &strWID, 1, true, driver_handler_id);
@@ -3366,12 +4024,11 @@ static signed int Handle_Get_InActiveTime(void *drvHandler,
 		WILC_ERRORREPORT(s32Error, WILC_FAIL);
 	}
 
-	PRINT_D(CFG80211_DBG, "Getting inactive time : %d\n", gu32InactiveTime);
-
-	up(&(pstrWFIDrv->hSemInactiveTime));
+	PRINT_D(CFG80211_DBG, "Getting inactive time : %d\n", pstrReq->uniResult.u32Val);
 
 	WILC_CATCH(s32Error){
 	}
+	host_if_req_done(pstrReq, s32Error);
 
 	return s32Error;
 }
@@ -3600,7 +4257,8 @@ static void Handle_AddStation(void *drvHandler,
  * Sending config packet to delete station
  */
 static void Handle_DelAllSta(void *drvHandler,
-			     struct tstrHostIFDelAllSta *pstrDelAllStaParam)
+			     struct tstrHostIFDelAllSta *pstrDelAllStaParam,
+			     struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrWID strWID;
@@ -3655,7 +4313,7 @@ static void Handle_DelAllSta(void *drvHandler,
 
 	if (strWID.ps8WidVal != NULL)
 		kfree(strWID.ps8WidVal);
-	up(&hWaitResponse);
+	host_if_req_done(pstrReq, s32Error);
 }
 
 /*
@@ -3983,8 +4641,7 @@ static void ListenTimerCB(unsigned long function_context)
 			  pstrWFIDrv->strHostIfRemainOnChan.u32ListenSessionID;
 
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 	WILC_CATCH(s32Error){
@@ -4191,7 +4848,8 @@ static signed int Handle_AddBASession(void *drvHandler,
  * Delete block ack session
  */
 static signed int Handle_DelBASession(void *drvHandler,
-				      struct tstrHostIfBASessionInfo *strHostIfBASessionInfo)
+				      struct tstrHostIfBASessionInfo *strHostIfBASessionInfo,
+				      struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrWID strWID;
@@ -4251,7 +4909,7 @@ static signed int Handle_DelBASession(void *drvHandler,
 	if (strWID.ps8WidVal != NULL)
 		kfree(strWID.ps8WidVal);
 
-	up(&hWaitResponse);
+	host_if_req_done(pstrReq, s32Error);
 
 	return s32Error;
 }
@@ -4293,7 +4951,7 @@ static signed int Handle_SetTxPwr(void * drvHandler, u8 u8TxPwr)
 	return s32Error;
 }
 
-static signed int Handle_GetTxPwr(void * drvHandler, u8* pu8TxPwr)
+static signed int Handle_GetTxPwr(void * drvHandler, struct tstrHostIFreq *pstrReq)
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrWID strWID;
@@ -4312,7 +4970,7 @@ static signed int Handle_GetTxPwr(void * drvHandler, u8* pu8TxPwr)
 	strWID.u16WIDid = WID_TX_POWER;
 	strWID.enuWIDtype= WID_CHAR;
 	strWID.s32ValueSize = sizeof(s8);
-	strWID.ps8WidVal = (s8*)(pu8TxPwr);
+	strWID.ps8WidVal = (s8*)&pstrReq->uniResult.u8Val;
 
 	s32Error = SendConfigPkt(GET_CFG, &strWID, 1, true, driver_handler_id);
 		
@@ -4321,7 +4979,7 @@ static signed int Handle_GetTxPwr(void * drvHandler, u8* pu8TxPwr)
 		PRINT_ER("Failed to send scan paramters config packet\n");
 		//WILC_ERRORREPORT(s32Error, s32Error);
 	}
-	up(&hWaitResponse);
+	host_if_req_done(pstrReq, s32Error);
 	return s32Error; 
 }
 
@@ -4358,39 +5016,39 @@ static int hostIFthread(void *pvArg)
 	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
 
 	while (1) {
-		WILC_MsgQueueRecv(&gMsgQHostIF, &strHostIFmsg,
-				 sizeof(struct tstrHostIFmsg), &u32Ret, WILC_NULL);
-		pstrWFIDrv = (struct WILC_WFIDrv *)strHostIFmsg.drvHandler;
-		if (strHostIFmsg.u16MsgId == HOST_IF_MSG_EXIT) {
-			PRINT_D(GENERIC_DBG, "THREAD: Exiting HostIfThread\n");
-			break;
-		}
-
-		/*Re-Queue HIF message*/
-		if ((!g_wilc_initialized)) {
-			PRINT_D(GENERIC_DBG, "--WAIT--");
-			msleep(200);
-			WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-					 sizeof(struct tstrHostIFmsg), WILC_NULL);
-			continue;
-		}
+		/* parked messages go first once they are unblocked */
+		if (!host_if_msg_unpark(&strHostIFmsg)) {
+			/* host_int_init posts HOST_IF_MSG_INITIALIZED to wake us */
+			WILC_MsgQueueRecv(&gMsgQHostIF, &strHostIFmsg,
+					 sizeof(struct tstrHostIFmsg), &u32Ret, WILC_NULL);
+			if (strHostIFmsg.u16MsgId == HOST_IF_MSG_EXIT) {
+				PRINT_D(GENERIC_DBG, "THREAD: Exiting HostIfThread\n");
+				host_if_msg_flush_parked();
+				host_if_msg_flush_queued();
+				break;
+			}
 
-		if (strHostIFmsg.u16MsgId == HOST_IF_MSG_CONNECT &&
-		    pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult != NULL) {
-			PRINT_D(HOSTINF_DBG, "Requeue connect request till scan done received\n");
-			WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-					 sizeof(struct tstrHostIFmsg), WILC_NULL);
-			usleep_range(2000, 2100);
-			continue;
+			if (host_if_msg_blocked(&strHostIFmsg)) {
+				PRINT_D(HOSTINF_DBG, "Park message %d till it can be handled\n",
+					strHostIFmsg.u16MsgId);
+				if (host_if_msg_park(&strHostIFmsg))
+					host_if_msg_drop(&strHostIFmsg);
+				continue;
+			}
 		}
+		pstrWFIDrv = (struct WILC_WFIDrv *)strHostIFmsg.drvHandler;
 
 		switch (strHostIFmsg.u16MsgId) {
 			case HOST_IF_MSG_Q_IDLE:
 			{
-				Handle_wait_msg_q_empty();
+				Handle_wait_msg_q_empty(strHostIFmsg.pstrReq);
 				break;
 			}
 
+			case HOST_IF_MSG_INITIALIZED:
+				/* nothing to do, parked messages are retried next */
+				break;
+
 			case HOST_IF_MSG_SCAN:
 			{
 				Handle_Scan(strHostIFmsg.drvHandler,
@@ -4455,6 +5113,11 @@ static int hostIFthread(void *pvArg)
 
 			case HOST_IF_MSG_RCVD_SCAN_COMPLETE:
 			{
+#ifdef WILC_SCAN_SCHEDULER
+				/* more channels to go, the scan is not done yet */
+				if (scan_sched_chunk_done(pstrWFIDrv))
+					break;
+#endif /* WILC_SCAN_SCHEDULER */
 				del_timer(&(pstrWFIDrv->hScanTimer));
 				PRINT_D(HOSTINF_DBG, "scan completed successfully\n");
 
@@ -4477,26 +5140,25 @@ static int hostIFthread(void *pvArg)
 
 			case HOST_IF_MSG_GET_RSSI:
 			{
-				Handle_GetRssi(strHostIFmsg.drvHandler);
+				Handle_GetRssi(strHostIFmsg.drvHandler, strHostIFmsg.pstrReq);
 				break;
 			}
 
 			case HOST_IF_MSG_GET_LINKSPEED:
 			{
-				Handle_GetLinkspeed(strHostIFmsg.drvHandler);
+				Handle_GetLinkspeed(strHostIFmsg.drvHandler, strHostIFmsg.pstrReq);
 				break;
 			}
 
 			case HOST_IF_MSG_GET_STATISTICS:
 			{
-				Handle_GetStatistics(strHostIFmsg.drvHandler,
-						     (struct tstrStatistics *)strHostIFmsg.uniHostIFmsgBody.pUserData);
+				Handle_GetStatistics(strHostIFmsg.drvHandler, strHostIFmsg.pstrReq);
 				break;
 			}
 
 			case HOST_IF_MSG_GET_CHNL:
 			{
-				Handle_GetChnl(strHostIFmsg.drvHandler);
+				Handle_GetChnl(strHostIFmsg.drvHandler, strHostIFmsg.pstrReq);
 				break;
 			}
 
@@ -4541,11 +5203,31 @@ static int hostIFthread(void *pvArg)
 			case HOST_IF_MSG_GET_INACTIVETIME:
 			{
 				Handle_Get_InActiveTime(strHostIFmsg.drvHandler,
-							&strHostIFmsg.uniHostIFmsgBody.strHostIfStaInactiveT);
+							&strHostIFmsg.uniHostIFmsgBody.strHostIfStaInactiveT,
+							strHostIFmsg.pstrReq);
 				break;
 			}
 
 	#endif /*WILC_AP_EXTERNAL_MLME*/
+#ifdef WILC_SCAN_SCHEDULER
+			case HOST_IF_MSG_SCAN_NEXT_CHUNK:
+			{
+				if (!pstrWFIDrv->strScanSched.bActive ||
+				    pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult == NULL)
+					break;
+
+				if (scan_sched_hold(pstrWFIDrv))
+					break;
+
+				if (scan_sched_send_chunk(pstrWFIDrv)) {
+					PRINT_ER("Failed to send scan chunk\n");
+					del_timer(&(pstrWFIDrv->hScanTimer));
+					Handle_ScanDone(strHostIFmsg.drvHandler, SCAN_EVENT_ABORTED);
+				}
+				break;
+			}
+#endif /* WILC_SCAN_SCHEDULER */
+
 			case HOST_IF_MSG_SCAN_TIMER_FIRED:
 			{
 				PRINT_INFO(HOSTINF_DBG, "Scan Timeout\n");
@@ -4613,8 +5295,7 @@ static int hostIFthread(void *pvArg)
 			/*BugID_5213*/
 			case HOST_IF_MSG_GET_MAC_ADDRESS:
 			{
-				Handle_GetMacAddress(strHostIFmsg.drvHandler,
-						     &strHostIFmsg.uniHostIFmsgBody.strHostIfGetMacAddress);
+				Handle_GetMacAddress(strHostIFmsg.drvHandler, strHostIFmsg.pstrReq);
 				break;
 			}
 
@@ -4659,19 +5340,22 @@ static int hostIFthread(void *pvArg)
 				break;
 			}
 
-			case HOST_IF_MSG_DEL_ALL_STA:
+			case HOST_IF_MSG_DEL_BA_SESSION:
 			{
-				Handle_DelAllSta(strHostIFmsg.drvHandler,
-						 &strHostIFmsg.uniHostIFmsgBody.strHostIFDelAllSta);
+				Handle_DelBASession(strHostIFmsg.drvHandler,
+						    &strHostIFmsg.uniHostIFmsgBody.strHostIfBASessionInfo,
+						    strHostIFmsg.pstrReq);
 				break;
 			}
 
-			case HOST_IF_MSG_SEND_BUFFERED_EAP:
+			case HOST_IF_MSG_DEL_ALL_STA:
 			{
-				Handle_SendBufferedEAP(strHostIFmsg.drvHandler,
-						       &strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP);
+				Handle_DelAllSta(strHostIFmsg.drvHandler,
+						 &strHostIFmsg.uniHostIFmsgBody.strHostIFDelAllSta,
+						 strHostIFmsg.pstrReq);
 				break;
 			}
+
 			case HOST_IF_MSG_SET_TX_POWER:
 			{
 				Handle_SetTxPwr(strHostIFmsg.drvHandler,strHostIFmsg.uniHostIFmsgBody.strHostIFTxPwr.u8TxPwr);
@@ -4680,7 +5364,7 @@ static int hostIFthread(void *pvArg)
 
 			case HOST_IF_MSG_GET_TX_POWER:
 			{
-				Handle_GetTxPwr(strHostIFmsg.drvHandler,strHostIFmsg.uniHostIFmsgBody.strHostIFGetTxPwr.u8TxPwr);
+				Handle_GetTxPwr(strHostIFmsg.drvHandler, strHostIFmsg.pstrReq);
 				break;
 			}
 			case HOST_IF_MSG_SET_ANTENNA_MODE:
@@ -4691,6 +5375,7 @@ static int hostIFthread(void *pvArg)
 			default:
 			{
 				PRINT_ER("[Host Interface] undefined Received Msg ID\n");
+				host_if_req_done(strHostIFmsg.pstrReq, WILC_FAIL);
 				break;
 			}
 		}
@@ -4714,74 +5399,33 @@ static void TimerCB_Scan(unsigned long function_context)
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_SCAN_TIMER_FIRED;
 
 	/* send the message */
-	WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-			 sizeof(struct tstrHostIFmsg), WILC_NULL);
+	host_if_msg_post(&strHostIFmsg);
 }
 
-static void TimerCB_Connect(unsigned long function_context)
+#ifdef WILC_SCAN_SCHEDULER
+static void TimerCB_ScanChunk(unsigned long function_context)
 {
 	struct tstrHostIFmsg strHostIFmsg;
 
-	/*prepare the Timer Callback message */
 	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
 	strHostIFmsg.drvHandler = (void *)function_context;
-	strHostIFmsg.u16MsgId = HOST_IF_MSG_CONNECT_TIMER_FIRED;
+	strHostIFmsg.u16MsgId = HOST_IF_MSG_SCAN_NEXT_CHUNK;
 
-	/* send the message */
-	WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-			 sizeof(struct tstrHostIFmsg), WILC_NULL);
+	host_if_msg_post(&strHostIFmsg);
 }
+#endif /* WILC_SCAN_SCHEDULER */
 
-/*
- * Sends a buffered eap to WPAS
- */
-signed int host_int_send_buffered_eap(struct WFIDrvHandle *hWFIDrv,
-				      tWILCpfFrmToLinux pfFrmToLinux,
-				      tWILCpfFreeEAPBuffParams pfFreeEAPBuffParams,
-				      u8 *pu8Buff, unsigned int u32Size,
-				      unsigned int u32PktOffset,
-				      void *pvUserArg)
+static void TimerCB_Connect(unsigned long function_context)
 {
-	signed int s32Error = WILC_SUCCESS;
-	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)hWFIDrv;
 	struct tstrHostIFmsg strHostIFmsg;
 
-	if (pstrWFIDrv == NULL || pfFrmToLinux == NULL || pfFreeEAPBuffParams == NULL)
-		WILC_ERRORREPORT(s32Error, WILC_INVALID_ARGUMENT);
-
-	/* prepare the Scan Message */
+	/*prepare the Timer Callback message */
 	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
-
-	strHostIFmsg.u16MsgId = HOST_IF_MSG_SEND_BUFFERED_EAP;
-	strHostIFmsg.drvHandler = hWFIDrv;
-	strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP.pfFrmToLinux = pfFrmToLinux;
-	strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP.pfFreeEAPBuffParams = pfFreeEAPBuffParams;
-	strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP.u32Size = u32Size;
-	strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP.u32PktOffset = u32PktOffset;
-	strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP.pu8Buff = kmalloc(u32Size + u32PktOffset, GFP_ATOMIC);
-	if(strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP.pu8Buff != NULL)
-	{
-		memcpy(strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP.pu8Buff, pu8Buff, u32Size + u32PktOffset);
-	}
-	else
-	{
-		WILC_ERRORREPORT(s32Error, WILC_NO_MEM);
-	}
-	
-	strHostIFmsg.uniHostIFmsgBody.strHostIFSendBufferedEAP.pvUserArg = pvUserArg;
+	strHostIFmsg.drvHandler = (void *)function_context;
+	strHostIFmsg.u16MsgId = HOST_IF_MSG_CONNECT_TIMER_FIRED;
 
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if (s32Error) {
-		PRINT_ER("Failed to send message queue buffered eapol\n");
-		WILC_ERRORREPORT(s32Error, WILC_FAIL);
-	}
-
-	WILC_CATCH(s32Error){
-	}
-
-	return s32Error;
+	host_if_msg_post(&strHostIFmsg);
 }
 
 /*
@@ -4828,7 +5472,7 @@ signed int host_int_remove_wep_key(struct WFIDrvHandle *hWFIDrv, u8 u8keyIdx)
 	uniHostIFkeyAttr.strHostIFwepAttr.u8Wepidx = u8keyIdx;
 
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg, sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if(s32Error)
 		PRINT_ER("Error in sending message queue : Request to remove WEP key\n");
 	else
@@ -4864,7 +5508,7 @@ signed int host_int_set_WEPDefaultKeyID(struct WFIDrvHandle *hWFIDrv, u8 u8Index
 	uniHostIFkeyAttr.strHostIFwepAttr.u8Wepidx = u8Index;
 
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg, sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		PRINT_ER("Error in sending message queue : Default key index\n");
 	else
@@ -4921,8 +5565,7 @@ signed int host_int_add_wep_key_bss_sta(struct WFIDrvHandle *hWFIDrv,
 	uniHostIFkeyAttr.strHostIFwepAttr.u8Wepidx = u8Keyidx;
 
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		PRINT_ER("Error in sending message queue :WEP Key\n");
 	else
@@ -4984,7 +5627,7 @@ signed int host_int_add_wep_key_bss_ap(struct WFIDrvHandle *hWFIDrv,
 	strHostIFmsg.uniHostIFmsgBody.strHostIFkeyAttr.
 	uniHostIFkeyAttr.strHostIFwepAttr.tenuAuth_type = tenuAuth_type;
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg, sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 
 	if (s32Error)
 		PRINT_ER("Error in sending message queue :WEP Key\n");
@@ -5071,8 +5714,7 @@ signed int host_int_add_ptk(struct WFIDrvHandle *hWFIDrv, u8 *pu8Ptk,
 	strHostIFmsg.drvHandler = hWFIDrv;
 
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 
 	if (s32Error)
 		PRINT_ER("Error in sending message queue:  PTK Key\n");
@@ -5155,8 +5797,7 @@ signed int host_int_add_rx_gtk(struct WFIDrvHandle *hWFIDrv, u8 *pu8RxGtk,
 	uniHostIFkeyAttr.strHostIFwpaAttr.u8seqlen = u32KeyRSClen;
 
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		PRINT_ER("Error in sending message queue:  RX GTK\n");
 	else
@@ -5208,7 +5849,7 @@ signed int host_int_set_pmkid_info(struct WFIDrvHandle *hWFIDrv,
 		       PMKID_LEN);
 	}
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg, sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		PRINT_ER(" Error in sending messagequeue: PMKID Info\n");
 
@@ -5277,20 +5918,24 @@ signed int host_int_get_MacAddress(struct WFIDrvHandle *hWFIDrv,
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrHostIFmsg strHostIFmsg;
+	struct tstrHostIFreq *pstrReq;
 
 	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
 
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_GET_MAC_ADDRESS;
-	strHostIFmsg.uniHostIFmsgBody.strHostIfGetMacAddress.u8MacAddress = pu8MacAddress;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg, sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if (s32Error) {
-		PRINT_ER("Failed to send get mac address\n");
-		return WILC_FAIL;
-	}
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		return WILC_NO_MEM;
+
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	if (s32Error == WILC_SUCCESS)
+		memcpy(pu8MacAddress, pstrReq->uniResult.au8MacAddress, ETH_ALEN);
+	else
+		PRINT_ER("Failed to get mac address\n");
 
-	down(&hWaitResponse);
+	host_if_req_put(pstrReq);
 	return s32Error;
 }
 
@@ -5313,8 +5958,7 @@ signed int host_int_set_MacAddress(struct WFIDrvHandle *hWFIDrv,
 	       pu8MacAddress, ETH_ALEN);
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error) {
 		PRINT_ER("Failed to send message queue: Set mac address\n");
 		WILC_ERRORREPORT(s32Error, s32Error);
@@ -5488,7 +6132,11 @@ signed int host_int_set_join_req(struct WFIDrvHandle *hWFIDrv, u8 *pu8bssid,
 	strHostIFmsg.uniHostIFmsgBody.strHostIFconnectAttr.u8channel = u8channel;
 	strHostIFmsg.uniHostIFmsgBody.strHostIFconnectAttr.pfConnectResult = pfConnectResult;
 	strHostIFmsg.uniHostIFmsgBody.strHostIFconnectAttr.pvUserArg = pvUserArg;
-	strHostIFmsg.uniHostIFmsgBody.strHostIFconnectAttr.pJoinParams = pJoinParams;
+	/* the caller may free its entry before the message is handled */
+	strHostIFmsg.uniHostIFmsgBody.strHostIFconnectAttr.pJoinParams =
+		host_int_copyJoinParams(pJoinParams);
+	if (strHostIFmsg.uniHostIFmsgBody.strHostIFconnectAttr.pJoinParams == NULL)
+		WILC_ERRORREPORT(s32Error, WILC_NO_MEM);
 	strHostIFmsg.drvHandler = hWFIDrv;
 
 	if (pu8bssid != NULL) {
@@ -5516,9 +6164,10 @@ signed int host_int_set_join_req(struct WFIDrvHandle *hWFIDrv, u8 *pu8bssid,
 	else
 		PRINT_D(GENERIC_DBG, "Don't set state to 'connecting' as state is %d\n", pstrWFIDrv->enuHostIFstate);
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg, sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error) {
 		PRINT_ER("Failed to send message queue: Set join request\n");
+		host_if_connect_attr_free(&strHostIFmsg.uniHostIFmsgBody.strHostIFconnectAttr);
 		WILC_ERRORREPORT(s32Error, WILC_FAIL);
 	}
 
@@ -5555,8 +6204,7 @@ signed int host_int_flush_join_req(struct WFIDrvHandle *hWFIDrv)
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_FLUSH_CONNECT;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error) {
 		PRINT_ER("Failed to send message queue: Flush join request\n");
 		WILC_ERRORREPORT(s32Error, WILC_FAIL);
@@ -5594,8 +6242,7 @@ signed int host_int_disconnect(struct WFIDrvHandle *hWFIDrv, u16 u16ReasonCode)
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_DISCONNECT;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		PRINT_ER("Failed to send message queue: disconnect\n");
 	else
@@ -5749,8 +6396,7 @@ signed int host_int_set_mac_chnl_num(struct WFIDrvHandle *hWFIDrv, u8 u8ChNum)
 	strHostIFmsg.uniHostIFmsgBody.strHostIFSetChan.u8SetChan = u8ChNum;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -5767,17 +6413,19 @@ signed int host_int_wait_msg_queue_idle(void)
 	signed int s32Error = WILC_SUCCESS;
 
 	struct tstrHostIFmsg strHostIFmsg;
+	struct tstrHostIFreq *pstrReq;
 
 	/* prepare the set driver handler message */
 	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_Q_IDLE;
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if (s32Error)
-		WILC_ERRORREPORT(s32Error, s32Error);
-	
+
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		WILC_ERRORREPORT(s32Error, WILC_NO_MEM);
+
 	/* wait untill MSG Q is empty*/
-	down(&hWaitResponse);
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_Q_IDLE_TIMEOUT);
+	host_if_req_put(pstrReq);
 
 	WILC_CATCH(s32Error){
 	}
@@ -5800,8 +6448,7 @@ signed int host_int_set_wfi_drv_handler(unsigned int u32address, u8 u8IfMode, ch
 		strHostIFmsg.uniHostIFmsgBody.strHostIfSetDrvHandler.u8IfName = WLAN_IFC;
 	else if(!(memcmp(pcIfName, IFC_1, 4)))
 		strHostIFmsg.uniHostIFmsgBody.strHostIfSetDrvHandler.u8IfName = P2P_IFC;
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -5823,8 +6470,7 @@ signed int host_int_set_operation_mode(struct WFIDrvHandle *hWFIDrv,
 	strHostIFmsg.uniHostIFmsgBody.strHostIfSetOperationMode.u32Mode = u32mode;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -5847,6 +6493,7 @@ signed int host_int_get_host_chnl_num(struct WFIDrvHandle *hWFIDrv, u8 *pu8ChNo)
 	signed int s32Error = WILC_SUCCESS;
 	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)hWFIDrv;
 	struct tstrHostIFmsg strHostIFmsg;
+	struct tstrHostIFreq *pstrReq;
 
 	if (pstrWFIDrv == NULL) {
 		PRINT_ER("Driver not initialized: pstrWFIDrv = NULL\n");
@@ -5859,14 +6506,16 @@ signed int host_int_get_host_chnl_num(struct WFIDrvHandle *hWFIDrv, u8 *pu8ChNo)
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_GET_CHNL;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if (s32Error)
-		PRINT_ER("Failed to send get host channel param's message queue\n");
-	else
-		down(&(pstrWFIDrv->hSemGetCHNL));
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		WILC_ERRORREPORT(s32Error, WILC_NO_MEM);
 
-	*pu8ChNo = gu8Chnl;
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	if (s32Error == WILC_SUCCESS)
+		*pu8ChNo = pstrReq->uniResult.u8Val;
+	else
+		PRINT_ER("Failed to get host channel\n");
+	host_if_req_put(pstrReq);
 
 	WILC_CATCH(s32Error){
 	}
@@ -5928,6 +6577,7 @@ signed int host_int_get_inactive_time(struct WFIDrvHandle *hWFIDrv, u8 *mac,
 	signed int s32Error = WILC_SUCCESS;
 	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)hWFIDrv;
 	struct tstrHostIFmsg strHostIFmsg;
+	struct tstrHostIFreq *pstrReq;
 
 	if (pstrWFIDrv == NULL) {
 		PRINT_ER("Driver not initialized: pstrWFIDrv = NULL\n");
@@ -5942,14 +6592,16 @@ signed int host_int_get_inactive_time(struct WFIDrvHandle *hWFIDrv, u8 *mac,
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_GET_INACTIVETIME;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if (s32Error)
-		PRINT_ER("Failed to send get host channel param's message queue");
-	else
-		down(&(pstrWFIDrv->hSemInactiveTime));
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		WILC_ERRORREPORT(s32Error, WILC_NO_MEM);
 
-	*pu32InactiveTime = gu32InactiveTime;
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	if (s32Error == WILC_SUCCESS)
+		*pu32InactiveTime = pstrReq->uniResult.u32Val;
+	else
+		PRINT_ER("Failed to get inactive time\n");
+	host_if_req_put(pstrReq);
 
 	WILC_CATCH(s32Error){
 	}
@@ -6010,7 +6662,12 @@ signed int host_int_get_rssi(struct WFIDrvHandle *hWFIDrv, s8 *ps8Rssi)
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrHostIFmsg strHostIFmsg;
-	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)hWFIDrv;
+	struct tstrHostIFreq *pstrReq;
+
+	if (ps8Rssi == NULL) {
+		PRINT_ER("RSS pointer value is null");
+		return WILC_FAIL;
+	}
 
 	/* prepare the Get RSSI Message */
 	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
@@ -6018,21 +6675,14 @@ signed int host_int_get_rssi(struct WFIDrvHandle *hWFIDrv, s8 *ps8Rssi)
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_GET_RSSI;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if (s32Error) {
-		PRINT_ER("Failed to send get host channel param's message queue\n");
-		return WILC_FAIL;
-	}
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		return WILC_NO_MEM;
 
-	down(&(pstrWFIDrv->hSemGetRSSI));
-
-	if (ps8Rssi == NULL) {
-		PRINT_ER("RSS pointer value is null");
-		return WILC_FAIL;
-	}
-
-	*ps8Rssi = gs8Rssi;
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	if (s32Error == WILC_SUCCESS)
+		*ps8Rssi = pstrReq->uniResult.s8Val;
+	host_if_req_put(pstrReq);
 
 	return s32Error;
 }
@@ -6041,8 +6691,12 @@ signed int host_int_get_link_speed(struct WFIDrvHandle *hWFIDrv, s8 *ps8lnkspd)
 {
 	struct tstrHostIFmsg strHostIFmsg;
 	signed int s32Error = WILC_SUCCESS;
+	struct tstrHostIFreq *pstrReq;
 
-	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)hWFIDrv;
+	if (ps8lnkspd == NULL) {
+		PRINT_ER("LINKSPEED pointer value is null");
+		return WILC_FAIL;
+	}
 
 	/* prepare the Get LINKSPEED Message */
 	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
@@ -6050,21 +6704,14 @@ signed int host_int_get_link_speed(struct WFIDrvHandle *hWFIDrv, s8 *ps8lnkspd)
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_GET_LINKSPEED;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if (s32Error) {
-		PRINT_ER("Failed to send GET_LINKSPEED to message queue ");
-		return WILC_FAIL;
-	}
-
-	down(&(pstrWFIDrv->hSemGetLINKSPEED));
-
-	if (ps8lnkspd == NULL) {
-		PRINT_ER("LINKSPEED pointer value is null");
-		return WILC_FAIL;
-	}
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		return WILC_NO_MEM;
 
-	*ps8lnkspd = gs8lnkspd;
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	if (s32Error == WILC_SUCCESS)
+		*ps8lnkspd = pstrReq->uniResult.s8Val;
+	host_if_req_put(pstrReq);
 
 	return s32Error;
 }
@@ -6074,26 +6721,101 @@ signed int host_int_get_statistics(struct WFIDrvHandle *hWFIDrv,
 {
 	signed int s32Error = WILC_SUCCESS;
 	struct tstrHostIFmsg strHostIFmsg;
+	struct tstrHostIFreq *pstrReq;
 
 	/* prepare the Get RSSI Message */
 	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
 
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_GET_STATISTICS;
-	strHostIFmsg.uniHostIFmsgBody.pUserData = (char *)pstrStatistics;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		return WILC_NO_MEM;
+
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	if (s32Error == WILC_SUCCESS)
+		*pstrStatistics = pstrReq->uniResult.strStatistics;
+	host_if_req_put(pstrReq);
+
+	return s32Error;
+}
+
+/*
+ * Queues a statistics cache refresh without waiting for it
+ */
+static signed int host_int_refresh_statistics(struct WFIDrvHandle *hWFIDrv)
+{
+	signed int s32Error = WILC_SUCCESS;
+	struct tstrHostIFmsg strHostIFmsg;
+
+	memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
+
+	strHostIFmsg.u16MsgId = HOST_IF_MSG_GET_STATISTICS;
+	strHostIFmsg.drvHandler = hWFIDrv;
+
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error) {
 		PRINT_ER("Failed to send get host channel param's message queue\n");
 		return WILC_FAIL;
 	}
 
-	if(pstrStatistics != &gDummyStatistics)
-		down(&hWaitResponse);
 	return s32Error;
 }
 
+/*
+ * Returns the last statistics snapshot without a firmware round trip.
+ * GetPeriodicRSSI() keeps it fresh while connected; only the very first
+ * call after a connection waits for the firmware. A snapshot older than
+ * STATS_STALE_MS (e.g. on an interface the periodic timer doesn't poll)
+ * is still returned, with a refresh queued in the background. -ENOENT
+ * when not associated, the cache is dropped on disconnect.
+ */
+signed int host_int_get_cached_statistics(struct WFIDrvHandle *hWFIDrv,
+					  struct tstrStatistics *pstrStatistics,
+					  unsigned int *pu32AgeMs)
+{
+	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)hWFIDrv;
+	unsigned int u32AgeMs;
+	bool bValid;
+
+	if (pstrWFIDrv == NULL || pstrStatistics == NULL)
+		return WILC_FAIL;
+
+	if (pstrWFIDrv->enuHostIFstate != HOST_IF_CONNECTED)
+		return -ENOENT;
+
+	pstrWFIDrv->u32StatsLastRead = jiffies;
+	down(&pstrWFIDrv->hSemStatsCache);
+	bValid = pstrWFIDrv->bStatsValid;
+	up(&pstrWFIDrv->hSemStatsCache);
+	if (!bValid) {
+		signed int s32Error;
+
+		s32Error = host_int_get_statistics(hWFIDrv, pstrStatistics);
+		if (s32Error)
+			return s32Error;
+	}
+
+	down(&pstrWFIDrv->hSemStatsCache);
+	if (!pstrWFIDrv->bStatsValid) {
+		/* disconnected meanwhile */
+		up(&pstrWFIDrv->hSemStatsCache);
+		return -ENOENT;
+	}
+	*pstrStatistics = pstrWFIDrv->strStatsCache;
+	u32AgeMs = jiffies_to_msecs(jiffies - pstrWFIDrv->u32StatsStamp);
+	up(&pstrWFIDrv->hSemStatsCache);
+
+	if (u32AgeMs > STATS_STALE_MS)
+		host_int_refresh_statistics(hWFIDrv);
+
+	if (pu32AgeMs != NULL)
+		*pu32AgeMs = u32AgeMs;
+
+	return WILC_SUCCESS;
+}
+
 /*
  * scans a set of channels
  */
@@ -6140,8 +6862,7 @@ signed int host_int_scan(struct WFIDrvHandle *hWFIDrv, u8 u8ScanSource,
 	memcpy(strHostIFmsg.uniHostIFmsgBody.strHostIFscanAttr.pu8IEs,
 	       pu8IEs, IEsLen);
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error) {
 		PRINT_ER("Error in sending message queue scanning parameters: Error(%d)\n",
 		       s32Error);
@@ -6180,8 +6901,7 @@ signed int hif_set_cfg(struct WFIDrvHandle *hWFIDrv,
 	strHostIFmsg.uniHostIFmsgBody.strHostIFCfgParamAttr.pstrCfgParamVal = *pstrCfgParamVal;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg, 
-		sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 
 	WILC_CATCH(s32Error){
 	}
@@ -6364,6 +7084,7 @@ void host_int_send_join_leave_info_to_host
 void GetPeriodicRSSI(void * pvArg)
 {	
 	struct WILC_WFIDrv * pstrWFIDrv = (struct WILC_WFIDrv *)pvArg;
+	unsigned int u32Period = STATS_PERIOD_MS;
 
 	if (pstrWFIDrv == NULL)	{
 		PRINT_ER("Driver handler is NULL\n");
@@ -6372,10 +7093,14 @@ void GetPeriodicRSSI(void * pvArg)
 
 	if (pstrWFIDrv->enuHostIFstate == HOST_IF_CONNECTED) {
 			
-		host_int_get_statistics((struct WFIDrvHandle *)pstrWFIDrv,&gDummyStatistics);
+		host_int_refresh_statistics((struct WFIDrvHandle *)pstrWFIDrv);
+
+		if (time_before(jiffies, pstrWFIDrv->u32StatsLastRead +
+				msecs_to_jiffies(STATS_READER_IDLE_MS)))
+			u32Period = STATS_FAST_PERIOD_MS;
 	}
 	g_hPeriodicRSSI.data = (unsigned long)pstrWFIDrv;
-	mod_timer(&(g_hPeriodicRSSI), (jiffies + msecs_to_jiffies(5000)));
+	mod_timer(&(g_hPeriodicRSSI), (jiffies + msecs_to_jiffies(u32Period)));
 }
 
 /*
@@ -6421,14 +7146,11 @@ signed int host_int_init(struct WFIDrvHandle **phWFIDrv)
 		sema_init(&hSemHostIntDeinit, 1);
 	}
 
-	sema_init(&hWaitResponse, 0);
 	sema_init(&(pstrWFIDrv->hSemTestKeyBlock), 0);
 	sema_init(&(pstrWFIDrv->hSemTestDisconnectBlock), 0);
-	sema_init(&(pstrWFIDrv->hSemGetRSSI), 0);
-	sema_init(&(pstrWFIDrv->hSemGetLINKSPEED), 0);
-	sema_init(&(pstrWFIDrv->hSemGetCHNL), 0);
-	sema_init(&(pstrWFIDrv->hSemInactiveTime), 0);
 	sema_init(&(pstrWFIDrv->gtOsCfgValuesSem), 1);
+	sema_init(&(pstrWFIDrv->hSemStatsCache), 1);
+	pstrWFIDrv->u32StatsLastRead = jiffies - msecs_to_jiffies(STATS_READER_IDLE_MS);
 
 	PRINT_D(HOSTINF_DBG, "INIT: CLIENT COUNT %d\n", clients_count);
 
@@ -6450,6 +7172,9 @@ signed int host_int_init(struct WFIDrvHandle **phWFIDrv)
 
 	setup_timer(&(pstrWFIDrv->hScanTimer), TimerCB_Scan, 0);
 	setup_timer(&(pstrWFIDrv->hConnectTimer), TimerCB_Connect, 0);
+#ifdef WILC_SCAN_SCHEDULER
+	setup_timer(&(pstrWFIDrv->strScanSched.hChunkTimer), TimerCB_ScanChunk, 0);
+#endif
 
 #ifdef WILC_P2P
 	/*Remain on channel timer*/
@@ -6487,6 +7212,17 @@ signed int host_int_init(struct WFIDrvHandle **phWFIDrv)
 		goto _fail_mem_;
 	}
 
+	/* host_int_wait_msg_queue_idle held the thread back, release it */
+	if (!g_wilc_initialized) {
+		struct tstrHostIFmsg strHostIFmsg;
+
+		g_wilc_initialized = 1;
+		memset(&strHostIFmsg, 0, sizeof(struct tstrHostIFmsg));
+		strHostIFmsg.u16MsgId = HOST_IF_MSG_INITIALIZED;
+		if (host_if_msg_post(&strHostIFmsg))
+			PRINT_ER("Failed to wake the host interface thread\n");
+	}
+
 	u32Intialized = 1;
 	clients_count++;
 
@@ -6543,6 +7279,10 @@ signed int host_int_deinit(struct WFIDrvHandle *hWFIDrv, char* pcIfName, u8 u8If
 	if (del_timer_sync(&(pstrWFIDrv->hConnectTimer)))
 		PRINT_D(HOSTINF_DBG, ">> Connect timer is active\n");
 
+#ifdef WILC_SCAN_SCHEDULER
+	del_timer_sync(&(pstrWFIDrv->strScanSched.hChunkTimer));
+#endif
+
 
 	if (del_timer_sync(&(g_hPeriodicRSSI)))
 		PRINT_D(HOSTINF_DBG, ">> Connect timer is active\n");
@@ -6561,6 +7301,11 @@ signed int host_int_deinit(struct WFIDrvHandle *hWFIDrv, char* pcIfName, u8 u8If
 
 		pstrWFIDrv->strWILC_UsrScanReq.pfUserScanResult = NULL;
 	}
+#ifdef WILC_SCAN_SCHEDULER
+	pstrWFIDrv->strScanSched.bActive = false;
+	kfree(pstrWFIDrv->strScanSched.pu8IEs);
+	kfree(pstrWFIDrv->strScanSched.pu8HdnNtwrksWidVal);
+#endif /* WILC_SCAN_SCHEDULER */
 	CoreConfiguratorDeInit();
 
 	pstrWFIDrv->enuHostIFstate = HOST_IF_IDLE;
@@ -6576,8 +7321,7 @@ signed int host_int_deinit(struct WFIDrvHandle *hWFIDrv, char* pcIfName, u8 u8If
 		strHostIFmsg.u16MsgId = HOST_IF_MSG_EXIT;
 		strHostIFmsg.drvHandler = hWFIDrv;
 
-		s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-					    sizeof(struct tstrHostIFmsg), WILC_NULL);
+		s32Error = host_if_msg_post(&strHostIFmsg);
 		if (s32Error != WILC_SUCCESS)
 			PRINT_ER("Error in sending deinit's message queue message function: Error(%d)\n", s32Error);
 		else			
@@ -6626,13 +7370,20 @@ void NetworkInfoReceived(u8 *pu8Buffer, unsigned int u32Length)
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_RCVD_NTWRK_INFO;
 	strHostIFmsg.drvHandler = pstrWFIDrv;
 
+	/*
+	 * The rx buffer is recycled once we return, so this is the only copy of
+	 * the frame; it is parsed in place by the host interface thread
+	 */
 	strHostIFmsg.uniHostIFmsgBody.strRcvdNetworkInfo.u32Length = u32Length;
 	strHostIFmsg.uniHostIFmsgBody.strRcvdNetworkInfo.pu8Buffer = kmalloc(u32Length, GFP_ATOMIC);
+	if (strHostIFmsg.uniHostIFmsgBody.strRcvdNetworkInfo.pu8Buffer == NULL) {
+		PRINT_ER("Failed to allocate network info buffer\n");
+		return;
+	}
 	memcpy(strHostIFmsg.uniHostIFmsgBody.strRcvdNetworkInfo.pu8Buffer,
 	       pu8Buffer, u32Length);
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		PRINT_ER("Error in sending network info message queue message parameters: Error(%d)\n", s32Error);
 }
@@ -6680,8 +7431,7 @@ void GnrlAsyncInfoReceived(u8 *pu8Buffer, unsigned int u32Length)
 	memcpy(strHostIFmsg.uniHostIFmsgBody.strRcvdGnrlAsyncInfo.pu8Buffer,
 	       pu8Buffer, u32Length);
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		PRINT_ER("Error in sending message queue asynchronous message info: Error(%d)\n", s32Error);
 
@@ -6718,8 +7468,7 @@ void host_int_ScanCompleteReceived(u8 *pu8Buffer, unsigned int u32Length)
 		strHostIFmsg.u16MsgId = HOST_IF_MSG_RCVD_SCAN_COMPLETE;
 		strHostIFmsg.drvHandler = pstrWFIDrv;
 
-		s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-					    sizeof(struct tstrHostIFmsg), WILC_NULL);
+		s32Error = host_if_msg_post(&strHostIFmsg);
 		if (s32Error)
 			PRINT_ER("Error in sending message queue scan complete parameters: Error(%d)\n", s32Error);
 	}
@@ -6753,8 +7502,7 @@ signed int host_int_remain_on_channel(struct WFIDrvHandle *hWFIDrv,
 	strHostIFmsg.uniHostIFmsgBody.strHostIfRemainOnChan.u32ListenSessionID = u32SessionID;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-		sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -6783,8 +7531,7 @@ signed int host_int_ListenStateExpired(struct WFIDrvHandle *hWFIDrv,
 	strHostIFmsg.drvHandler = hWFIDrv;
 	strHostIFmsg.uniHostIFmsgBody.strHostIfRemainOnChan.u32ListenSessionID = u32SessionID;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -6827,8 +7574,7 @@ signed int host_int_frame_register(struct WFIDrvHandle *hWFIDrv, u16 u16FrameTyp
 	strHostIFmsg.uniHostIFmsgBody.strHostIfRegisterFrame.bReg = bReg;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -6881,8 +7627,7 @@ signed int host_int_add_beacon(struct WFIDrvHandle *hWFIDrv,
 	} else {
 		pstrSetBeaconParam->pu8Tail = NULL;
 	}
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -6915,8 +7660,7 @@ signed int host_int_del_beacon(struct WFIDrvHandle *hWFIDrv)
 	strHostIFmsg.drvHandler = hWFIDrv;
 	PRINT_D(HOSTINF_DBG, "Setting deleting beacon message queue params\n");
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	WILC_ERRORCHECK(s32Error);
 
 	WILC_CATCH(s32Error){
@@ -6956,8 +7700,7 @@ signed int host_int_add_station(struct WFIDrvHandle *hWFIDrv,
 		       pstrAddStationMsg->u8NumRates);
 	}
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -6994,8 +7737,7 @@ signed int host_int_del_station(struct WFIDrvHandle *hWFIDrv, u8 *pu8MacAddr)
 	else
 		memcpy(pstrDelStationMsg->au8MacAddr, pu8MacAddr, ETH_ALEN);
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -7014,6 +7756,7 @@ signed int host_int_del_allstation(struct WFIDrvHandle *hWFIDrv,
 	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)hWFIDrv;
 	struct tstrHostIFmsg strHostIFmsg;
 	struct tstrHostIFDelAllSta *pstrDelAllStationMsg = &strHostIFmsg.uniHostIFmsgBody.strHostIFDelAllSta;
+	struct tstrHostIFreq *pstrReq;
 	u8 au8Zero_Buff[ETH_ALEN] = {0};
 	unsigned int i;
 	u8 u8AssocNumb = 0;
@@ -7050,13 +7793,13 @@ signed int host_int_del_allstation(struct WFIDrvHandle *hWFIDrv,
 	}
 
 	pstrDelAllStationMsg->u8Num_AssocSta = u8AssocNumb;
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
 
-	if (s32Error)
-		WILC_ERRORREPORT(s32Error, s32Error);
-	
-	down(&hWaitResponse);
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		WILC_ERRORREPORT(s32Error, WILC_NO_MEM);
+
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	host_if_req_put(pstrReq);
 
 	WILC_CATCH(s32Error){
 	}
@@ -7094,8 +7837,7 @@ signed int host_int_edit_station(struct WFIDrvHandle *hWFIDrv,
 		WILC_NULLCHECK(s32Error, pstrAddStationMsg->pu8Rates);
 	}
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -7135,8 +7877,7 @@ signed int host_int_set_power_mgmt(struct WFIDrvHandle *hWFIDrv,
 	pstrPowerMgmtParam->bIsEnabled = bIsEnabled;
 	pstrPowerMgmtParam->u32Timeout = u32Timeout;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -7170,8 +7911,7 @@ signed int host_int_setup_multicast_filter(struct WFIDrvHandle *hWFIDrv,
 	pstrMulticastFilterParam->bIsEnabled = bIsEnabled;
 	pstrMulticastFilterParam->u32count = u32count;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -7184,13 +7924,16 @@ signed int host_int_setup_multicast_filter(struct WFIDrvHandle *hWFIDrv,
 #ifdef WILC_PARSE_SCAN_IN_HOST
 /*
  * Parse Needed Join Parameters and save it in a new JoinBssParam entry
+ * The IEs are not walked again, the offset table built by ParseNetworkInfo
+ * is used to reach the elements of interest directly
  */
 static void *host_int_ParseJoinBssParam(struct tstrNetworkInfo *ptstrNetworkInfo)
 {
 	struct tstrJoinBssParam *pNewJoinBssParam = NULL;
 	u8 *pu8IEs;
-	u16 u16IEsLen;
-	u16 index = 0;
+	u16 *pu16IEOffset;
+	u16 index;
+	u16 au16RsnOffset[2];
 	u8 suppRatesNo = 0;
 	u8 extSuppRatesNo;
 	u16 jumpOffset;
@@ -7198,169 +7941,160 @@ static void *host_int_ParseJoinBssParam(struct tstrNetworkInfo *ptstrNetworkInfo
 	u8 authCount;
 	u8 pcipherTotalCount = 0;
 	u8 authTotalCount = 0;
-	u8 i, j;
+	u8 i, j, k;
 
 	pu8IEs = ptstrNetworkInfo->pu8IEs;
-	u16IEsLen = ptstrNetworkInfo->u16IEsLen;
+	pu16IEOffset = ptstrNetworkInfo->au16IEOffset;
 
 	pNewJoinBssParam = kmalloc(sizeof(struct tstrJoinBssParam), GFP_ATOMIC);
-	if (pNewJoinBssParam != NULL) {
-		memset(pNewJoinBssParam, 0, sizeof(struct tstrJoinBssParam));
-		pNewJoinBssParam->dtim_period = ptstrNetworkInfo->u8DtimPeriod;
-		pNewJoinBssParam->beacon_period = ptstrNetworkInfo->u16BeaconPeriod;
-		pNewJoinBssParam->cap_info = ptstrNetworkInfo->u16CapInfo;
-		memcpy(pNewJoinBssParam->au8bssid, ptstrNetworkInfo->au8bssid, 6);
-		memcpy((u8 *)pNewJoinBssParam->ssid, ptstrNetworkInfo->au8ssid,
-		       ptstrNetworkInfo->u8SsidLen + 1);
-		pNewJoinBssParam->ssidLen = ptstrNetworkInfo->u8SsidLen;
-		memset(pNewJoinBssParam->rsn_pcip_policy, 0xFF, 3);
-		memset(pNewJoinBssParam->rsn_auth_policy, 0xFF, 3);
-
-		/*parse supported rates:*/
-		while (index < u16IEsLen) {
-			/*supportedRates IE*/
-			if (pu8IEs[index] == SUPP_RATES_IE) {
-				suppRatesNo = pu8IEs[index + 1];
-				pNewJoinBssParam->supp_rates[0] = suppRatesNo;
-				index += 2;
-
-				for (i = 0; i < suppRatesNo; i++)
-					pNewJoinBssParam->supp_rates[i + 1] = pu8IEs[index + i];
-
-				index += suppRatesNo;
-				continue;
-			/*Ext SupportedRates IE*/
-			} else if (pu8IEs[index] == EXT_SUPP_RATES_IE) {
-				/*checking if no of ext. supp and supp rates < max limit*/
-				extSuppRatesNo = pu8IEs[index + 1];
-				if (extSuppRatesNo > (MAX_RATES_SUPPORTED - suppRatesNo))
-					pNewJoinBssParam->supp_rates[0] = MAX_RATES_SUPPORTED;
-				else
-					pNewJoinBssParam->supp_rates[0] += extSuppRatesNo;
-				index += 2;
-				for (i = 0; i < (pNewJoinBssParam->supp_rates[0] - suppRatesNo); i++)
-					pNewJoinBssParam->supp_rates[suppRatesNo + i + 1] = pu8IEs[index + i];
-
-				index += extSuppRatesNo;
-				continue;
-			/*HT Cap. IE*/
-			} else if (pu8IEs[index] == HT_CAPABILITY_IE) {
-				pNewJoinBssParam->ht_capable = 1;
-				index += pu8IEs[index + 1] + 2;
-				continue;
-			} else if ((pu8IEs[index] == WMM_IE) && /* WMM Element ID */
-				   (pu8IEs[index + 2] == 0x00) && (pu8IEs[index + 3] == 0x50) &&
-				   (pu8IEs[index + 4] == 0xF2) && /* OUI */
-				   (pu8IEs[index + 5] == 0x02) && /* OUI Type     */
-				   ((pu8IEs[index + 6] == 0x00) || (pu8IEs[index + 6] == 0x01)) && /* OUI Sub Type */
-				   (pu8IEs[index + 7] == 0x01)) {
-				/* Presence of WMM Info/Param element indicates WMM capability */
-				pNewJoinBssParam->wmm_cap = 1;
-
-				/* Check if Bit 7 is set indicating U-APSD capability */
-				if (pu8IEs[index + 8] & (1 << 7))
-					pNewJoinBssParam->uapsd_cap = 1;
-				index += pu8IEs[index + 1] + 2;
-				continue;
-			}
-#ifdef WILC_P2P
-			else if ((pu8IEs[index] == P2P_IE) && /* P2P Element ID */
-				 (pu8IEs[index + 2] == 0x50) && (pu8IEs[index + 3] == 0x6f) &&
-				 (pu8IEs[index + 4] == 0x9a) && /* OUI */
-				 (pu8IEs[index + 5] == 0x09) && (pu8IEs[index + 6] == 0x0c)) { /* OUI Type     */
-				u16 u16P2P_count;
-
-				pNewJoinBssParam->tsf = ptstrNetworkInfo->u32Tsf;
-				pNewJoinBssParam->u8NoaEnbaled = 1;
-				pNewJoinBssParam->u8Index = pu8IEs[index + 9];
-
-				/* Check if Bit 7 is set indicating Opss capability */
-				if (pu8IEs[index + 10] & (1 << 7)) {
-					pNewJoinBssParam->u8OppEnable = 1;
-					pNewJoinBssParam->u8CtWindow = pu8IEs[index + 10];
-				} else {
-					pNewJoinBssParam->u8OppEnable = 0;
-				}
-				PRINT_D(GENERIC_DBG, "P2P Dump\n");
-				for (i = 0; i < pu8IEs[index + 7]; i++)
-					PRINT_D(GENERIC_DBG, " %x\n", pu8IEs[index + 9 + i]);
+	if (pNewJoinBssParam == NULL)
+		return NULL;
 
-				pNewJoinBssParam->u8Count = pu8IEs[index + 11];
-				u16P2P_count = index + 12;
+	memset(pNewJoinBssParam, 0, sizeof(struct tstrJoinBssParam));
+	pNewJoinBssParam->dtim_period = ptstrNetworkInfo->u8DtimPeriod;
+	pNewJoinBssParam->beacon_period = ptstrNetworkInfo->u16BeaconPeriod;
+	pNewJoinBssParam->cap_info = ptstrNetworkInfo->u16CapInfo;
+	memcpy(pNewJoinBssParam->au8bssid, ptstrNetworkInfo->au8bssid, 6);
+	memcpy((u8 *)pNewJoinBssParam->ssid, ptstrNetworkInfo->au8ssid,
+	       ptstrNetworkInfo->u8SsidLen + 1);
+	pNewJoinBssParam->ssidLen = ptstrNetworkInfo->u8SsidLen;
+	memset(pNewJoinBssParam->rsn_pcip_policy, 0xFF, 3);
+	memset(pNewJoinBssParam->rsn_auth_policy, 0xFF, 3);
+
+	/*supportedRates IE*/
+	index = pu16IEOffset[IE_OFST_SUPP_RATES];
+	if (index != IE_NOT_FOUND) {
+		suppRatesNo = pu8IEs[index + 1];
+		if (suppRatesNo > MAX_RATES_SUPPORTED)
+			suppRatesNo = MAX_RATES_SUPPORTED;
+		pNewJoinBssParam->supp_rates[0] = suppRatesNo;
+		for (i = 0; i < suppRatesNo; i++)
+			pNewJoinBssParam->supp_rates[i + 1] = pu8IEs[index + 2 + i];
+	}
+
+	/*Ext SupportedRates IE*/
+	index = pu16IEOffset[IE_OFST_EXT_SUPP_RATES];
+	if (index != IE_NOT_FOUND) {
+		/*checking if no of ext. supp and supp rates < max limit*/
+		extSuppRatesNo = pu8IEs[index + 1];
+		if (extSuppRatesNo > (MAX_RATES_SUPPORTED - suppRatesNo))
+			pNewJoinBssParam->supp_rates[0] = MAX_RATES_SUPPORTED;
+		else
+			pNewJoinBssParam->supp_rates[0] += extSuppRatesNo;
+		for (i = 0; i < (pNewJoinBssParam->supp_rates[0] - suppRatesNo); i++)
+			pNewJoinBssParam->supp_rates[suppRatesNo + i + 1] = pu8IEs[index + 2 + i];
+	}
 
-				memcpy(pNewJoinBssParam->au8Duration, pu8IEs + u16P2P_count, 4);
-				u16P2P_count += 4;
+	/*HT Cap. IE*/
+	if (pu16IEOffset[IE_OFST_HT_CAP] != IE_NOT_FOUND)
+		pNewJoinBssParam->ht_capable = 1;
 
-				memcpy(pNewJoinBssParam->au8Interval, pu8IEs + u16P2P_count, 4);
-				u16P2P_count += 4;
+	/* Presence of WMM Info/Param element indicates WMM capability */
+	index = pu16IEOffset[IE_OFST_WMM];
+	if (index != IE_NOT_FOUND) {
+		pNewJoinBssParam->wmm_cap = 1;
 
-				memcpy(pNewJoinBssParam->au8StartTime, pu8IEs + u16P2P_count, 4);
+		/* Check if Bit 7 is set indicating U-APSD capability */
+		if (pu8IEs[index + 8] & (1 << 7))
+			pNewJoinBssParam->uapsd_cap = 1;
+	}
 
-				index += pu8IEs[index + 1] + 2;
-				continue;
-			}
+#ifdef WILC_P2P
+	index = pu16IEOffset[IE_OFST_P2P_NOA];
+	if (index != IE_NOT_FOUND) {
+		u16 u16P2P_count;
+
+		pNewJoinBssParam->tsf = ptstrNetworkInfo->u32Tsf;
+		pNewJoinBssParam->u8NoaEnbaled = 1;
+		pNewJoinBssParam->u8Index = pu8IEs[index + 9];
+
+		/* Check if Bit 7 is set indicating Opss capability */
+		if (pu8IEs[index + 10] & (1 << 7)) {
+			pNewJoinBssParam->u8OppEnable = 1;
+			pNewJoinBssParam->u8CtWindow = pu8IEs[index + 10];
+		} else {
+			pNewJoinBssParam->u8OppEnable = 0;
+		}
+		PRINT_D(GENERIC_DBG, "P2P Dump\n");
+		for (i = 0; i < pu8IEs[index + 7]; i++)
+			PRINT_D(GENERIC_DBG, " %x\n", pu8IEs[index + 9 + i]);
+
+		pNewJoinBssParam->u8Count = pu8IEs[index + 11];
+		u16P2P_count = index + 12;
+
+		memcpy(pNewJoinBssParam->au8Duration, pu8IEs + u16P2P_count, 4);
+		u16P2P_count += 4;
+
+		memcpy(pNewJoinBssParam->au8Interval, pu8IEs + u16P2P_count, 4);
+		u16P2P_count += 4;
+
+		memcpy(pNewJoinBssParam->au8StartTime, pu8IEs + u16P2P_count, 4);
+	}
 #endif /* WILC_P2P */
-			else if ((pu8IEs[index] == RSN_IE) ||
-				 ((pu8IEs[index] == WPA_IE) && (pu8IEs[index + 2] == 0x00) &&
-				  (pu8IEs[index + 3] == 0x50) && (pu8IEs[index + 4] == 0xF2) &&
-				  (pu8IEs[index + 5] == 0x01)))	{
-				u16 rsnIndex = index;
-
-				if (pu8IEs[rsnIndex] == RSN_IE)	{
-					pNewJoinBssParam->mode_802_11i = 2;
-				} else {
-					if (pNewJoinBssParam->mode_802_11i == 0)
-						pNewJoinBssParam->mode_802_11i = 1;
-					rsnIndex += 4;
-				}
-				/*//skipping id, length, version(2B) and first 3 bytes of gcipher*/
-				rsnIndex += 7;
-				pNewJoinBssParam->rsn_grp_policy = pu8IEs[rsnIndex];
-				rsnIndex++;
-				/*initialize policies with invalid values*/
 
-				jumpOffset = pu8IEs[rsnIndex] * 4;
+	/* RSN and WPA IEs, handled in the order they appear in the frame */
+	au16RsnOffset[0] = pu16IEOffset[IE_OFST_RSN];
+	au16RsnOffset[1] = pu16IEOffset[IE_OFST_WPA];
+	if (au16RsnOffset[1] < au16RsnOffset[0]) {
+		au16RsnOffset[0] = pu16IEOffset[IE_OFST_WPA];
+		au16RsnOffset[1] = pu16IEOffset[IE_OFST_RSN];
+	}
 
-				/*parsing pairwise cipher
-				 *saving 3 pcipher max.
-				 */
-				pcipherCount = (pu8IEs[rsnIndex] > 3) ? 3 : pu8IEs[rsnIndex];
-				/* jump 2 bytes of pcipher count*/
-				rsnIndex += 2;
+	for (k = 0; k < 2; k++) {
+		u16 rsnIndex;
 
-				for (i = pcipherTotalCount, j = 0; i < pcipherCount + pcipherTotalCount && i < 3; i++, j++)
-					/*each count corresponds to 4 bytes, only last byte is saved*/
-					pNewJoinBssParam->rsn_pcip_policy[i] = pu8IEs[rsnIndex + ((j + 1) * 4) - 1];
-				pcipherTotalCount += pcipherCount;
-				rsnIndex += jumpOffset;
+		index = au16RsnOffset[k];
+		if (index == IE_NOT_FOUND)
+			continue;
 
-				jumpOffset = pu8IEs[rsnIndex] * 4;
+		rsnIndex = index;
+		if (pu8IEs[rsnIndex] == RSN_IE)	{
+			pNewJoinBssParam->mode_802_11i = 2;
+		} else {
+			if (pNewJoinBssParam->mode_802_11i == 0)
+				pNewJoinBssParam->mode_802_11i = 1;
+			rsnIndex += 4;
+		}
+		/*//skipping id, length, version(2B) and first 3 bytes of gcipher*/
+		rsnIndex += 7;
+		pNewJoinBssParam->rsn_grp_policy = pu8IEs[rsnIndex];
+		rsnIndex++;
+		/*initialize policies with invalid values*/
 
-				/* parsing AKM suite (auth_policy)
-				 * saving 3 auth policies max.
-				 */
-				authCount = (pu8IEs[rsnIndex] > 3) ? 3 : pu8IEs[rsnIndex];
-				rsnIndex += 2;
-
-				for (i = authTotalCount, j = 0; i < authTotalCount + authCount; i++, j++)
-					pNewJoinBssParam->rsn_auth_policy[i] = pu8IEs[rsnIndex + ((j + 1) * 4) - 1];
-				authTotalCount += authCount;
-				rsnIndex += jumpOffset;
-				/*pasring rsn cap. only if rsn IE*/
-				if (pu8IEs[index] == RSN_IE) {
-					pNewJoinBssParam->rsn_cap[0] = pu8IEs[rsnIndex];
-					pNewJoinBssParam->rsn_cap[1] = pu8IEs[rsnIndex + 1];
-					rsnIndex += 2;
-				}
-				pNewJoinBssParam->rsn_found = true;
-				/* Skip ID,Length bytes and IE body*/
-				index += pu8IEs[index + 1] + 2;
-				continue;
-			} else {
-				/* Skip ID,Length bytes and IE body*/
-				index += pu8IEs[index + 1] + 2;
-			}
+		jumpOffset = pu8IEs[rsnIndex] * 4;
+
+		/*parsing pairwise cipher
+		 *saving 3 pcipher max.
+		 */
+		pcipherCount = (pu8IEs[rsnIndex] > 3) ? 3 : pu8IEs[rsnIndex];
+		/* jump 2 bytes of pcipher count*/
+		rsnIndex += 2;
+
+		for (i = pcipherTotalCount, j = 0; i < pcipherCount + pcipherTotalCount && i < 3; i++, j++)
+			/*each count corresponds to 4 bytes, only last byte is saved*/
+			pNewJoinBssParam->rsn_pcip_policy[i] = pu8IEs[rsnIndex + ((j + 1) * 4) - 1];
+		pcipherTotalCount += pcipherCount;
+		rsnIndex += jumpOffset;
+
+		jumpOffset = pu8IEs[rsnIndex] * 4;
+
+		/* parsing AKM suite (auth_policy)
+		 * saving 3 auth policies max.
+		 */
+		authCount = (pu8IEs[rsnIndex] > 3) ? 3 : pu8IEs[rsnIndex];
+		rsnIndex += 2;
+
+		for (i = authTotalCount, j = 0; i < authTotalCount + authCount && i < 3; i++, j++)
+			pNewJoinBssParam->rsn_auth_policy[i] = pu8IEs[rsnIndex + ((j + 1) * 4) - 1];
+		authTotalCount += authCount;
+		rsnIndex += jumpOffset;
+		/*pasring rsn cap. only if rsn IE*/
+		if (pu8IEs[index] == RSN_IE) {
+			pNewJoinBssParam->rsn_cap[0] = pu8IEs[rsnIndex];
+			pNewJoinBssParam->rsn_cap[1] = pu8IEs[rsnIndex + 1];
+			rsnIndex += 2;
 		}
+		pNewJoinBssParam->rsn_found = true;
 	}
 
 	return (void *)pNewJoinBssParam;
@@ -7373,6 +8107,28 @@ void host_int_freeJoinParams(void *pJoinParams)
 	else
 		PRINT_ER("Unable to FREE null pointer\n");
 }
+
+/*
+ * Duplicate parsed join parameters so they can be kept after the scan
+ * shadow entry they came from has aged out. Free with
+ * host_int_freeJoinParams().
+ */
+void *host_int_copyJoinParams(void *pJoinParams)
+{
+	struct tstrJoinBssParam *pNewJoinBssParam;
+
+	if (pJoinParams == NULL)
+		return NULL;
+
+	pNewJoinBssParam = kmalloc(sizeof(struct tstrJoinBssParam), GFP_KERNEL);
+	if (pNewJoinBssParam == NULL)
+		return NULL;
+
+	memcpy(pNewJoinBssParam, pJoinParams, sizeof(struct tstrJoinBssParam));
+	pNewJoinBssParam->nextJoinBss = NULL;
+
+	return (void *)pNewJoinBssParam;
+}
 #endif  /*WILC_PARSE_SCAN_IN_HOST*/
 
 /*
@@ -7401,8 +8157,7 @@ static int host_int_addBASession(struct WFIDrvHandle *hWFIDrv, char *pBSSID,
 	pBASessionInfo->u16SessionTimeout = SessionTimeout;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -7419,6 +8174,7 @@ signed int host_int_delBASession(struct WFIDrvHandle *hWFIDrv, char *pBSSID,
 	struct WILC_WFIDrv *pstrWFIDrv = (struct WILC_WFIDrv *)hWFIDrv;
 	struct tstrHostIFmsg strHostIFmsg;
 	struct tstrHostIfBASessionInfo *pBASessionInfo = &strHostIFmsg.uniHostIFmsgBody.strHostIfBASessionInfo;
+	struct tstrHostIFreq *pstrReq;
 
 	if (pstrWFIDrv == NULL)
 		WILC_ERRORREPORT(s32Error, WILC_INVALID_ARGUMENT);
@@ -7432,12 +8188,12 @@ signed int host_int_delBASession(struct WFIDrvHandle *hWFIDrv, char *pBSSID,
 	pBASessionInfo->u8Ted = TID;
 	strHostIFmsg.drvHandler = hWFIDrv;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if (s32Error)
-		WILC_ERRORREPORT(s32Error, s32Error);
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		WILC_ERRORREPORT(s32Error, WILC_NO_MEM);
 
-	down(&hWaitResponse);
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	host_if_req_put(pstrReq);
 	
 	WILC_CATCH(s32Error){
 	}
@@ -7472,8 +8228,7 @@ signed int host_int_setup_ipaddress(struct WFIDrvHandle *hWFIDrv, u8 *u16ipadd,
 	strHostIFmsg.drvHandler=hWFIDrv;
 	strHostIFmsg.uniHostIFmsgBody.strHostIfSetIP.idx = idx;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if(s32Error)
 	{
 		WILC_ERRORREPORT(s32Error, s32Error);
@@ -7510,8 +8265,7 @@ signed int host_int_get_ipaddress(struct WFIDrvHandle *hWFIDrv, u8 *u16ipadd,
 	strHostIFmsg.drvHandler = hWFIDrv;
 	strHostIFmsg.uniHostIFmsgBody.strHostIfSetIP.idx = idx;
 
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-				    sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if (s32Error)
 		WILC_ERRORREPORT(s32Error, s32Error);
 
@@ -7542,8 +8296,7 @@ signed int host_int_set_tx_power(struct WFIDrvHandle *hWFIDrv, u8 tx_power)
 	strHostIFmsg.drvHandler=hWFIDrv;
 
 	/* send the message */
-	s32Error = WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-					sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = host_if_msg_post(&strHostIFmsg);
 	if(s32Error)
 		PRINT_ER(" Error in sending messagequeue: PMKID Info\n");
 
@@ -7559,6 +8312,7 @@ signed int  host_int_get_tx_power(struct WFIDrvHandle * hWFIDrv, u8 *tx_power)
 {
 	signed int s32Error = WILC_SUCCESS;	
 	struct tstrHostIFmsg strHostIFmsg;
+	struct tstrHostIFreq *pstrReq;
 
 	
 	/* prepare the Get RSSI Message */
@@ -7566,16 +8320,16 @@ signed int  host_int_get_tx_power(struct WFIDrvHandle * hWFIDrv, u8 *tx_power)
 
 	strHostIFmsg.u16MsgId = HOST_IF_MSG_GET_TX_POWER;
 	strHostIFmsg.drvHandler=hWFIDrv;
-	strHostIFmsg.uniHostIFmsgBody.strHostIFGetTxPwr.u8TxPwr=tx_power;
-	/* send the message */
-	s32Error = 	WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg, 
-					sizeof(struct tstrHostIFmsg), WILC_NULL);
-	if(s32Error){
-		PRINT_ER("Failed to send get host channel param's message queue ");
-		return WILC_FAIL;
-		}
 
-	down(&hWaitResponse);	
+	pstrReq = host_if_req_alloc();
+	if (pstrReq == NULL)
+		return WILC_NO_MEM;
+
+	/* send the message */
+	s32Error = host_if_req_send(&strHostIFmsg, pstrReq, HOST_IF_REQ_TIMEOUT);
+	if (s32Error == WILC_SUCCESS)
+		*tx_power = pstrReq->uniResult.u8Val;
+	host_if_req_put(pstrReq);
 
 	return s32Error;
 }
@@ -7593,8 +8347,7 @@ WILC_Sint32 host_int_set_antenna(struct WFIDrvHandle * hWFIDrv, u8 antenna_mode)
 	strHostIFmsg.uniHostIFmsgBody.pUserData = (char*)antenna_mode;
 	strHostIFmsg.drvHandler	= hWFIDrv;
 	/* send the message */
-	s32Error = 	WILC_MsgQueueSend(&gMsgQHostIF, &strHostIFmsg,
-					sizeof(struct tstrHostIFmsg), WILC_NULL);
+	s32Error = 	host_if_msg_post(&strHostIFmsg);
 	if(s32Error){
 		PRINT_ER("Failed to send get host channel param's message queue ");
 		return WILC_FAIL;
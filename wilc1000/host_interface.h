@@ -55,6 +55,8 @@
 
 #define MAX_NUM_SCANNED_NETWORKS	100 /* 30 */
 #define MAX_NUM_SCANNED_NETWORKS_SHADOW	130
+/* Minimum RSSI change (dB) for an already reported network to be reported again */
+#define SCAN_RSSI_REPORT_DELTA		3
 /*One more than the number of scanned ssids*/
 #define MAX_NUM_PROBED_SSID		10
 #define CHANNEL_SCAN_TIME		250 /* 250 */
@@ -220,9 +222,6 @@ typedef void (*tWILCpfRemainOnChanExpired)(void *, unsigned int);
 typedef void (*tWILCpfRemainOnChanReady)(void *);
 #endif
 
-typedef void (*tWILCpfFrmToLinux)(u8 *, unsigned int, unsigned int);
-typedef void (*tWILCpfFreeEAPBuffParams)(void *);
-
 struct WFIDrvHandle {
 	signed int s32Dummy;
 };
@@ -292,10 +291,6 @@ struct tstrHostIfSetMacAddress {
 	u8 u8MacAddress[ETH_ALEN];
 };
 
-struct tstrHostIfGetMacAddress {
-	u8 *u8MacAddress;
-};
-
 struct tstrHostIfBASessionInfo {
 	u8 au8Bssid[ETH_ALEN];
 	u8 u8Ted;
@@ -329,6 +324,71 @@ enum p2p_listen_state {
 };
 #endif /* WILC_P2P */
 
+#ifdef WILC_SCAN_SCHEDULER
+/*
+ * Host driven scan: the requested channels are sent to the firmware a few at
+ * a time, channels where networks were recently found go first and get the
+ * long active dwell, the others are probed with the short one
+ */
+#define SCAN_SCHED_MAX_CHNLS		14
+#define SCAN_SCHED_CHUNK_LEN		2
+#define SCAN_SCHED_DWELL_MIN		20	/* ms */
+#define SCAN_SCHED_DWELL_MAX		60	/* ms */
+/* Time given back to data traffic on the operating channel between chunks */
+#define SCAN_SCHED_CHUNK_GAP		30	/* ms */
+/*
+ * While connected the next chunk is held back as long as the TX queue is
+ * deeper than SCAN_SCHED_TXQ_DEPTH frames or its oldest frame waited longer
+ * than SCAN_SCHED_TXQ_AGE, polling every SCAN_SCHED_PAUSE_POLL. A scan may be
+ * held back SCAN_SCHED_PAUSE_BUDGET in total, then it goes on regardless.
+ * Waiting for DHCP is not bounded by the budget, hDuringIpTimer bounds it.
+ */
+#define SCAN_SCHED_TXQ_DEPTH		16	/* frames */
+#define SCAN_SCHED_TXQ_AGE		40	/* ms */
+#define SCAN_SCHED_PAUSE_POLL		20	/* ms */
+#define SCAN_SCHED_PAUSE_BUDGET		2000	/* ms */
+
+struct tstrScanSched {
+	bool bActive;
+	/* a short dwell chunk got responses, use the long dwell from now on */
+	bool bBusy;
+	u8 au8ChnlList[SCAN_SCHED_MAX_CHNLS];
+	/* channels that had networks when the scan started, before aging */
+	u16 u16KnownChnls;
+	u8 u8ChnlCount;
+	u8 u8NextChnl;
+	u8 u8ChunkStart;
+	u8 u8ChunkLen;
+	u16 u16Dwell;
+	u8 u8ScanSource;
+	u8 u8ScanType;
+	u8 *pu8IEs;
+	size_t IEsLen;
+	u8 *pu8HdnNtwrksWidVal;
+	unsigned int u32HdnNtwrksLen;
+	unsigned int u32ChunkRcvd;
+	unsigned long u32StartJiffies;
+	/* the next chunk is held since u32PauseStart */
+	bool bPaused;
+	unsigned long u32PauseStart;
+	unsigned int u32PausedMs;
+	struct timer_list hChunkTimer;
+};
+
+struct tstrScanSchedStats {
+	unsigned int u32Scans;
+	unsigned int u32Chunks;
+	unsigned int u32ShortDwellChunks;
+	unsigned int u32EmptyChunks;
+	unsigned int u32Pauses;
+	unsigned int u32PausedMs;
+	unsigned int u32ForcedChunks;
+	unsigned int u32LastDuration;	/* ms */
+	unsigned int u32MaxDuration;	/* ms */
+	unsigned int au32ChnlResults[SCAN_SCHED_MAX_CHNLS];
+};
+#endif /* WILC_SCAN_SCHEDULER */
+
 struct WILC_WFIDrv {
 	/* Scan user structure */
 	struct tstrWILC_UsrScanReq strWILC_UsrScanReq;
@@ -358,16 +418,22 @@ struct WILC_WFIDrv {
 	struct semaphore hSemTestKeyBlock;
 
 	struct semaphore hSemTestDisconnectBlock;
-	struct semaphore hSemGetRSSI;
-	struct semaphore hSemGetLINKSPEED;
-	struct semaphore hSemGetCHNL;
-	struct semaphore hSemInactiveTime;
 
 	struct timer_list hScanTimer;
 	struct timer_list hConnectTimer;
 	#ifdef WILC_P2P
 	struct timer_list hRemainOnChannel;
 	#endif
+	#ifdef WILC_SCAN_SCHEDULER
+	struct tstrScanSched strScanSched;
+	#endif
+
+	/* statistics snapshot served to cfg80211, see host_int_get_cached_statistics() */
+	struct tstrStatistics strStatsCache;
+	struct semaphore hSemStatsCache;
+	unsigned long u32StatsStamp;		/* jiffies of the last refresh */
+	unsigned long u32StatsLastRead;		/* jiffies of the last cache read */
+	bool bStatsValid;
 
 	bool IFC_UP;
 	int driver_handler_id;
@@ -404,15 +470,6 @@ struct WILC_AddStaParam {
 };
 
 
-/*
- * Sends a buffered eap to WPAS
- */
-signed int host_int_send_buffered_eap(struct WFIDrvHandle *hWFIDrv,
-				      tWILCpfFrmToLinux pfFrmToLinux,
-				      tWILCpfFreeEAPBuffParams pfFreeEAPBuffParams,
-				      u8 *pu8Buff, unsigned int u32Size,
-				      unsigned int u32PktOffset,
-				      void *pvUserArg);
 /*
  * Removes wpa/wpa2 keys
  * only in BSS STA mode if External Supplicant support is enabled.
@@ -790,9 +847,13 @@ static int host_int_addBASession(struct WFIDrvHandle *hWFIDrv, char *pBSSID,
 				 short int SessionTimeout, void *drvHandler);
 
 void host_int_freeJoinParams(void *pJoinParams);
+void *host_int_copyJoinParams(void *pJoinParams);
 
 signed int host_int_get_statistics(struct WFIDrvHandle *hWFIDrv,
 				   struct tstrStatistics *pstrStatistics);
+signed int host_int_get_cached_statistics(struct WFIDrvHandle *hWFIDrv,
+					  struct tstrStatistics *pstrStatistics,
+					  unsigned int *pu32AgeMs);
 
 void resolve_disconnect_aberration(void *drvHandler);
 
@@ -39,6 +39,9 @@
 
 #include <linux/version.h>
 #include <linux/semaphore.h>
+#include <linux/seqlock.h>
+#include <asm/unaligned.h>
+#include <linux/jhash.h>
 
 #ifdef WILC_SDIO
 #include "linux_wlan_sdio.h"
@@ -163,6 +166,8 @@ extern void WILC_WFI_p2p_rx(struct net_device *dev,uint8_t *buff, uint32_t size)
 static void* internal_alloc(uint32_t size, uint32_t flag);
 static void linux_wlan_tx_complete(void* priv, int status);
 void frmw_to_linux(uint8_t *buff, uint32_t size,uint32_t pkt_offset);
+static int linux_wlan_demux_stats(char *buf, int size);
+static void linux_wlan_demux_stats_reset(void);
 static int  mac_init_fn(struct net_device *ndev);
 int  mac_xmit(struct sk_buff *skb, struct net_device *dev);
 int  mac_open(struct net_device *ndev);
@@ -394,17 +399,186 @@ static int dev_state_ev_handler(struct notifier_block *this, unsigned long event
 }
 #endif
 
+/*
+ * Scheduling of the RX bottom half and the TX/RX queue threads.
+ * rx_bh_type picks the bottom half when the interface comes up, RX_BH_TYPE
+ * stays the default. Priority (-1 keeps the thread's own policy, 0 normal,
+ * 1-99 SCHED_FIFO) and CPU (-1 any) are applied by each thread itself on
+ * its next run, so they can be changed at runtime through the module
+ * parameters. The threaded IRQ starts as SCHED_FIFO and is only touched
+ * when bh_prio is set. In workqueue mode the bottom half runs on a driver
+ * workqueue, a positive bh_prio makes it WQ_HIGHPRI and bh_cpu picks the
+ * CPU it is queued on.
+ */
+static int rx_bh_type = RX_BH_TYPE;
+module_param(rx_bh_type, int, 0644);
+
+static int bh_prio = -1;
+module_param(bh_prio, int, 0644);
+static int bh_cpu = -1;
+module_param(bh_cpu, int, 0644);
+static int txq_prio = -1;
+module_param(txq_prio, int, 0644);
+static int txq_cpu = -1;
+module_param(txq_cpu, int, 0644);
+static int rxq_prio = -1;
+module_param(rxq_prio, int, 0644);
+static int rxq_cpu = -1;
+module_param(rxq_cpu, int, 0644);
+
+enum {
+	WILC_THREAD_BH = 0,
+	WILC_THREAD_TXQ,
+	WILC_THREAD_RXQ,
+	WILC_THREAD_MAX
+};
+
+static struct wilc_thread_ctl {
+	const char *name;
+	int *prio;
+	int *cpu;
+	int cur_prio;		/* what the thread applied last */
+	int cur_cpu;
+
+	uint32_t runs;
+	uint32_t migrations;
+	int last_cpu;
+	uint64_t run_ns;
+	uint32_t max_run_us;
+	uint64_t lat_ns;	/* interrupt to bottom half */
+	uint32_t max_lat_us;
+} wilc_threads[WILC_THREAD_MAX] = {
+	[WILC_THREAD_BH]	= { "bh",  &bh_prio,  &bh_cpu,  -1, -1 },
+	[WILC_THREAD_TXQ]	= { "txq", &txq_prio, &txq_cpu, -1, -1 },
+	[WILC_THREAD_RXQ]	= { "rxq", &rxq_prio, &rxq_cpu, -1, -1 },
+};
+
+static ktime_t bh_irq_stamp;
+
+static void wilc_thread_sched(int id)
+{
+	struct wilc_thread_ctl *t = &wilc_threads[id];
+	int prio = *t->prio;
+	int cpu = *t->cpu;
+
+	if (prio != t->cur_prio) {
+		struct sched_param param = { .sched_priority = 0 };
+		int policy = SCHED_NORMAL;
+
+		if ((prio > 0) && (prio < MAX_RT_PRIO)) {
+			policy = SCHED_FIFO;
+			param.sched_priority = prio;
+		} else if ((prio < 0) && (id == WILC_THREAD_BH) &&
+			   (g_linux_wlan->rx_bh_type == RX_BH_THREADED_IRQ)) {
+			/* back to what request_threaded_irq() gave the thread */
+			policy = SCHED_FIFO;
+			param.sched_priority = MAX_RT_PRIO / 2;
+		}
+		sched_setscheduler_nocheck(current, policy, &param);
+		t->cur_prio = prio;
+	}
+
+	if (cpu != t->cur_cpu) {
+		if ((cpu >= 0) && (cpu < nr_cpu_ids) && cpu_online(cpu))
+			set_cpus_allowed_ptr(current, cpumask_of(cpu));
+		else
+			set_cpus_allowed_ptr(current, cpu_possible_mask);
+		t->cur_cpu = cpu;
+	}
+}
+
+static void wilc_thread_account(int id, ktime_t start, ktime_t woken)
+{
+	struct wilc_thread_ctl *t = &wilc_threads[id];
+	ktime_t end = ktime_get();
+	int cpu = raw_smp_processor_id();
+	uint32_t us;
+
+	if (t->runs && (cpu != t->last_cpu))
+		t->migrations++;
+	t->last_cpu = cpu;
+	t->runs++;
+
+	t->run_ns += ktime_to_ns(ktime_sub(end, start));
+	us = (uint32_t)ktime_us_delta(end, start);
+	if (us > t->max_run_us)
+		t->max_run_us = us;
+
+	if (ktime_to_ns(woken)) {
+		t->lat_ns += ktime_to_ns(ktime_sub(start, woken));
+		us = (uint32_t)ktime_us_delta(start, woken);
+		if (us > t->max_lat_us)
+			t->max_lat_us = us;
+	}
+}
+
+static const char *rx_bh_name(int type)
+{
+	switch (type) {
+	case RX_BH_KTHREAD:
+		return "kthread";
+	case RX_BH_WORK_QUEUE:
+		return "workqueue";
+	default:
+		return "threaded irq";
+	}
+}
+
+int linux_wlan_thread_stats(char *buf, int size)
+{
+	int res, i;
+
+	res = scnprintf(buf, size, "bh mode %s (next %s)\n",
+			rx_bh_name(g_linux_wlan ? g_linux_wlan->rx_bh_type : rx_bh_type),
+			rx_bh_name(rx_bh_type));
+	res += linux_wlan_demux_stats(buf + res, size - res);
+	for (i = 0; i < WILC_THREAD_MAX; i++) {
+		struct wilc_thread_ctl *t = &wilc_threads[i];
+
+		res += scnprintf(buf + res, size - res,
+				 "%s: prio %d%s cpu %d runs %u migrations %u run avg %u us max %u us",
+				 t->name, *t->prio, (*t->prio < 0) ? " (default)" : "",
+				 *t->cpu, t->runs, t->migrations,
+				 t->runs ? (uint32_t)div_u64(t->run_ns, t->runs * 1000ULL) : 0,
+				 t->max_run_us);
+		if (i == WILC_THREAD_BH)
+			res += scnprintf(buf + res, size - res, " latency avg %u us max %u us",
+					 t->runs ? (uint32_t)div_u64(t->lat_ns, t->runs * 1000ULL) : 0,
+					 t->max_lat_us);
+		res += scnprintf(buf + res, size - res, "\n");
+	}
+
+	return res;
+}
+
+void linux_wlan_thread_stats_reset(void)
+{
+	int i;
+
+	linux_wlan_demux_stats_reset();
+	for (i = 0; i < WILC_THREAD_MAX; i++) {
+		struct wilc_thread_ctl *t = &wilc_threads[i];
+
+		t->runs = 0;
+		t->migrations = 0;
+		t->run_ns = 0;
+		t->max_run_us = 0;
+		t->lat_ns = 0;
+		t->max_lat_us = 0;
+	}
+}
+
 /*
  *	Interrupt initialization and handling functions
  */
 
 void linux_wlan_enable_irq(void){
 
-#if (RX_BH_TYPE != RX_BH_THREADED_IRQ)
 #if (defined WILC_SPI) || (defined WILC_SDIO_IRQ_GPIO)
-	PRINT_D(INT_DBG,"Enabling IRQ ...\n");
-	enable_irq(g_linux_wlan->dev_irq_num);
-#endif
+	if (g_linux_wlan->rx_bh_type != RX_BH_THREADED_IRQ) {
+		PRINT_D(INT_DBG,"Enabling IRQ ...\n");
+		enable_irq(g_linux_wlan->dev_irq_num);
+	}
 #endif
 }
 
@@ -422,79 +596,78 @@ void linux_wlan_disable_irq(int wait){
 
 #if (defined WILC_SPI) || (defined WILC_SDIO_IRQ_GPIO)
 static irqreturn_t isr_uh_routine(int irq, void* user_data){
-
+	int threaded = (g_linux_wlan->rx_bh_type == RX_BH_THREADED_IRQ);
 
 	int_rcvdU++;
-#if (RX_BH_TYPE != RX_BH_THREADED_IRQ)
-	linux_wlan_disable_irq(IRQ_NO_WAIT);
-#endif
+	if (!threaded)
+		linux_wlan_disable_irq(IRQ_NO_WAIT);
 	PRINT_D(INT_DBG,"Interrupt received UH\n");
 
     /*While mac is closing cacncel the handling of any interrupts received*/
 	if(g_linux_wlan->close)
 	{
 		PRINT_ER("Driver is CLOSING: Can't handle UH interrupt\n");
-	#if (RX_BH_TYPE == RX_BH_THREADED_IRQ)
-		return IRQ_HANDLED;
-	#else
-		return IRQ_NONE;
-	#endif
-
+		return threaded ? IRQ_HANDLED : IRQ_NONE;
 	}
-#if (RX_BH_TYPE == RX_BH_WORK_QUEUE)
-	schedule_work(&g_linux_wlan->rx_work_queue);
-	return IRQ_HANDLED;
-#elif (RX_BH_TYPE == RX_BH_KTHREAD)
-	linux_wlan_unlock(&g_linux_wlan->rx_sem);
-	return IRQ_HANDLED;
-#elif (RX_BH_TYPE == RX_BH_THREADED_IRQ)
-	return IRQ_WAKE_THREAD;
-#endif
 
+	bh_irq_stamp = ktime_get();
+	switch (g_linux_wlan->rx_bh_type) {
+	case RX_BH_WORK_QUEUE:
+		if ((bh_cpu >= 0) && (bh_cpu < nr_cpu_ids) && cpu_online(bh_cpu))
+			queue_work_on(bh_cpu, g_linux_wlan->rx_bh_wq, &g_linux_wlan->rx_work_queue);
+		else
+			queue_work(g_linux_wlan->rx_bh_wq, &g_linux_wlan->rx_work_queue);
+		return IRQ_HANDLED;
+	case RX_BH_KTHREAD:
+		linux_wlan_unlock(&g_linux_wlan->rx_sem);
+		return IRQ_HANDLED;
+	default:
+		return IRQ_WAKE_THREAD;
+	}
 }
 #endif
 
-#if (RX_BH_TYPE == RX_BH_WORK_QUEUE || RX_BH_TYPE == RX_BH_THREADED_IRQ)
+static void isr_bh_handle(void)
+{
+	ktime_t start = ktime_get();
 
-#if (RX_BH_TYPE == RX_BH_THREADED_IRQ)
-irqreturn_t isr_bh_routine(int irq, void *userdata){	
-	linux_wlan_t* nic;
-	nic = (linux_wlan_t*)userdata;
-#else
-static void isr_bh_routine(struct work_struct *work){
-	perInterface_wlan_t* nic;
-	nic = (perInterface_wlan_t*)container_of(work,linux_wlan_t,rx_work_queue);
-#endif	
+	int_rcvdB++;
+	PRINT_D(INT_DBG,"Interrupt received BH\n");
+	if(g_linux_wlan->oup.wlan_handle_rx_isr != 0){
+		g_linux_wlan->oup.wlan_handle_rx_isr();
+	}else{
+			PRINT_ER("wlan_handle_rx_isr() hasn't been initialized\n");
+		}
+	wilc_thread_account(WILC_THREAD_BH, start, bh_irq_stamp);
+}
+
+static irqreturn_t isr_bh_threaded(int irq, void *userdata){
 
 	/*While mac is closing cacncel the handling of any interrupts received*/
 	if(g_linux_wlan->close)
 	{
 		PRINT_ER("Driver is CLOSING: Can't handle BH interrupt\n");
-	#if (RX_BH_TYPE == RX_BH_THREADED_IRQ)
 		return IRQ_HANDLED;
-	#else
-		return;
-	#endif
+	}
 
+	wilc_thread_sched(WILC_THREAD_BH);
+	isr_bh_handle();
+	return IRQ_HANDLED;
+}
 
+static void isr_bh_work(struct work_struct *work){
 
+	/*While mac is closing cacncel the handling of any interrupts received*/
+	if(g_linux_wlan->close)
+	{
+		PRINT_ER("Driver is CLOSING: Can't handle BH interrupt\n");
+		return;
 	}
 
-	int_rcvdB++;
-	PRINT_D(INT_DBG,"Interrupt received BH\n");
-	if(g_linux_wlan->oup.wlan_handle_rx_isr != 0){
-		g_linux_wlan->oup.wlan_handle_rx_isr();
-	}else{
-			PRINT_ER("wlan_handle_rx_isr() hasn't been initialized\n");
-		}
-
-
-#if (RX_BH_TYPE == RX_BH_THREADED_IRQ)
-	return IRQ_HANDLED;
-#endif
+	isr_bh_handle();
 }
-#elif (RX_BH_TYPE == RX_BH_KTHREAD)
-static int isr_bh_routine(void *vp)
+
+static int isr_bh_kthread(void *vp)
 {
 	linux_wlan_t* nic;
 	
@@ -509,18 +682,12 @@ static int isr_bh_routine(void *vp)
 
 			break;
 		}
-		int_rcvdB++;
-		PRINT_D(INT_DBG,"Interrupt received BH\n");
-		if(g_linux_wlan->oup.wlan_handle_rx_isr != 0){
-			g_linux_wlan->oup.wlan_handle_rx_isr();
-		} else{
-				PRINT_ER("wlan_handle_rx_isr() hasn't been initialized\n");
-		}
+		wilc_thread_sched(WILC_THREAD_BH);
+		isr_bh_handle();
 	}
 
 	return 0;
 }
-#endif
 
 
 #if (defined WILC_SPI) || (defined WILC_SDIO_IRQ_GPIO)
@@ -553,17 +720,17 @@ static int init_irq(linux_wlan_t* p_nic){
 		}
 
 
-#if (RX_BH_TYPE == RX_BH_THREADED_IRQ)
-		if( (ret != -1) && ( request_threaded_irq(nic->dev_irq_num, isr_uh_routine, isr_bh_routine,
-				  				IRQF_TRIGGER_LOW | IRQF_ONESHOT, /*Without IRQF_ONESHOT the uh will remain kicked in and dont gave a chance to bh*/
-				   				"WILC_IRQ", nic))<0){
-
-#else
-		/*Request IRQ*/
-		if( (ret != -1) && (request_irq(nic->dev_irq_num, isr_uh_routine,
-				IRQF_TRIGGER_LOW, "WILC_IRQ", nic) < 0)){
-
-#endif
+		if (ret != -1) {
+			if (nic->rx_bh_type == RX_BH_THREADED_IRQ)
+				ret = request_threaded_irq(nic->dev_irq_num, isr_uh_routine, isr_bh_threaded,
+							   IRQF_TRIGGER_LOW | IRQF_ONESHOT, /*Without IRQF_ONESHOT the uh will remain kicked in and dont gave a chance to bh*/
+							   "WILC_IRQ", nic);
+			else
+				/*Request IRQ*/
+				ret = request_irq(nic->dev_irq_num, isr_uh_routine,
+						  IRQF_TRIGGER_LOW, "WILC_IRQ", nic);
+		}
+		if (ret < 0) {
 				PRINT_ER("Failed to request IRQ for GPIO: %d\n",GPIO_NUM);
 				ret = -1;
 		}else{			
@@ -645,6 +812,127 @@ static void* internal_alloc(uint32_t size, uint32_t flag){
 }
 
 
+#ifdef WILC_LOCK_PROFILE
+/*
+ * Lock profiling: acquisition count, contention count, wait time histogram
+ * (log2 of usec) and max hold time of the bus, TX queue and config locks.
+ * The counters of a lock are only updated while holding it, except for
+ * cfg_wait which is a pure wait and has a single waiter (the host thread).
+ * cfg_wait is an event rather than a lock: it is contended only when the
+ * response was not there yet and the waiter blocked, and its hold time is
+ * how long a posted response waited to be picked up, credited to the site
+ * that posted it.
+ */
+#define LOCK_PROF_HIST_BINS	16
+
+enum {
+	LOCK_PROF_HIF = 0,
+	LOCK_PROF_TXQ_SPIN,
+	LOCK_PROF_CFG_WAIT,
+	LOCK_PROF_MAX
+};
+
+struct wilc_lock_prof {
+	const char *name;
+	uint32_t acquired;
+	uint32_t contended;
+	uint32_t timeouts;
+	uint32_t max_wait;	/* usec */
+	uint32_t max_hold;	/* usec */
+	void *max_hold_site;
+	uint32_t wait_hist[LOCK_PROF_HIST_BINS];
+	ktime_t hold_start;
+	void *hold_site;
+};
+
+static struct wilc_lock_prof lock_prof[LOCK_PROF_MAX] = {
+	[LOCK_PROF_HIF]		= { .name = "hif_lock" },
+	[LOCK_PROF_TXQ_SPIN]	= { .name = "txq_spinlock" },
+	[LOCK_PROF_CFG_WAIT]	= { .name = "cfg_wait" },
+};
+
+static int lock_prof_id(void *vp)
+{
+	if (g_linux_wlan == NULL)
+		return -1;
+	if (vp == &g_linux_wlan->hif_cs)
+		return LOCK_PROF_HIF;
+	if (vp == &g_linux_wlan->txq_spinlock)
+		return LOCK_PROF_TXQ_SPIN;
+	if (vp == &g_linux_wlan->cfg_event)
+		return LOCK_PROF_CFG_WAIT;
+	return -1;
+}
+
+static void lock_prof_acquired(int id, ktime_t wait_start, int contended, void *site)
+{
+	struct wilc_lock_prof *prof = &lock_prof[id];
+	uint32_t wait = 0;
+	int bin;
+
+	prof->hold_start = ktime_get();
+	prof->hold_site = site;
+	prof->acquired++;
+	if (contended) {
+		prof->contended++;
+		wait = (uint32_t)ktime_us_delta(prof->hold_start, wait_start);
+	}
+	if (wait > prof->max_wait)
+		prof->max_wait = wait;
+
+	bin = fls(wait);
+	if (bin >= LOCK_PROF_HIST_BINS)
+		bin = LOCK_PROF_HIST_BINS - 1;
+	prof->wait_hist[bin]++;
+}
+
+static void lock_prof_released(int id)
+{
+	struct wilc_lock_prof *prof = &lock_prof[id];
+	uint32_t hold = (uint32_t)ktime_us_delta(ktime_get(), prof->hold_start);
+
+	if (hold > prof->max_hold) {
+		prof->max_hold = hold;
+		prof->max_hold_site = prof->hold_site;
+	}
+}
+
+int wilc_lock_prof_print(char *buf, int size)
+{
+	int res = 0;
+	int i, j;
+
+	for (i = 0; i < LOCK_PROF_MAX; i++) {
+		struct wilc_lock_prof *prof = &lock_prof[i];
+
+		res += scnprintf(buf + res, size - res,
+				 "%s: acquired %u contended %u timeouts %u max wait %u us max hold %u us (%pS)\n  wait hist:",
+				 prof->name, prof->acquired, prof->contended, prof->timeouts,
+				 prof->max_wait, prof->max_hold, prof->max_hold_site);
+		for (j = 0; j < LOCK_PROF_HIST_BINS; j++)
+			res += scnprintf(buf + res, size - res, " %u", prof->wait_hist[j]);
+		res += scnprintf(buf + res, size - res, "\n");
+	}
+
+	return res;
+}
+
+void wilc_lock_prof_reset(void)
+{
+	int i;
+
+	for (i = 0; i < LOCK_PROF_MAX; i++) {
+		lock_prof[i].acquired = 0;
+		lock_prof[i].contended = 0;
+		lock_prof[i].timeouts = 0;
+		lock_prof[i].max_wait = 0;
+		lock_prof[i].max_hold = 0;
+		lock_prof[i].max_hold_site = NULL;
+		memset(lock_prof[i].wait_hist, 0, sizeof(lock_prof[i].wait_hist));
+	}
+}
+#endif /* WILC_LOCK_PROFILE */
+
 static void linux_wlan_init_lock(char* lockName, void* plock,int count)
 {
 	sema_init((struct semaphore*)plock,count);
@@ -673,10 +961,34 @@ static void linux_wlan_lock(void* vp)
 static int linux_wlan_lock_timeout(void* vp,WILC_Uint32 timeout)
 {
 	int error = -1;
+#ifdef WILC_LOCK_PROFILE
+	int id = lock_prof_id(vp);
+	ktime_t wait_start = ktime_get();
+#endif
 	PRINT_D(LOCK_DBG,"Locking %p\n",vp);
 	if(vp != NULL)
 	{		
+#ifdef WILC_LOCK_PROFILE
+		int contended = 0;
+
+		if (id >= 0 && down_trylock((struct semaphore*)vp) == 0) {
+			error = 0;
+		} else {
+			contended = 1;
+			error = down_timeout((struct semaphore*)vp, msecs_to_jiffies(timeout));
+		}
+		if (id >= 0) {
+			if (error) {
+				lock_prof[id].timeouts++;
+			} else {
+				if (id == LOCK_PROF_CFG_WAIT)
+					lock_prof_released(id);
+				lock_prof_acquired(id, wait_start, contended, __builtin_return_address(0));
+			}
+		}
+#else
 		error = down_timeout((struct semaphore*)vp, msecs_to_jiffies(timeout));
+#endif
 	}
 	else
 	{
@@ -690,6 +1002,13 @@ void linux_wlan_unlock(void* vp)
 	PRINT_D(LOCK_DBG,"Unlocking %p\n",vp);
 	if(vp != NULL)
 	{
+#ifdef WILC_LOCK_PROFILE
+		if (lock_prof_id(vp) == LOCK_PROF_CFG_WAIT) {
+			/* hold of an event runs from posting it till it is taken */
+			lock_prof[LOCK_PROF_CFG_WAIT].hold_start = ktime_get();
+			lock_prof[LOCK_PROF_CFG_WAIT].hold_site = __builtin_return_address(0);
+		}
+#endif
 		up((struct semaphore*)vp);			
 	}
 	else
@@ -722,6 +1041,18 @@ static void linux_wlan_lock_mutex(void* vp)
 			//PRINT_ER("Mutex already locked - %p \n",vp);
 		}
 */
+#ifdef WILC_LOCK_PROFILE
+		int id = lock_prof_id(vp);
+
+		if (id >= 0) {
+			ktime_t wait_start = ktime_get();
+			int contended = !mutex_trylock((struct mutex*)vp);
+
+			if (contended)
+				mutex_lock((struct mutex*)vp);
+			lock_prof_acquired(id, wait_start, contended, __builtin_return_address(0));
+		} else
+#endif
 		mutex_lock((struct mutex*)vp);		
 
 	}else
@@ -735,6 +1066,12 @@ static void linux_wlan_unlock_mutex(void* vp){
 	if(vp != NULL){
 
 		if(mutex_is_locked((struct mutex*)vp)){
+#ifdef WILC_LOCK_PROFILE
+			int id = lock_prof_id(vp);
+
+			if (id >= 0)
+				lock_prof_released(id);
+#endif
 			mutex_unlock((struct mutex*)vp);			
 			}else{
 					//PRINT_ER("Mutex already unlocked  - %p\n",vp);
@@ -762,6 +1099,18 @@ static void linux_wlan_spin_lock(void* vp, unsigned long *flags){
 	unsigned long lflags;
 	PRINT_D(SPIN_DEBUG,"Lock spin %p\n",vp);
 	if(vp != NULL){
+#ifdef WILC_LOCK_PROFILE
+		int id = lock_prof_id(vp);
+
+		if (id >= 0) {
+			ktime_t wait_start = ktime_get();
+			int contended = !spin_trylock_irqsave((spinlock_t*)vp, lflags);
+
+			if (contended)
+				spin_lock_irqsave((spinlock_t*)vp, lflags);
+			lock_prof_acquired(id, wait_start, contended, __builtin_return_address(0));
+		} else
+#endif
 		spin_lock_irqsave((spinlock_t*)vp, lflags);
 		*flags = lflags;
 	}
@@ -773,6 +1122,12 @@ static void linux_wlan_spin_unlock(void* vp, unsigned long *flags){
 	unsigned long lflags= *flags;
 	PRINT_D(SPIN_DEBUG,"Unlock spin %p\n",vp);
 	if(vp != NULL){
+#ifdef WILC_LOCK_PROFILE
+		int id = lock_prof_id(vp);
+
+		if (id >= 0)
+			lock_prof_released(id);
+#endif
 		spin_unlock_irqrestore((spinlock_t*)vp, lflags);
 		*flags = lflags;
 	}
@@ -829,89 +1184,180 @@ static void linux_wlan_mac_indicate(int flag){
 
 }
 
-/*TicketId1001*/
-/* Free buffered eapol allocated in priv struct */
-void free_EAP_buff_params(void *pUserVoid)
+/*
+ * TicketId1001
+ * EAPOL 1/4 can come in before CfgConnectResult() has told the supplicant
+ * about the connection, and it would drop it. Such frames are held on a
+ * short per interface queue that linux_wlan_eapol_flush() empties as soon
+ * as the connection result is out, instead of polling for it.
+ */
+static uint32_t rx_eapol_held;
+static uint32_t rx_eapol_overflow;
+
+static bool linux_wlan_eapol_hold(struct WILC_WFI_priv *priv, struct sk_buff *skb)
+{
+	struct sk_buff *old = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->strEAPQueue.lock, flags);
+	if (priv->bConnReported) {
+		spin_unlock_irqrestore(&priv->strEAPQueue.lock, flags);
+		return false;
+	}
+	/* the AP retransmits, the newest frames are the ones to keep */
+	if (skb_queue_len(&priv->strEAPQueue) >= WILC_EAPOL_QUEUE_LEN)
+		old = __skb_dequeue(&priv->strEAPQueue);
+	__skb_queue_tail(&priv->strEAPQueue, skb);
+	spin_unlock_irqrestore(&priv->strEAPQueue.lock, flags);
+
+	rx_eapol_held++;
+	if (old != NULL) {
+		rx_eapol_overflow++;
+		kfree_skb(old);
+	}
+	PRINT_D(GENERIC_DBG, "eapol held till the connection is reported\n");
+	return true;
+}
+
+/*
+ * Called from CfgConnectResult(), connected passes the held frames up and
+ * lets new ones through, otherwise they are dropped and new ones held.
+ */
+void linux_wlan_eapol_flush(struct WILC_WFI_priv *priv, bool connected)
 {
-	struct WILC_WFI_priv *priv;
+	struct sk_buff_head list;
+	struct sk_buff *skb;
+	unsigned long flags;
 
-	priv = (struct WILC_WFI_priv *)pUserVoid;
+	__skb_queue_head_init(&list);
 
-	/*Free allocated memory for buffered frame*/
-	if (priv->pStrBufferedEAP != NULL) {
-		if (priv->pStrBufferedEAP->pu8buff != NULL) {
-			kfree(priv->pStrBufferedEAP->pu8buff);
-			priv->pStrBufferedEAP->pu8buff = NULL;
-		}
-		kfree(priv->pStrBufferedEAP);
-		priv->pStrBufferedEAP = NULL;
+	spin_lock_irqsave(&priv->strEAPQueue.lock, flags);
+	priv->bConnReported = connected;
+	skb_queue_splice_init(&priv->strEAPQueue, &list);
+	spin_unlock_irqrestore(&priv->strEAPQueue.lock, flags);
+
+	while ((skb = __skb_dequeue(&list)) != NULL) {
+		if (connected)
+			netif_rx_ni(skb);
+		else
+			kfree_skb(skb);
 	}
 }
 
 /*
- * TicketId1001
- * Timeout function for a bufferd eapol 1/4
- * The function checks if successful connection is reported to upper layer,
- * then pass buffered eapol 1/4
+ * RX interface demux. The RX header has no room for an interface id, so
+ * frames are matched on addr2 (station interfaces, the BSSID we are
+ * connected to) then addr1 (AP interfaces, our own address). The table
+ * only holds interfaces that have a BSSID, with the address packed for
+ * two compares per entry. linux_wlan_set_bssid() rebuilds it under the
+ * seqlock, the RX path retries its lookup if a rebuild ran meanwhile.
  */
-void EAP_buff_timeout(unsigned long pUserVoid)
+struct wilc_if_demux_ent {
+	uint32_t hi;
+	uint16_t lo;
+	struct net_device *netdev;
+};
+
+struct wilc_if_demux {
+	uint8_t n_sta;
+	uint8_t n_ap;
+	struct wilc_if_demux_ent sta[NUM_CONCURRENT_IFC];
+	struct wilc_if_demux_ent ap[NUM_CONCURRENT_IFC];
+};
+
+static struct wilc_if_demux if_demux;
+static DEFINE_SEQLOCK(if_demux_lock);
+static uint32_t if_demux_sta_hits;
+static uint32_t if_demux_ap_hits;
+static uint32_t if_demux_drops;	/* no interface matched */
+
+static void linux_wlan_demux_rebuild(void)
 {
-	u8 null_bssid[ETH_ALEN] = {0};
-	static u8 timeout = 5;
-	signed int status = WILC_FAIL;
-	struct WILC_WFI_priv *priv;
+	struct wilc_if_demux_ent *e;
+	uint8_t null_bssid[ETH_ALEN] = {0};
+	uint8_t n_sta = 0, n_ap = 0;
+	unsigned long flags;
+	int i;
 
-	priv = (struct WILC_WFI_priv *)pUserVoid;
+	write_seqlock_irqsave(&if_demux_lock, flags);
+	for (i = 0; i < g_linux_wlan->u8NoIfcs; i++) {
+		tstrInterfaceInfo *ifc = &g_linux_wlan->strInterfaceInfo[i];
 
-	/*If successful connection is not yet reported, keep waiting*/
-	if (!(memcmp(priv->au8AssociatedBss, null_bssid, ETH_ALEN)) && (timeout-- > 0))	{
-		hEAPFrameBuffTimer.data = (unsigned long)pUserVoid;
-		mod_timer(&hEAPFrameBuffTimer, (jiffies + msecs_to_jiffies(10)));
-		return;
+		if (!memcmp(ifc->aBSSID, null_bssid, ETH_ALEN))
+			continue;
+
+		if (ifc->u8IfcType == STATION_MODE)
+			e = &if_demux.sta[n_sta++];
+		else if (ifc->u8IfcType == AP_MODE)
+			e = &if_demux.ap[n_ap++];
+		else
+			continue;
+
+		e->hi = get_unaligned((uint32_t *)ifc->aBSSID);
+		e->lo = get_unaligned((uint16_t *)(ifc->aBSSID + 4));
+		e->netdev = ifc->wilc_netdev;
 	}
-	timeout = 5;
+	/* counts last, the entries below them are complete */
+	if_demux.n_sta = n_sta;
+	if_demux.n_ap = n_ap;
+	write_sequnlock_irqrestore(&if_demux_lock, flags);
+}
+
+static struct net_device *linux_wlan_demux_match(struct wilc_if_demux_ent *e, int n,
+						 uint8_t *addr)
+{
+	uint32_t hi = get_unaligned((uint32_t *)addr);
+	uint16_t lo = get_unaligned((uint16_t *)(addr + 4));
+	int i;
 
-	/*Pass frame to upper layer through host interface thread*/
-	status = host_int_send_buffered_eap(priv->hWILCWFIDrv
-					    , frmw_to_linux
-					    , free_EAP_buff_params
-					    , priv->pStrBufferedEAP->pu8buff
-					    , priv->pStrBufferedEAP->u32Size
-					    , priv->pStrBufferedEAP->u32PktOffset
-					    , (void *)priv);
-	if (status)
-		PRINT_ER("Failed so send buffered eap\n");
+	for (i = 0; i < n; i++) {
+		if (e[i].hi == hi && e[i].lo == lo)
+			return e[i].netdev;
+	}
+
+	return NULL;
 }
-struct net_device * GetIfHandler(uint8_t* pMacHeader)
+
+static int linux_wlan_demux_stats(char *buf, int size)
 {
-	uint8_t *Bssid,*Bssid1,offset = 10;
-	int i =0;
+	return scnprintf(buf, size, "rx demux: sta %u ap %u no interface %u\n",
+			 if_demux_sta_hits, if_demux_ap_hits, if_demux_drops);
+}
 
-	Bssid  = pMacHeader+10;
-	Bssid1 = pMacHeader+4;
+static void linux_wlan_demux_stats_reset(void)
+{
+	if_demux_sta_hits = 0;
+	if_demux_ap_hits = 0;
+	if_demux_drops = 0;
+}
 
-	offset = 10;
-	for(i=0;i<g_linux_wlan->u8NoIfcs;i++)
-	{
-		if(g_linux_wlan->strInterfaceInfo[i].u8IfcType == STATION_MODE)
-		{
-			if(!memcmp(pMacHeader+offset,g_linux_wlan->strInterfaceInfo[i].aBSSID,ETH_ALEN))			
-			{			
-				return g_linux_wlan->strInterfaceInfo[i].wilc_netdev;
-			}
-		}
-	}
-	offset = 4;
-	for(i=0;i<g_linux_wlan->u8NoIfcs;i++)
-	{
-		if(g_linux_wlan->strInterfaceInfo[i].u8IfcType == AP_MODE)
-		{
-			if(!memcmp(pMacHeader+offset,g_linux_wlan->strInterfaceInfo[i].aBSSID,ETH_ALEN))			
-			{			
-				return g_linux_wlan->strInterfaceInfo[i].wilc_netdev;
-			}
-		}
+struct net_device * GetIfHandler(uint8_t* pMacHeader)
+{
+	struct net_device *netdev;
+	unsigned int seq;
+	bool sta;
+
+	do {
+		seq = read_seqbegin(&if_demux_lock);
+		netdev = linux_wlan_demux_match(if_demux.sta, if_demux.n_sta,
+						pMacHeader + 10);
+		sta = (netdev != NULL);
+		if (!sta)
+			netdev = linux_wlan_demux_match(if_demux.ap, if_demux.n_ap,
+							pMacHeader + 4);
+	} while (read_seqretry(&if_demux_lock, seq));
+
+	if (netdev != NULL) {
+		if (sta)
+			if_demux_sta_hits++;
+		else
+			if_demux_ap_hits++;
+		return netdev;
 	}
+
+	if_demux_drops++;
+	PRINT_D(RX_DBG, "No interface for frame from %pM\n", pMacHeader + 10);
+	return NULL;
 	#if 0
 	PRINT_INFO(INIT_DBG,"Invalide handle\n");
 	for(i=0;i<25;i++)
@@ -951,6 +1397,7 @@ int linux_wlan_set_bssid(struct net_device * wilc_netdev,uint8_t * pBSSID,uint8_
 			break;
 		}		
 	}
+	linux_wlan_demux_rebuild();
 	return ret;
 }
 
@@ -979,6 +1426,7 @@ struct net_device* linux_wlan_get_if_netdev(uint8_t ifc)
 
 
 static int linux_wlan_rxq_task(void* vp){
+	ktime_t start;
 
 	/* inform wilc1000_wlan_init that RXQ task is started. */
 	linux_wlan_unlock(&g_linux_wlan->rxq_thread_started);
@@ -998,7 +1446,10 @@ static int linux_wlan_rxq_task(void* vp){
 		}
 		PRINT_D(RX_DBG,"Calling wlan_handle_rx_que()\n");
 		
+		wilc_thread_sched(WILC_THREAD_RXQ);
+		start = ktime_get();
 		g_linux_wlan->oup.wlan_handle_rx_que();		
+		wilc_thread_account(WILC_THREAD_RXQ, start, ktime_set(0, 0));
 	}
 	return 0;
 }
@@ -1008,6 +1459,7 @@ static int linux_wlan_rxq_task(void* vp){
 static int linux_wlan_txq_task(void* vp)
 {
 	int ret,txq_count;
+	ktime_t start;
 
 #if defined USE_TX_BACKOFF_DELAY_IF_NO_BUFFERS
 #define TX_BACKOFF_WEIGHT_INCR_STEP (1)
@@ -1039,6 +1491,8 @@ static int linux_wlan_txq_task(void* vp)
 			break;		
 		}
 		PRINT_D(TX_DBG,"txq_task handle the sending packet and let me go to sleep.\n");
+		wilc_thread_sched(WILC_THREAD_TXQ);
+		start = ktime_get();
 #if !defined USE_TX_BACKOFF_DELAY_IF_NO_BUFFERS
 		g_linux_wlan->oup.wlan_handle_tx_que();		
 #else
@@ -1083,6 +1537,7 @@ static int linux_wlan_txq_task(void* vp)
 			/*TODO: drop packets after a certain time/number of retry count. */
 		} while(ret == WILC_TX_ERR_NO_BUF&&!g_linux_wlan->close); /* retry sending packets if no more buffers in chip. */
 #endif
+		wilc_thread_account(WILC_THREAD_TXQ, start, ktime_set(0, 0));
 	}
 	return 0;
 }
@@ -1545,15 +2000,9 @@ void wilc1000_wlan_deinit(linux_wlan_t *nic) {
 			}
 
 
-	#if (RX_BH_TYPE == RX_BH_WORK_QUEUE)
-		/*Removing the work struct from the linux kernel workqueue*/
-		if(&g_linux_wlan->rx_work_queue != NULL)
+		/*Removing the work struct from the driver workqueue*/
+		if (g_linux_wlan->rx_bh_type == RX_BH_WORK_QUEUE)
 			flush_work(&g_linux_wlan->rx_work_queue);
-		
-	#elif (RX_BH_TYPE == RX_BH_KTHREAD)
-		//if(&nic->rx_sem != NULL)
-			//linux_wlan_unlock(&nic->rx_sem);
-	#endif
 
 	PRINT_D(INIT_DBG,"Deinitializing Threads\n");
 	wlan_deinitialize_threads(nic);
@@ -1618,9 +2067,7 @@ int wlan_init_locks(linux_wlan_t* p_nic){
 	linux_wlan_init_lock("rxq_lock/rxq_started",&g_linux_wlan->rxq_thread_started,0);
 	linux_wlan_init_lock("rxq_lock/txq_started",&g_linux_wlan->txq_thread_started,0);
 
-	#if (RX_BH_TYPE == RX_BH_KTHREAD)
-		linux_wlan_init_lock("BH_SEM", &g_linux_wlan->rx_sem, 0);
-	#endif
+	linux_wlan_init_lock("BH_SEM", &g_linux_wlan->rx_sem, 0);
 
 	return 0;
 }
@@ -1714,6 +2161,9 @@ void linux_to_wlan(wilc_wlan_inp_t* nwi,linux_wlan_t* nic){
 	nwi->io_func.u.sdio.sdio_cmd53 = linux_sdio_cmd53;
 	nwi->io_func.u.sdio.sdio_set_max_speed = linux_sdio_set_max_speed;
 	nwi->io_func.u.sdio.sdio_set_default_speed = linux_sdio_set_default_speed;
+	nwi->io_func.u.sdio.sdio_claim = linux_sdio_claim;
+	nwi->io_func.u.sdio.sdio_release = linux_sdio_release;
+	nwi->io_func.u.sdio.sdio_max_block_size = linux_sdio_max_block_size;
 #else
 	nwi->io_func.io_type = HIF_SPI;
 	nwi->io_func.io_init = linux_spi_init;
@@ -1721,7 +2171,10 @@ void linux_to_wlan(wilc_wlan_inp_t* nwi,linux_wlan_t* nic){
 	nwi->io_func.u.spi.spi_tx = linux_spi_write;
 	nwi->io_func.u.spi.spi_rx = linux_spi_read;
 	nwi->io_func.u.spi.spi_trx = linux_spi_write_read;
+	nwi->io_func.u.spi.spi_tx_async = linux_spi_write_async;
+	nwi->io_func.u.spi.spi_tx_async_flush = linux_spi_write_async_flush;
 	nwi->io_func.u.spi.spi_max_speed = linux_spi_set_max_speed;
+	nwi->io_func.u.spi.spi_default_speed = linux_spi_set_default_speed;
 #endif
 	
 	/*for now - to be revised*/
@@ -1738,20 +2191,34 @@ void linux_to_wlan(wilc_wlan_inp_t* nwi,linux_wlan_t* nic){
 int wlan_initialize_threads(perInterface_wlan_t* nic){
 
 	int ret = 0;
+	int i;
 	PRINT_D(INIT_DBG,"Initializing Threads ...\n");
 
-#if (RX_BH_TYPE == RX_BH_WORK_QUEUE)
-	/*Initialize rx work queue task*/
-	INIT_WORK(&g_linux_wlan->rx_work_queue, isr_bh_routine);
-#elif (RX_BH_TYPE == RX_BH_KTHREAD)
-	PRINT_D(INIT_DBG,"Creating kthread for Rxq BH\n");
-	g_linux_wlan->rx_bh_thread = kthread_run(isr_bh_routine,(void*)g_linux_wlan,"K_RXQ_BH");
-	if(g_linux_wlan->rx_bh_thread == 0){
-		PRINT_ER("couldn't create RX BH thread\n");
-		ret = -ENOBUFS;
-		goto _fail_;
+	/* new threads start with their default policy and any CPU */
+	for (i = 0; i < WILC_THREAD_MAX; i++) {
+		wilc_threads[i].cur_prio = -1;
+		wilc_threads[i].cur_cpu = -1;
+	}
+
+	if (g_linux_wlan->rx_bh_type == RX_BH_WORK_QUEUE) {
+		/*Initialize rx work queue task*/
+		g_linux_wlan->rx_bh_wq = alloc_workqueue("wilc_bh",
+							 WQ_MEM_RECLAIM | ((bh_prio > 0) ? WQ_HIGHPRI : 0), 1);
+		if (!g_linux_wlan->rx_bh_wq) {
+			PRINT_ER("couldn't create RX BH workqueue\n");
+			ret = -ENOBUFS;
+			goto _fail_;
+		}
+		INIT_WORK(&g_linux_wlan->rx_work_queue, isr_bh_work);
+	} else if (g_linux_wlan->rx_bh_type == RX_BH_KTHREAD) {
+		PRINT_D(INIT_DBG,"Creating kthread for Rxq BH\n");
+		g_linux_wlan->rx_bh_thread = kthread_run(isr_bh_kthread,(void*)g_linux_wlan,"K_RXQ_BH");
+		if(g_linux_wlan->rx_bh_thread == 0){
+			PRINT_ER("couldn't create RX BH thread\n");
+			ret = -ENOBUFS;
+			goto _fail_;
+		}
 	}
-#endif
 
 #ifndef TCP_ENHANCEMENTS
 	/* create rx task */
@@ -1797,13 +2264,18 @@ int wlan_initialize_threads(perInterface_wlan_t* nic){
 		kthread_stop(g_linux_wlan->rxq_thread);
 
 	_fail_1:
-	#if(RX_BH_TYPE == RX_BH_KTHREAD)
-		/*De-Initialize 1st thread*/
-		g_linux_wlan->close = 1;
-		linux_wlan_unlock(&g_linux_wlan->rx_sem);
-		kthread_stop(g_linux_wlan->rx_bh_thread);
+		if (g_linux_wlan->rx_bh_type == RX_BH_KTHREAD) {
+			/*De-Initialize 1st thread*/
+			g_linux_wlan->close = 1;
+			linux_wlan_unlock(&g_linux_wlan->rx_sem);
+			kthread_stop(g_linux_wlan->rx_bh_thread);
+			g_linux_wlan->rx_bh_thread = NULL;
+		}
+		if (g_linux_wlan->rx_bh_wq) {
+			destroy_workqueue(g_linux_wlan->rx_bh_wq);
+			g_linux_wlan->rx_bh_wq = NULL;
+		}
 	_fail_:
-	#endif
 		g_linux_wlan->close = 0;
 		return ret;	
 }
@@ -1831,15 +2303,16 @@ static void wlan_deinitialize_threads(linux_wlan_t* nic){
 		g_linux_wlan->txq_thread = NULL;
 		}
 	
-	#if(RX_BH_TYPE == RX_BH_KTHREAD)
-		if(&g_linux_wlan->rx_sem != NULL)
-			linux_wlan_unlock(&g_linux_wlan->rx_sem);
-	
-		if(g_linux_wlan->rx_bh_thread != NULL){
-			kthread_stop(g_linux_wlan->rx_bh_thread);		
-			g_linux_wlan->rx_bh_thread= NULL;
-		}
-	#endif
+	if (g_linux_wlan->rx_bh_thread != NULL) {
+		linux_wlan_unlock(&g_linux_wlan->rx_sem);
+		kthread_stop(g_linux_wlan->rx_bh_thread);		
+		g_linux_wlan->rx_bh_thread= NULL;
+	}
+
+	if (g_linux_wlan->rx_bh_wq != NULL) {
+		destroy_workqueue(g_linux_wlan->rx_bh_wq);
+		g_linux_wlan->rx_bh_wq = NULL;
+	}
 }
 
 #ifdef COMPLEMENT_BOOT
@@ -1952,6 +2425,11 @@ int wilc1000_wlan_init(struct net_device *dev,perInterface_wlan_t* p_nic)
 		g_linux_wlan->close = 0;
 		g_linux_wlan->wilc1000_initialized = 0;
 
+		/* the bottom half mode only changes while the interface is down */
+		if ((rx_bh_type < RX_BH_KTHREAD) || (rx_bh_type > RX_BH_THREADED_IRQ))
+			rx_bh_type = RX_BH_TYPE;
+		g_linux_wlan->rx_bh_type = rx_bh_type;
+
 		wlan_init_locks(g_linux_wlan);
 		
 		linux_to_wlan(&nwi,g_linux_wlan);
@@ -2220,6 +2698,133 @@ struct net_device_stats *mac_stats(struct net_device *dev)
 	 return &nic->netstats;      
 }
 
+/*
+ * RX filter counters, shown in the wilc_rx_filter debugfs file
+ */
+enum {
+	RX_DROP_IF_DOWN = 0,
+	RX_DROP_SHORT,
+	RX_DROP_WRONG_DA,
+	RX_DROP_MULTICAST,
+	RX_DROP_ETHERTYPE,
+	RX_DROP_MAX		/* deliver */
+};
+
+static const char * const rx_drop_name[RX_DROP_MAX] = {
+	[RX_DROP_IF_DOWN]	= "interface down",
+	[RX_DROP_SHORT]		= "short frame",
+	[RX_DROP_WRONG_DA]	= "not our address",
+	[RX_DROP_MULTICAST]	= "multicast",
+	[RX_DROP_ETHERTYPE]	= "ethertype",
+};
+
+static uint32_t rx_drops[RX_DROP_MAX];
+static uint32_t rx_mc_delivered;
+
+/*
+ * Non zero only lets IPv4, ARP, IPv6 and the security/TDLS ethertypes
+ * up the stack, anything else is dropped before it is copied
+ */
+static int rx_ethertype_filter = 0;
+module_param(rx_ethertype_filter, int, 0644);
+
+int linux_wlan_rx_filter_stats(char *buf, int size)
+{
+	int res, i;
+
+	res = scnprintf(buf, size, "multicast: delivered %u dropped in software %u\n",
+			rx_mc_delivered, rx_drops[RX_DROP_MULTICAST]);
+	res += scnprintf(buf + res, size - res, "eapol: held %u overflow %u\n",
+			 rx_eapol_held, rx_eapol_overflow);
+	for (i = 0; i < RX_DROP_MAX; i++) {
+		if (i == RX_DROP_MULTICAST)
+			continue;
+		res += scnprintf(buf + res, size - res, "dropped %s: %u\n",
+				 rx_drop_name[i], rx_drops[i]);
+	}
+
+	return res;
+}
+
+void linux_wlan_rx_filter_stats_reset(void)
+{
+	rx_mc_delivered = 0;
+	memset(rx_drops, 0, sizeof(rx_drops));
+	rx_eapol_held = 0;
+	rx_eapol_overflow = 0;
+}
+
+/*
+ * Bloom filter over the whole multicast list, two bits per address.
+ * A false positive only costs delivering a frame the stack drops.
+ */
+static void linux_wlan_mc_bloom_bits(const uint8_t *addr, uint32_t *b1, uint32_t *b2)
+{
+	uint32_t h = jhash(addr, ETH_ALEN, 0);
+
+	*b1 = h & (WILC_MC_BLOOM_BITS - 1);
+	*b2 = (h >> 16) & (WILC_MC_BLOOM_BITS - 1);
+}
+
+static bool linux_wlan_mc_bloom_test(perInterface_wlan_t *nic, const uint8_t *addr)
+{
+	uint32_t b1, b2;
+
+	linux_wlan_mc_bloom_bits(addr, &b1, &b2);
+	return test_bit(b1, nic->mc_bloom) && test_bit(b2, nic->mc_bloom);
+}
+
+static bool linux_wlan_rx_ethertype_ok(uint16_t proto)
+{
+	switch (proto) {
+	case ETH_P_IP:
+	case ETH_P_ARP:
+	case ETH_P_IPV6:
+	case ETH_P_PAE:
+	case 0x88b4:	/* WAPI */
+	case 0x890d:	/* TDLS */
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Looks at the ethernet header while it is still in the RX burst buffer,
+ * so frames nobody will take are dropped before an skb is allocated.
+ * Returns the drop reason, RX_DROP_MAX to deliver the frame.
+ */
+static int linux_wlan_rx_classify(struct net_device *ndev, perInterface_wlan_t *nic,
+				  uint8_t *buff, uint32_t size)
+{
+	struct ethhdr *eth = (struct ethhdr *)buff;
+
+	if (!netif_running(ndev))
+		return RX_DROP_IF_DOWN;
+
+	if (size < ETH_HLEN)
+		return RX_DROP_SHORT;
+
+	if (is_multicast_ether_addr(eth->h_dest)) {
+		/* groups nobody joined, the firmware filter is off when the list overflows */
+		if (!is_broadcast_ether_addr(eth->h_dest)) {
+			if (nic->mc_sw_filter && !linux_wlan_mc_bloom_test(nic, eth->h_dest))
+				return RX_DROP_MULTICAST;
+			rx_mc_delivered++;
+		}
+	} else if ((nic->iftype == STATION_MODE || nic->iftype == CLIENT_MODE) &&
+		   !(ndev->flags & IFF_PROMISC) &&
+		   memcmp(eth->h_dest, ndev->dev_addr, ETH_ALEN)) {
+		/* an AP bridges, only a station knows every unicast is for itself */
+		return RX_DROP_WRONG_DA;
+	}
+
+	if (rx_ethertype_filter && !linux_wlan_rx_ethertype_ok(ntohs(eth->h_proto)))
+		return RX_DROP_ETHERTYPE;
+
+	return RX_DROP_MAX;
+}
+
 // Setup the multicast filter
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 34)
 static void wilc_set_multicast_list(struct net_device *dev)
@@ -2228,6 +2833,9 @@ static void wilc_set_multicast_list(struct net_device *dev)
 	struct netdev_hw_addr *ha;
 	struct WILC_WFI_priv* priv;
 	struct WILC_WFIDrv *pstrWFIDrv;
+	perInterface_wlan_t* nic;
+	unsigned long bloom[WILC_MC_BLOOM_BITS / BITS_PER_LONG];
+	uint32_t b1, b2;
 	int i=0;
 	priv= wiphy_priv(dev->ieee80211_ptr->wiphy);
 	pstrWFIDrv = (struct WILC_WFIDrv *)priv->hWILCWFIDrv;
@@ -2235,6 +2843,7 @@ static void wilc_set_multicast_list(struct net_device *dev)
 
 	if (!dev)
  		return;
+	nic = netdev_priv(dev);
 	
 	PRINT_D(INIT_DBG,"Setting Multicast List with count = %d. \n",dev->mc.count);
 
@@ -2244,18 +2853,42 @@ static void wilc_set_multicast_list(struct net_device *dev)
           * but we don't wanna support this right now */
         // TODO: add promiscuous mode support
         PRINT_D(INIT_DBG,"Set promiscuous mode ON, retrive all packets \n");
+	nic->mc_sw_filter = 0;
         return;
     }
 	
-    /* If there's more addresses than we handle, get all multicast
-    packets and sort them out in software. */
-     if ( (dev->flags & IFF_ALLMULTI) ||(dev->mc.count) > WILC_MULTICAST_TABLE_SIZE) 
+     if (dev->flags & IFF_ALLMULTI) 
     {
     	PRINT_D(INIT_DBG,"Disable multicast filter, retrive all multicast packets\n");
+	nic->mc_sw_filter = 0;
         // get all multicast packets
 	 host_int_setup_multicast_filter((struct WFIDrvHandle *)pstrWFIDrv, WILC_FALSE, 0);
         return;
     }
+
+    /* If there's more addresses than we handle, get all multicast
+    packets and sort them out in software. */
+     if ((dev->mc.count) > WILC_MULTICAST_TABLE_SIZE) 
+    {
+	PRINT_D(INIT_DBG,"Disable multicast filter, filter %d groups in software\n", dev->mc.count);
+	memset(bloom, 0, sizeof(bloom));
+	netdev_for_each_mc_addr(ha, dev)
+	{
+		linux_wlan_mc_bloom_bits(ha->addr, &b1, &b2);
+		__set_bit(b1, bloom);
+		__set_bit(b2, bloom);
+	}
+	/* off while the bitmap is replaced, the RX path delivers everything meanwhile */
+	nic->mc_sw_filter = 0;
+	smp_wmb();
+	memcpy(nic->mc_bloom, bloom, sizeof(bloom));
+	smp_wmb();
+	nic->mc_sw_filter = 1;
+	 host_int_setup_multicast_filter((struct WFIDrvHandle *)pstrWFIDrv, WILC_FALSE, 0);
+        return;
+    }
+
+	nic->mc_sw_filter = 0;
 	
     /* No multicast?  Just get our own stuff */
     if ((dev->mc.count) == 0) 
@@ -2402,6 +3035,8 @@ int mac_xmit(struct sk_buff *skb, struct net_device *ndev)
 	PRINT_D(TX_DBG,"Adding tx packet to TX Queue\n");
 	nic->netstats.tx_packets++;
 	nic->netstats.tx_bytes+=tx_data->size;
+	if((nic->iftype == AP_MODE || nic->iftype == GO_MODE) && !is_multicast_ether_addr(eth_h->h_dest))
+		WILC_WFI_update_sta_stats(ndev->ieee80211_ptr->wiphy, eth_h->h_dest, tx_data->size, WILC_WFI_TX_PKT);
 	tx_data->pBssid = g_linux_wlan->strInterfaceInfo[nic->u8IfIdx].aBSSID;
 	#ifndef WILC_FULLY_HOSTING_AP
 	QueueCount = g_linux_wlan->oup.wlan_add_to_tx_que((void*)tx_data,
@@ -2658,7 +3293,7 @@ void frmw_to_linux(uint8_t *buff, uint32_t size,uint32_t pkt_offset){
 	struct net_device* wilc_netdev;
 	perInterface_wlan_t *nic;
 	struct WILC_WFI_priv *priv;
-	u8 null_bssid[ETH_ALEN] = {0};
+	int drop;
 
 	wilc_netdev = GetIfHandler(buff);
 	if(wilc_netdev == NULL)
@@ -2667,54 +3302,16 @@ void frmw_to_linux(uint8_t *buff, uint32_t size,uint32_t pkt_offset){
 	buff += pkt_offset;
    	nic = netdev_priv(wilc_netdev);
 
+	drop = linux_wlan_rx_classify(wilc_netdev, nic, buff, size);
+	if (drop != RX_DROP_MAX) {
+		rx_drops[drop]++;
+		return;
+	}
+
 		if(size > 0){
 
 			frame_len = size;
 			buff_to_send = buff;
-		/*
-		 * TicketId1001
-		 * If eapol frame and successful connection is not yet reported,		 
-		 * buffer it to be passed later.
-		 */
-		priv = wdev_priv(wilc_netdev->ieee80211_ptr);
-		if ((buff_to_send[12] == 0x88 && buff_to_send[13] == 0x8e)
-		    && (nic->iftype == STATION_MODE || nic->iftype == CLIENT_MODE)
-		    && (!(memcmp(priv->au8AssociatedBss, null_bssid, ETH_ALEN)))) {
-				/*Allocate memory*/
-			if (priv->pStrBufferedEAP == NULL) {
-				priv->pStrBufferedEAP = kmalloc(sizeof(struct wilc_buffered_eap), GFP_ATOMIC);
-				if(priv->pStrBufferedEAP != NULL)
-				{
-					priv->pStrBufferedEAP->pu8buff = NULL;
-					priv->pStrBufferedEAP->u32Size = 0;
-					priv->pStrBufferedEAP->u32PktOffset = 0;
-				}
-				else
-				{
-					PRINT_ER("failed to alloc priv->pStrBufferedEAP\n");
-					return;
-				}
-			}
-			else
-			{
-				kfree(priv->pStrBufferedEAP->pu8buff);
-			}
-			
-			priv->pStrBufferedEAP->pu8buff = kmalloc(size + pkt_offset, GFP_ATOMIC);
-
-			priv->pStrBufferedEAP->u32Size = size;
-			priv->pStrBufferedEAP->u32PktOffset = pkt_offset;
-			memcpy(priv->pStrBufferedEAP->pu8buff, buff - pkt_offset, size + pkt_offset);
-
-			/*
-			 * TO DO: Stop timer before starting it
-			 * Wait about 10 ms then check again if successful connection is reported
-			 */
-			hEAPFrameBuffTimer.data = (unsigned long)priv;
-			mod_timer(&hEAPFrameBuffTimer, (jiffies + msecs_to_jiffies(10)));
-			return;
-		}
-
 			/* Need to send the packet up to the host, allocate a skb buffer */
 		    	skb = dev_alloc_skb(frame_len);
 		    	if(skb == NULL){
@@ -2771,7 +3368,17 @@ void frmw_to_linux(uint8_t *buff, uint32_t size,uint32_t pkt_offset){
 		    /* Send the packet to the stack by giving it to the bridge */
 			nic->netstats.rx_packets++;
 			nic->netstats.rx_bytes+=frame_len;
+			if(nic->iftype == AP_MODE || nic->iftype == GO_MODE)
+				WILC_WFI_update_sta_stats(wilc_netdev->ieee80211_ptr->wiphy, buff_to_send + ETH_ALEN, frame_len, WILC_WFI_RX_PKT);
 			skb->ip_summed = CHECKSUM_UNNECESSARY;
+
+			/* TicketId1001: hold EAPOL until the connection is reported */
+			if (skb->protocol == htons(ETH_P_PAE) &&
+			    (nic->iftype == STATION_MODE || nic->iftype == CLIENT_MODE)) {
+				priv = wdev_priv(wilc_netdev->ieee80211_ptr);
+				if (linux_wlan_eapol_hold(priv, skb))
+					return;
+			}
 			stats = netif_rx(skb);
 		    PRINT_D(RX_DBG,"netif_rx ret value is: %d\n",stats);
 		}
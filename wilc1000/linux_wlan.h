@@ -37,7 +37,7 @@ void WILC_WFI_mgmt_rx(uint8_t *buff, uint32_t size);
 int linux_wlan_get_firmware(perInterface_wlan_t *p_nic);
 int mac_open(struct net_device *ndev);
 int mac_close(struct net_device *ndev);
-void EAP_buff_timeout(unsigned long pUserVoid);
+void linux_wlan_eapol_flush(struct WILC_WFI_priv *priv, bool connected);
 void wilc_wlan_deinit(struct linux_wlan *nic);
 void frmw_to_linux(uint8_t *buff, uint32_t size, uint32_t pkt_offset);
 int linux_wlan_set_bssid(struct net_device *wilc_netdev, uint8_t *pBSSID, uint8_t mode);
@@ -49,6 +49,50 @@ typedef enum { ANTENNA1  = 0,
 #define MEM_DBG		  		(1<<Mem_debug)
 #define FIRM_DBG	  		(1<<Firmware_debug)
 
+/* Counters exposed through debugfs: *_print() formats them, *_reset() clears them */
+int linux_wlan_thread_stats(char *buf, int size);
+void linux_wlan_thread_stats_reset(void);
+int linux_wlan_rx_filter_stats(char *buf, int size);
+void linux_wlan_rx_filter_stats_reset(void);
+int host_int_req_stats(char *buf, int size);
+void host_int_req_stats_reset(void);
+int wilc_wlan_wake_print(char *buf, int size);
+void wilc_wlan_wake_reset(void);
+int WILC_WFI_join_stats_print(char *buf, int size);
+void WILC_WFI_join_stats_reset(void);
+#ifdef WILC_SCAN_SCHEDULER
+int host_int_scan_sched_stats(char *buf, int size);
+void host_int_scan_sched_stats_reset(void);
+#endif
+#ifdef WILC_LOCK_PROFILE
+int wilc_lock_prof_print(char *buf, int size);
+void wilc_lock_prof_reset(void);
+#endif
+#ifdef WILC_PKT_LATENCY
+int wilc_wlan_lat_print(char *buf, int size);
+void wilc_wlan_lat_reset(void);
+#endif
+#ifdef WILC_SDIO
+int sdio_stats_print(char *buf, int size);
+void sdio_stats_reset(void);
+#endif
+#ifdef WILC_SPI
+int linux_spi_async_stats(char *buf, int size);
+void linux_spi_async_stats_reset(void);
+int spi_crc_stats_print(char *buf, int size);
+void spi_crc_stats_reset(void);
+#endif
+#ifdef WILC_BUS_GOVERNOR
+int wilc_bus_gov_print(char *buf, int size);
+void wilc_bus_gov_reset(void);
+void wilc_bus_gov_suspend(void);
+void wilc_bus_gov_resume(void);
+#endif
+#ifdef WILC_BUS_TRACE
+void wilc_bus_trace_enable(int on);
+int wilc_bus_trace_copy(char *buf, int size, loff_t pos);
+#endif
+
 #if defined (WILC_DEBUGFS)
 extern int wilc_debugfs_init(void);
 extern void wilc_debugfs_remove(void);
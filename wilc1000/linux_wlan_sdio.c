@@ -54,12 +54,41 @@ static void wilc_sdio_interrupt(struct sdio_func *func)
 }
 
 
+/*
+ * Nesting host claim, so a sequence of commands (CSA address + CMD53,
+ * reading several CMD52 registers) claims and releases the host once.
+ * Commands issued by another task still wait in sdio_claim_host().
+ */
+static struct task_struct *sdio_claim_owner = NULL;
+static int sdio_claim_depth = 0;
+
+void linux_sdio_claim(void)
+{
+	if (sdio_claim_owner == current) {
+		sdio_claim_depth++;
+		return;
+	}
+	sdio_claim_host(local_sdio_func);
+	sdio_claim_owner = current;
+	sdio_claim_depth = 1;
+}
+
+void linux_sdio_release(void)
+{
+	if (sdio_claim_owner != current)
+		return;
+	if (--sdio_claim_depth == 0) {
+		sdio_claim_owner = NULL;
+		sdio_release_host(local_sdio_func);
+	}
+}
+
 int linux_sdio_cmd52(sdio_cmd52_t *cmd){
 	struct sdio_func *func = g_linux_wlan->wilc_sdio_func;
 	int ret;
 	u8 data;
 
-	sdio_claim_host(func);
+	linux_sdio_claim();
 
 	func->num = cmd->function;
 	if (cmd->read_write) {	/* write */
@@ -75,7 +104,7 @@ int linux_sdio_cmd52(sdio_cmd52_t *cmd){
 		cmd->data = data;
 	}
 
-	sdio_release_host(func);
+	linux_sdio_release();
 
 	if (ret < 0) {
 		PRINT_ER("wilc_sdio_cmd52..failed, err(%d)\n", ret);
@@ -89,7 +118,7 @@ int linux_sdio_cmd52(sdio_cmd52_t *cmd){
 	struct sdio_func *func = local_sdio_func;
 	int size, ret;
 
-	sdio_claim_host(func);
+	linux_sdio_claim();
 
 	func->num = cmd->function;
 	func->cur_blksize = cmd->block_size;
@@ -104,7 +133,7 @@ int linux_sdio_cmd52(sdio_cmd52_t *cmd){
 		ret = sdio_memcpy_fromio(func, (void *)cmd->buffer, cmd->address,  size);		
 	}
 
-	sdio_release_host(func);
+	linux_sdio_release();
 
 
 	if (ret < 0) {
@@ -150,7 +179,7 @@ static void linux_sdio_remove(struct sdio_func *func)
 int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func);
 int wilc_sdio_reset(void *pv);
 void chip_sleep_manually(WILC_Uint32 u32SleepTime);
-void chip_wakeup(void);
+int chip_wakeup(void);
 void host_wakeup_notify(void);
 void host_sleep_notify(void);
 void chip_allow_sleep(void);
@@ -159,7 +188,16 @@ extern uint8_t u8SuspendOnEvent;
 static int wilc_sdio_suspend(struct device *dev)
 {
 	printk("\n\n << SUSPEND >>\n\n");
-	chip_wakeup();
+#ifdef WILC_BUS_GOVERNOR
+	wilc_bus_gov_suspend();
+#endif
+	if (!chip_wakeup()) {
+		/* can't tell the chip we are going down, don't suspend */
+#ifdef WILC_BUS_GOVERNOR
+		wilc_bus_gov_resume();
+#endif
+		return -EIO;
+	}
 	/*if there is no events , put the chip in low power mode */
 	if(u8SuspendOnEvent == 0)
 		chip_sleep_manually(0xffffffff);
@@ -180,7 +218,8 @@ static int wilc_sdio_resume(struct device *dev)
 {
 	sdio_release_host(local_sdio_func);
 	/*wake the chip to compelete the re-intialization*/
-	chip_wakeup();
+	if (!chip_wakeup())
+		PRINT_ER("Chip didn't wake up on resume\n");
 	printk("\n\n << RESUME >>\n\n");
 	/*Init SDIO block mode*/
 	sdio_init(NULL,NULL);
@@ -189,6 +228,9 @@ static int wilc_sdio_resume(struct device *dev)
 		host_wakeup_notify();
 
 	chip_allow_sleep();
+#ifdef WILC_BUS_GOVERNOR
+	wilc_bus_gov_resume();
+#endif
     return 0;
 
 }
@@ -296,5 +338,12 @@ int linux_sdio_set_default_speed(void)
 	return linux_sdio_set_speed(sdio_default_speed);
 }
 
+/* largest block size both the host controller and the card CIS allow */
+int linux_sdio_max_block_size(void)
+{
+	return min_t(unsigned int, local_sdio_func->card->host->max_blk_size,
+		     local_sdio_func->max_blksize);
+}
+
 
 
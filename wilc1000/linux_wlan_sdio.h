@@ -11,4 +11,7 @@ int enable_sdio_interrupt(void);
 void disable_sdio_interrupt(void);
 int linux_sdio_set_max_speed(void);
 int linux_sdio_set_default_speed(void);
+void linux_sdio_claim(void);
+void linux_sdio_release(void);
+int linux_sdio_max_block_size(void);
 
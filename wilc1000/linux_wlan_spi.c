@@ -8,6 +8,8 @@
 #include <asm/uaccess.h>
 #include <linux/device.h>
 #include <linux/spi/spi.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
 
 #include "linux_wlan_common.h"
 
@@ -42,6 +44,48 @@ static uint32_t SPEED = MIN_SPEED;
 
 struct spi_device* wilc_spi_dev;
 void linux_spi_deinit(void* vp);
+int linux_spi_write_async_flush(void);
+
+/*
+ * Asynchronous data block writes.
+ *
+ * A data block is a command byte, the data and an optional crc. Each one
+ * goes out as a single spi_message (CS toggles between the transfers as it
+ * did with separate messages) through spi_async(), so the caller can build
+ * the next block while the controller is busy with the previous one.
+ * SPI_ASYNC_SLOTS blocks can be in flight; linux_spi_write_async_flush()
+ * waits for all of them and reports whether any failed.
+ * With use_spi_async=0, or if spi_async() refuses a message, the block is
+ * sent with spi_sync() instead.
+ */
+#define SPI_ASYNC_SLOTS	2
+
+static int use_spi_async = 1;
+module_param(use_spi_async, int, 0644);
+
+struct wilc_spi_async_slot {
+	struct spi_message msg;
+	struct spi_transfer tr[3];
+	struct completion done;
+	uint8_t hdr[4];
+	uint8_t trailer[4];
+	int busy;
+};
+
+/* kmalloc'ed so the header and crc copies are DMA safe */
+static struct wilc_spi_async_slot *spi_slot = NULL;
+static int spi_slot_next;
+static int spi_async_err;
+
+static struct {
+	uint32_t async;		/* blocks sent with spi_async() */
+	uint32_t sync;		/* blocks sent with spi_sync() */
+	uint32_t fallback;	/* spi_async() refused the message */
+	uint32_t errors;
+	uint32_t waits;		/* had to sleep for a slot or a flush */
+	uint64_t wait_us;	/* time spent sleeping for the controller */
+	uint64_t bytes;
+} spi_async_stats;
 
 static int __init wilc_bus_probe(struct spi_device* spi){
 	
@@ -83,6 +127,10 @@ struct spi_driver wilc_bus __refdata = {
 void linux_spi_deinit(void* vp){
 	
 		spi_unregister_driver(&wilc_bus);	
+
+		linux_spi_write_async_flush();
+		kfree(spi_slot);
+		spi_slot = NULL;
 		
 		SPEED = MIN_SPEED;
 		PRINT_ER("@@@@@@@@@@@@ restore SPI speed to %d @@@@@@@@@\n", SPEED);
@@ -104,6 +152,12 @@ int linux_spi_init(void* vp){
 		ret = spi_register_driver(&wilc_bus);		
 	}
 
+	if (spi_slot == NULL) {
+		spi_slot = kzalloc(SPI_ASYNC_SLOTS * sizeof(*spi_slot), GFP_KERNEL);
+		if (spi_slot == NULL)
+			PRINT_ER("Failed to allocate SPI async slots, using sync writes\n");
+	}
+
 	/* change return value to match WILC interface */
 	(ret<0)? (ret = 0):(ret = 1);
 	
@@ -306,6 +360,141 @@ int linux_spi_write_read(unsigned char*wb, unsigned char*rb, unsigned int rlen)
 	return ret;
 }
 
+static void linux_spi_async_complete(void *context)
+{
+	struct wilc_spi_async_slot *slot = context;
+
+	complete(&slot->done);
+}
+
+static void linux_spi_async_reap(struct wilc_spi_async_slot *slot)
+{
+	if (!slot->busy)
+		return;
+
+	if (!completion_done(&slot->done)) {
+		ktime_t start = ktime_get();
+
+		wait_for_completion(&slot->done);
+		spi_async_stats.waits++;
+		spi_async_stats.wait_us += ktime_us_delta(ktime_get(), start);
+	}
+	if (slot->msg.status < 0) {
+		PRINT_ER("SPI async transaction failed (%d)\n", slot->msg.status);
+		spi_async_stats.errors++;
+		spi_async_err = 1;
+	}
+	slot->busy = 0;
+}
+
+int linux_spi_write_async(uint8_t *hdr, uint32_t hdr_len, uint8_t *b, uint32_t len,
+			  uint8_t *trailer, uint32_t trailer_len)
+{
+	struct wilc_spi_async_slot *slot;
+	int n = 0, ret;
+
+	if (b == NULL || len == 0 || hdr_len > sizeof(slot->hdr) ||
+	    trailer_len > sizeof(slot->trailer))
+		return 0;
+
+	if (spi_slot == NULL) {
+		/* no slots, send the pieces one by one */
+		if (hdr_len && !linux_spi_write(hdr, hdr_len))
+			return 0;
+		if (!linux_spi_write(b, len))
+			return 0;
+		if (trailer_len && !linux_spi_write(trailer, trailer_len))
+			return 0;
+		spi_async_stats.sync++;
+		return 1;
+	}
+
+	slot = &spi_slot[spi_slot_next];
+	linux_spi_async_reap(slot);
+	spi_slot_next = (spi_slot_next + 1) % SPI_ASYNC_SLOTS;
+
+	/* the caller's header and crc usually live on its stack */
+	memcpy(slot->hdr, hdr, hdr_len);
+	memcpy(slot->trailer, trailer, trailer_len);
+	memset(slot->tr, 0, sizeof(slot->tr));
+
+	spi_message_init(&slot->msg);
+	slot->msg.spi = wilc_spi_dev;
+	slot->msg.is_dma_mapped = USE_SPI_DMA;
+	if (hdr_len) {
+		slot->tr[n].tx_buf = slot->hdr;
+		slot->tr[n++].len = hdr_len;
+	}
+	slot->tr[n].tx_buf = b;
+	slot->tr[n++].len = len;
+	if (trailer_len) {
+		slot->tr[n].tx_buf = slot->trailer;
+		slot->tr[n++].len = trailer_len;
+	}
+	for (ret = 0; ret < n; ret++) {
+		slot->tr[ret].speed_hz = SPEED;
+		slot->tr[ret].bits_per_word = 8;
+		slot->tr[ret].cs_change = (ret < n - 1);
+		spi_message_add_tail(&slot->tr[ret], &slot->msg);
+	}
+	spi_async_stats.bytes += hdr_len + len + trailer_len;
+
+	if (use_spi_async) {
+		init_completion(&slot->done);
+		slot->msg.complete = linux_spi_async_complete;
+		slot->msg.context = slot;
+		ret = spi_async(wilc_spi_dev, &slot->msg);
+		if (ret == 0) {
+			slot->busy = 1;
+			spi_async_stats.async++;
+			return 1;
+		}
+		spi_async_stats.fallback++;
+	}
+
+	ret = spi_sync(wilc_spi_dev, &slot->msg);
+	spi_async_stats.sync++;
+	if (ret < 0) {
+		PRINT_ER("SPI transaction failed\n");
+		spi_async_stats.errors++;
+		return 0;
+	}
+	return 1;
+}
+
+int linux_spi_write_async_flush(void)
+{
+	int i, ok;
+
+	if (spi_slot == NULL)
+		return 1;
+
+	for (i = 0; i < SPI_ASYNC_SLOTS; i++)
+		linux_spi_async_reap(&spi_slot[i]);
+
+	ok = !spi_async_err;
+	spi_async_err = 0;
+	return ok;
+}
+
+int linux_spi_async_stats(char *buf, int size)
+{
+	return scnprintf(buf, size,
+			 "mode %s\nasync %u sync %u fallback %u errors %u\n"
+			 "waits %u wait time %llu us bytes %llu\n",
+			 use_spi_async ? "async" : "sync",
+			 spi_async_stats.async, spi_async_stats.sync,
+			 spi_async_stats.fallback, spi_async_stats.errors,
+			 spi_async_stats.waits,
+			 (unsigned long long)spi_async_stats.wait_us,
+			 (unsigned long long)spi_async_stats.bytes);
+}
+
+void linux_spi_async_stats_reset(void)
+{
+	memset(&spi_async_stats, 0, sizeof(spi_async_stats));
+}
+
 int linux_spi_set_max_speed(void)
 {
 	SPEED = MAX_SPEED;
@@ -313,3 +502,12 @@ int linux_spi_set_max_speed(void)
 	PRINT_INFO(BUS_DBG,"@@@@@@@@@@@@ change SPI speed to %d @@@@@@@@@\n", SPEED);
 	return 1;
 }
+
+int linux_spi_set_default_speed(void)
+{
+	/* queued async blocks keep the speed they were built with */
+	SPEED = MIN_SPEED;
+
+	PRINT_INFO(BUS_DBG,"@@@@@@@@@@@@ change SPI speed to %d @@@@@@@@@\n", SPEED);
+	return 1;
+}
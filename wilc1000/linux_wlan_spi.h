@@ -11,4 +11,8 @@ int linux_spi_write(uint8_t* b, uint32_t len);
 int linux_spi_read(uint8_t *rb, uint32_t rlen);
 int linux_spi_write_read(unsigned char*wb, unsigned char*rb, unsigned int rlen);
 int linux_spi_set_max_speed(void);
+int linux_spi_set_default_speed(void);
+int linux_spi_write_async(uint8_t *hdr, uint32_t hdr_len, uint8_t *b, uint32_t len,
+			  uint8_t *trailer, uint32_t trailer_len);
+int linux_spi_write_async_flush(void);
 #endif
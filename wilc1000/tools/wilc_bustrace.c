@@ -0,0 +1,331 @@
+/*
+* wilc_bustrace - decode and replay the WILC1000 bus trace
+*
+* Reads the raw stream exported by the driver (built with
+* -DWILC_BUS_TRACE) from debugfs:
+*
+*	echo 1 > /sys/kernel/debug/wilc_wifi/wilc_bus_trace
+*	... run the workload ...
+*	echo 0 > /sys/kernel/debug/wilc_wifi/wilc_bus_trace
+*	cat /sys/kernel/debug/wilc_wifi/wilc_bus_trace > bus.trace
+*
+* and either summarizes it or replays it against a simple timing model
+* of the chip, so bus speed and transaction count changes can be weighed
+* offline. The trace is in the byte order of the target.
+*
+* Build: gcc -O2 -Wall -o wilc_bustrace wilc_bustrace.c
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* must match wilc_bus_trace_rec_t in wilc_wlan.c */
+typedef struct {
+	uint64_t start;		/* ns */
+	uint32_t dur;		/* ns */
+	uint32_t addr;		/* address, or the value for int/size ops */
+	uint32_t len;		/* bytes */
+	uint16_t op;
+	int16_t result;
+} wilc_bus_trace_rec_t;
+
+enum {
+	BT_READ_REG = 1,
+	BT_WRITE_REG,
+	BT_BLOCK_RX,
+	BT_BLOCK_TX,
+	BT_SYNC,
+	BT_CLEAR_INT,
+	BT_READ_INT,
+	BT_CLEAR_INT_EXT,
+	BT_READ_SIZE,
+	BT_BLOCK_TX_EXT,
+	BT_BLOCK_RX_EXT,
+	BT_SYNC_EXT,
+	BT_MAX_SPEED,
+	BT_DEFAULT_SPEED,
+	BT_MAX
+};
+
+static const char *op_name[BT_MAX] = {
+	[0]			= "unknown",
+	[BT_READ_REG]		= "read_reg",
+	[BT_WRITE_REG]		= "write_reg",
+	[BT_BLOCK_RX]		= "block_rx",
+	[BT_BLOCK_TX]		= "block_tx",
+	[BT_SYNC]		= "sync",
+	[BT_CLEAR_INT]		= "clear_int",
+	[BT_READ_INT]		= "read_int",
+	[BT_CLEAR_INT_EXT]	= "clear_int_ext",
+	[BT_READ_SIZE]		= "read_size",
+	[BT_BLOCK_TX_EXT]	= "block_tx_ext",
+	[BT_BLOCK_RX_EXT]	= "block_rx_ext",
+	[BT_SYNC_EXT]		= "sync_ext",
+	[BT_MAX_SPEED]		= "max_speed",
+	[BT_DEFAULT_SPEED]	= "default_speed",
+};
+
+#define GAP_BINS	20	/* log2(usec) */
+#define POLL_MIN	3	/* same register read back to back */
+#define TOP_GAPS	5
+
+static wilc_bus_trace_rec_t *load(const char *path, size_t *n)
+{
+	wilc_bus_trace_rec_t *recs = NULL;
+	size_t cap = 0, cnt = 0;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+	for (;;) {
+		if (cnt == cap) {
+			cap = cap ? cap * 2 : 4096;
+			recs = realloc(recs, cap * sizeof(*recs));
+			if (!recs) {
+				fclose(f);
+				return NULL;
+			}
+		}
+		if (fread(&recs[cnt], sizeof(*recs), 1, f) != 1)
+			break;
+		if (recs[cnt].op >= BT_MAX)
+			recs[cnt].op = 0;
+		cnt++;
+	}
+	fclose(f);
+	*n = cnt;
+	return recs;
+}
+
+static int is_packet(const wilc_bus_trace_rec_t *r)
+{
+	return (r->op == BT_BLOCK_TX_EXT) || (r->op == BT_BLOCK_RX_EXT);
+}
+
+static int is_poll(const wilc_bus_trace_rec_t *a, const wilc_bus_trace_rec_t *b)
+{
+	if (a->op != b->op)
+		return 0;
+	if (a->op == BT_READ_INT || a->op == BT_READ_SIZE)
+		return 1;
+	return (a->op == BT_READ_REG) && (a->addr == b->addr);
+}
+
+static int gap_bin(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	int bin = 0;
+
+	while (us && bin < GAP_BINS - 1) {
+		us >>= 1;
+		bin++;
+	}
+	return bin;
+}
+
+static void summary(const wilc_bus_trace_rec_t *r, size_t n)
+{
+	uint64_t cnt[BT_MAX] = {0}, bytes[BT_MAX] = {0}, busy[BT_MAX] = {0};
+	uint32_t max[BT_MAX] = {0}, fail[BT_MAX] = {0};
+	uint64_t gap_hist[GAP_BINS] = {0};
+	uint64_t top_gap[TOP_GAPS] = {0};
+	size_t top_at[TOP_GAPS] = {0};
+	uint64_t packets = 0, total_busy = 0, span;
+	uint64_t polls = 0, poll_reads = 0, poll_ns = 0;
+	size_t i, j;
+
+	if (!n) {
+		printf("empty trace\n");
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		uint16_t op = r[i].op;
+
+		cnt[op]++;
+		busy[op] += r[i].dur;
+		total_busy += r[i].dur;
+		if (r[i].dur > max[op])
+			max[op] = r[i].dur;
+		if (op != BT_READ_INT && op != BT_READ_SIZE && op != BT_CLEAR_INT_EXT)
+			bytes[op] += r[i].len;
+		if (r[i].result <= 0)
+			fail[op]++;
+		if (is_packet(&r[i]))
+			packets++;
+
+		if (i > 0) {
+			uint64_t end = r[i - 1].start + r[i - 1].dur;
+			uint64_t gap = (r[i].start > end) ? r[i].start - end : 0;
+
+			gap_hist[gap_bin(gap)]++;
+			for (j = 0; j < TOP_GAPS; j++) {
+				if (gap > top_gap[j]) {
+					memmove(&top_gap[j + 1], &top_gap[j], (TOP_GAPS - j - 1) * sizeof(top_gap[0]));
+					memmove(&top_at[j + 1], &top_at[j], (TOP_GAPS - j - 1) * sizeof(top_at[0]));
+					top_gap[j] = gap;
+					top_at[j] = i;
+					break;
+				}
+			}
+		}
+	}
+
+	/* polling loops: runs of the same status read */
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n && is_poll(&r[i], &r[j]); j++)
+			;
+		if (j - i >= POLL_MIN) {
+			polls++;
+			poll_reads += j - i;
+			poll_ns += r[j - 1].start + r[j - 1].dur - r[i].start;
+		}
+	}
+
+	span = r[n - 1].start + r[n - 1].dur - r[0].start;
+	printf("records %zu, span %.3f ms, bus busy %.3f ms (%.1f%%)\n",
+	       n, span / 1e6, total_busy / 1e6, span ? 100.0 * total_busy / span : 0.0);
+	printf("packets %llu, transactions per packet %.2f\n\n",
+	       (unsigned long long)packets, packets ? (double)n / packets : 0.0);
+
+	printf("%-14s %8s %10s %10s %10s %6s\n", "op", "count", "bytes", "avg us", "max us", "fail");
+	for (i = 0; i < BT_MAX; i++) {
+		if (!cnt[i])
+			continue;
+		printf("%-14s %8llu %10llu %10.1f %10.1f %6u\n", op_name[i],
+		       (unsigned long long)cnt[i], (unsigned long long)bytes[i],
+		       busy[i] / 1e3 / cnt[i], max[i] / 1e3, fail[i]);
+	}
+
+	printf("\nidle gaps (us, log2 bins):\n");
+	for (i = 0; i < GAP_BINS; i++) {
+		if (gap_hist[i])
+			printf("  < %7u: %llu\n", 1u << i, (unsigned long long)gap_hist[i]);
+	}
+	printf("longest gaps:\n");
+	for (i = 0; i < TOP_GAPS && top_gap[i]; i++)
+		printf("  %.3f ms before #%zu (%s)\n", top_gap[i] / 1e6, top_at[i], op_name[r[top_at[i]].op]);
+
+	printf("\npolling loops (>= %d reads): %llu, %llu reads, %.3f ms\n", POLL_MIN,
+	       (unsigned long long)polls, (unsigned long long)poll_reads, poll_ns / 1e6);
+}
+
+/*
+ * Simulated chip: every transaction costs a fixed per command overhead
+ * plus its payload at the given bus clock. The host side gaps of the
+ * recording are kept as they are, polling loops end after the same
+ * number of reads. Prints what the recording would have taken with
+ * that bus.
+ */
+static uint64_t model_ns(const wilc_bus_trace_rec_t *r, double clk_hz, double ovh_ns)
+{
+	uint32_t bytes = 0;
+
+	switch (r->op) {
+	case BT_READ_REG:
+	case BT_WRITE_REG:
+	case BT_READ_INT:
+	case BT_READ_SIZE:
+	case BT_CLEAR_INT_EXT:
+		bytes = 4;
+		break;
+	case BT_BLOCK_RX:
+	case BT_BLOCK_TX:
+	case BT_BLOCK_RX_EXT:
+	case BT_BLOCK_TX_EXT:
+		bytes = r->len;
+		break;
+	default:
+		break;
+	}
+
+	return (uint64_t)(ovh_ns + (bytes * 8.0 * 1e9) / clk_hz);
+}
+
+static void replay(const wilc_bus_trace_rec_t *r, size_t n, double clk_hz, double ovh_ns, int verbose)
+{
+	uint64_t now = 0, rec_busy = 0, sim_busy = 0;
+	size_t i;
+
+	if (!n) {
+		printf("empty trace\n");
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		uint64_t cost = model_ns(&r[i], clk_hz, ovh_ns);
+
+		if (i > 0) {
+			uint64_t end = r[i - 1].start + r[i - 1].dur;
+
+			if (r[i].start > end)
+				now += r[i].start - end;
+		}
+		if (verbose)
+			printf("%12.3f us %-14s addr %08x len %6u  rec %8.1f us  sim %8.1f us\n",
+			       now / 1e3, op_name[r[i].op], r[i].addr, r[i].len,
+			       r[i].dur / 1e3, cost / 1e3);
+		now += cost;
+		rec_busy += r[i].dur;
+		sim_busy += cost;
+	}
+
+	printf("recorded: span %.3f ms, bus %.3f ms\n",
+	       (r[n - 1].start + r[n - 1].dur - r[0].start) / 1e6, rec_busy / 1e6);
+	printf("simulated at %.1f MHz, %.1f us per command: span %.3f ms, bus %.3f ms\n",
+	       clk_hz / 1e6, ovh_ns / 1e3, now / 1e6, sim_busy / 1e6);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s summary <trace>\n"
+		"       %s replay <trace> [clock MHz] [command overhead us] [-v]\n",
+		prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+	wilc_bus_trace_rec_t *recs;
+	size_t n = 0;
+
+	if (argc < 3) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	recs = load(argv[2], &n);
+	if (!recs)
+		return 1;
+
+	if (!strcmp(argv[1], "summary")) {
+		summary(recs, n);
+	} else if (!strcmp(argv[1], "replay")) {
+		double mhz = (argc > 3) ? atof(argv[3]) : 48.0;
+		double ovh = (argc > 4) ? atof(argv[4]) : 10.0;
+		int verbose = (argc > 5) && !strcmp(argv[5], "-v");
+
+		if (mhz <= 0) {
+			usage(argv[0]);
+			free(recs);
+			return 1;
+		}
+		replay(recs, n, mhz * 1e6, ovh * 1e3, verbose);
+	} else {
+		usage(argv[0]);
+		free(recs);
+		return 1;
+	}
+
+	free(recs);
+	return 0;
+}
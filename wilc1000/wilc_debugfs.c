@@ -14,6 +14,7 @@
 #include <linux/debugfs.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
+#include <linux/slab.h>
 
 #include "wilc_wlan_if.h"
 
@@ -116,6 +117,120 @@ static ssize_t wilc_debug_region_write(struct file *filp, const char *buf, size_
 	return count;
 }
 
+/*
+ * Stats files: reading prints the counters, any write resets them
+ */
+static ssize_t wilc_stats_read(char __user *userbuf, size_t count, loff_t *ppos,
+			       int (*print)(char *buf, int size))
+{
+	char *buf;
+	int res = 0;
+	ssize_t ret;
+
+	/* only allow read from start */
+	if (*ppos > 0)
+		return 0;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	res = print(buf, PAGE_SIZE);
+	ret = simple_read_from_buffer(userbuf, count, ppos, buf, res);
+	kfree(buf);
+
+	return ret;
+}
+
+#define WILC_STATS_FILE(_name, _print, _reset) \
+static ssize_t _name##_read(struct file *file, char __user *userbuf, size_t count, loff_t *ppos) \
+{ \
+	return wilc_stats_read(userbuf, count, ppos, _print); \
+} \
+static ssize_t _name##_write(struct file *filp, const char *buf, size_t count, loff_t *ppos) \
+{ \
+	_reset(); \
+	return count; \
+}
+
+#ifdef WILC_SCAN_SCHEDULER
+WILC_STATS_FILE(wilc_scan_stats, host_int_scan_sched_stats, host_int_scan_sched_stats_reset)
+#endif /* WILC_SCAN_SCHEDULER */
+#ifdef WILC_LOCK_PROFILE
+WILC_STATS_FILE(wilc_lock_stats, wilc_lock_prof_print, wilc_lock_prof_reset)
+#endif /* WILC_LOCK_PROFILE */
+#ifdef WILC_PKT_LATENCY
+WILC_STATS_FILE(wilc_latency_stats, wilc_wlan_lat_print, wilc_wlan_lat_reset)
+#endif /* WILC_PKT_LATENCY */
+#ifdef WILC_SDIO
+WILC_STATS_FILE(wilc_sdio_stats, sdio_stats_print, sdio_stats_reset)
+#endif /* WILC_SDIO */
+#ifdef WILC_SPI
+static int wilc_spi_stats_print(char *buf, int size)
+{
+	int res;
+
+	res = linux_spi_async_stats(buf, size);
+	res += spi_crc_stats_print(buf + res, size - res);
+
+	return res;
+}
+
+static void wilc_spi_stats_reset(void)
+{
+	linux_spi_async_stats_reset();
+	spi_crc_stats_reset();
+}
+
+WILC_STATS_FILE(wilc_spi_stats, wilc_spi_stats_print, wilc_spi_stats_reset)
+#endif /* WILC_SPI */
+WILC_STATS_FILE(wilc_thread_stats, linux_wlan_thread_stats, linux_wlan_thread_stats_reset)
+WILC_STATS_FILE(wilc_hif_req_stats, host_int_req_stats, host_int_req_stats_reset)
+WILC_STATS_FILE(wilc_wake_stats, wilc_wlan_wake_print, wilc_wlan_wake_reset)
+WILC_STATS_FILE(wilc_rx_filter, linux_wlan_rx_filter_stats, linux_wlan_rx_filter_stats_reset)
+WILC_STATS_FILE(wilc_join_stats, WILC_WFI_join_stats_print, WILC_WFI_join_stats_reset)
+#ifdef WILC_BUS_GOVERNOR
+WILC_STATS_FILE(wilc_bus_gov, wilc_bus_gov_print, wilc_bus_gov_reset)
+#endif /* WILC_BUS_GOVERNOR */
+
+#ifdef WILC_BUS_TRACE
+/* raw records, stop the recorder before reading for a consistent dump */
+static ssize_t wilc_bus_trace_read(struct file *file, char __user *userbuf, size_t count, loff_t *ppos)
+{
+	char *buf;
+	int res = 0;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	res = wilc_bus_trace_copy(buf, min_t(size_t, count, PAGE_SIZE), *ppos);
+	if (res > 0) {
+		if (copy_to_user(userbuf, buf, res))
+			res = -EFAULT;
+		else
+			*ppos += res;
+	}
+	kfree(buf);
+
+	return res;
+}
+
+/* '1' starts a new recording, '0' stops it */
+static ssize_t wilc_bus_trace_write(struct file *filp, const char *buf, size_t count, loff_t *ppos)
+{
+	char flag;
+
+	if (count < 1)
+		return -EINVAL;
+	if (copy_from_user(&flag, buf, 1))
+		return -EFAULT;
+
+	wilc_bus_trace_enable(flag == '1');
+	return count;
+}
+#endif /* WILC_BUS_TRACE */
+
 /*
 --------------------------------------------------------------------------------
 */
@@ -138,6 +253,32 @@ struct wilc_debugfs_info_t {
 static struct wilc_debugfs_info_t debugfs_info[] = {
 	{ "wilc_debug_level",	0666,	(DEBUG | ERR), FOPS(NULL, wilc_debug_level_read, wilc_debug_level_write,NULL), },
 	{ "wilc_debug_region",	0666,	(INIT_DBG | GENERIC_DBG | CFG80211_DBG), FOPS(NULL, wilc_debug_region_read, wilc_debug_region_write, NULL), },
+#ifdef WILC_LOCK_PROFILE
+	{ "wilc_lock_stats",	0666,	0, FOPS(NULL, wilc_lock_stats_read, wilc_lock_stats_write, NULL), },
+#endif
+#ifdef WILC_PKT_LATENCY
+	{ "wilc_latency_stats",	0666,	0, FOPS(NULL, wilc_latency_stats_read, wilc_latency_stats_write, NULL), },
+#endif
+#ifdef WILC_SPI
+	{ "wilc_spi_stats",	0666,	0, FOPS(NULL, wilc_spi_stats_read, wilc_spi_stats_write, NULL), },
+#endif
+#ifdef WILC_SDIO
+	{ "wilc_sdio_stats",	0666,	0, FOPS(NULL, wilc_sdio_stats_read, wilc_sdio_stats_write, NULL), },
+#endif
+#ifdef WILC_SCAN_SCHEDULER
+	{ "wilc_scan_stats",	0666,	0, FOPS(NULL, wilc_scan_stats_read, wilc_scan_stats_write, NULL), },
+#endif
+	{ "wilc_thread_stats",	0666,	0, FOPS(NULL, wilc_thread_stats_read, wilc_thread_stats_write, NULL), },
+	{ "wilc_wake_stats",	0666,	0, FOPS(NULL, wilc_wake_stats_read, wilc_wake_stats_write, NULL), },
+	{ "wilc_hif_req_stats",	0666,	0, FOPS(NULL, wilc_hif_req_stats_read, wilc_hif_req_stats_write, NULL), },
+	{ "wilc_rx_filter",	0666,	0, FOPS(NULL, wilc_rx_filter_read, wilc_rx_filter_write, NULL), },
+	{ "wilc_join_stats",	0666,	0, FOPS(NULL, wilc_join_stats_read, wilc_join_stats_write, NULL), },
+#ifdef WILC_BUS_GOVERNOR
+	{ "wilc_bus_gov",	0666,	0, FOPS(NULL, wilc_bus_gov_read, wilc_bus_gov_write, NULL), },
+#endif
+#ifdef WILC_BUS_TRACE
+	{ "wilc_bus_trace",	0666,	0, FOPS(NULL, wilc_bus_trace_read, wilc_bus_trace_write, NULL), },
+#endif
 };
 
 int wilc_debugfs_init(void)
@@ -21,7 +21,9 @@ WILC_ErrNo WILC_MsgQueueCreate(WILC_MsgQueueHandle* pHandle,
 	if( (WILC_SemaphoreCreate(&pHandle->hSem, &strSemAttrs) == WILC_SUCCESS))
 	{
 	
-		pHandle->pstrMessageList = NULL;
+		WILC_memset(pHandle->pstrMessageList, 0, sizeof(pHandle->pstrMessageList));
+		WILC_memset(pHandle->pstrMessageTail, 0, sizeof(pHandle->pstrMessageTail));
+		WILC_memset(pHandle->astrStats, 0, sizeof(pHandle->astrStats));
 		pHandle->u32ReceiversCount = 0;
 		pHandle->bExiting = WILC_FALSE;
 
@@ -42,6 +44,7 @@ WILC_ErrNo WILC_MsgQueueCreate(WILC_MsgQueueHandle* pHandle,
 WILC_ErrNo WILC_MsgQueueDestroy(WILC_MsgQueueHandle* pHandle,
 			tstrWILC_MsgQueueAttrs* pstrAttrs)
 {
+	WILC_Uint32 u32Prio;
 
 	pHandle->bExiting = WILC_TRUE;
 
@@ -54,11 +57,15 @@ WILC_ErrNo WILC_MsgQueueDestroy(WILC_MsgQueueHandle* pHandle,
 
 	WILC_SemaphoreDestroy(&pHandle->hSem, WILC_NULL);
 	
-	while(pHandle->pstrMessageList != NULL)
+	for(u32Prio = 0; u32Prio < WILC_MSG_QUEUE_PRIOS; u32Prio++)
 	{
-		Message * pstrMessge = pHandle->pstrMessageList->pstrNext;
-		WILC_FREE(pHandle->pstrMessageList);
-		pHandle->pstrMessageList = pstrMessge;	
+		while(pHandle->pstrMessageList[u32Prio] != NULL)
+		{
+			Message * pstrMessge = pHandle->pstrMessageList[u32Prio]->pstrNext;
+			WILC_FREE(pHandle->pstrMessageList[u32Prio]);
+			pHandle->pstrMessageList[u32Prio] = pstrMessge;	
+		}
+		pHandle->pstrMessageTail[u32Prio] = NULL;
 	}
 
 	return WILC_SUCCESS;
@@ -73,12 +80,23 @@ WILC_ErrNo WILC_MsgQueueDestroy(WILC_MsgQueueHandle* pHandle,
 WILC_ErrNo WILC_MsgQueueSend(WILC_MsgQueueHandle* pHandle,
 			const void * pvSendBuffer, WILC_Uint32 u32SendBufferSize,
 			tstrWILC_MsgQueueAttrs* pstrAttrs)
+{
+	return WILC_MsgQueueSendPrio(pHandle, pvSendBuffer, u32SendBufferSize,
+				     0, pstrAttrs);
+}
+
+/* Appends to the tail of class u32Prio, lists are kept per class */
+WILC_ErrNo WILC_MsgQueueSendPrio(WILC_MsgQueueHandle* pHandle,
+			const void * pvSendBuffer, WILC_Uint32 u32SendBufferSize,
+			WILC_Uint32 u32Prio, tstrWILC_MsgQueueAttrs* pstrAttrs)
 {
 	WILC_ErrNo s32RetStatus = WILC_SUCCESS;
 	unsigned long flags;
 	Message * pstrMessage = NULL;
+	tstrWILC_MsgQueueStats * pstrStats;
 	
-	if( (pHandle == NULL) || (u32SendBufferSize == 0) || (pvSendBuffer == NULL) )
+	if( (pHandle == NULL) || (u32SendBufferSize == 0) || (pvSendBuffer == NULL)
+		|| (u32Prio >= WILC_MSG_QUEUE_PRIOS) )
 	{
 		WILC_ERRORREPORT(s32RetStatus, WILC_INVALID_ARGUMENT);
 	}
@@ -98,22 +116,26 @@ WILC_ErrNo WILC_MsgQueueSend(WILC_MsgQueueHandle* pHandle,
 	pstrMessage->pvBuffer = WILC_MALLOC(u32SendBufferSize);
 	WILC_NULLCHECK(s32RetStatus, pstrMessage->pvBuffer);
 	WILC_memcpy(pstrMessage->pvBuffer, pvSendBuffer, u32SendBufferSize);
+	pstrMessage->tQueued = ktime_get();
 	
 
-	/* add it to the message queue */
-	if(pHandle->pstrMessageList == NULL)
+	/* add it to the tail of its class */
+	if(pHandle->pstrMessageList[u32Prio] == NULL)
 	{
-		pHandle->pstrMessageList  = pstrMessage;
+		pHandle->pstrMessageList[u32Prio]  = pstrMessage;
 	}
 	else
 	{
-		Message * pstrTailMsg = pHandle->pstrMessageList;
-		while(pstrTailMsg->pstrNext != NULL)
-		{
-			pstrTailMsg = pstrTailMsg->pstrNext;
-		}
-		pstrTailMsg->pstrNext = pstrMessage;
+		pHandle->pstrMessageTail[u32Prio]->pstrNext = pstrMessage;
 	}	
+	pHandle->pstrMessageTail[u32Prio] = pstrMessage;
+
+	pstrStats = &pHandle->astrStats[u32Prio];
+	pstrStats->u32Depth++;
+	if(pstrStats->u32Depth > pstrStats->u32MaxDepth)
+	{
+		pstrStats->u32MaxDepth = pstrStats->u32Depth;
+	}
 	
 	spin_unlock_irqrestore(&pHandle->strCriticalSection,flags);
 
@@ -149,9 +171,11 @@ WILC_ErrNo WILC_MsgQueueRecv(WILC_MsgQueueHandle* pHandle,
 			tstrWILC_MsgQueueAttrs* pstrAttrs)
 {
 
-	Message * pstrMessage;
+	Message * pstrMessage = NULL;
 	WILC_ErrNo s32RetStatus = WILC_SUCCESS;
 	tstrWILC_SemaphoreAttrs strSemAttrs;
+	tstrWILC_MsgQueueStats * pstrStats;
+	WILC_Uint32 u32Prio, u32WaitUs;
 	unsigned long flags;
 	if( (pHandle == NULL) || (u32RecvBufferSize == 0) 
 		|| (pvRecvBuffer == NULL) || (pu32ReceivedLength == NULL) )
@@ -195,7 +219,15 @@ WILC_ErrNo WILC_MsgQueueRecv(WILC_MsgQueueHandle* pHandle,
 
 		spin_lock_irqsave(&pHandle->strCriticalSection,flags);
 		
-		pstrMessage = pHandle->pstrMessageList;
+		/* oldest message of the highest priority class */
+		for(u32Prio = 0; u32Prio < WILC_MSG_QUEUE_PRIOS; u32Prio++)
+		{
+			pstrMessage = pHandle->pstrMessageList[u32Prio];
+			if(pstrMessage != NULL)
+			{
+				break;
+			}
+		}
 		if(pstrMessage == NULL)
 		{
 		spin_unlock_irqrestore(&pHandle->strCriticalSection,flags);
@@ -214,7 +246,21 @@ WILC_ErrNo WILC_MsgQueueRecv(WILC_MsgQueueHandle* pHandle,
 		WILC_memcpy(pvRecvBuffer, pstrMessage->pvBuffer, pstrMessage->u32Length);
 		*pu32ReceivedLength = pstrMessage->u32Length;
 
-		pHandle->pstrMessageList = pstrMessage->pstrNext;
+		pHandle->pstrMessageList[u32Prio] = pstrMessage->pstrNext;
+		if(pHandle->pstrMessageList[u32Prio] == NULL)
+		{
+			pHandle->pstrMessageTail[u32Prio] = NULL;
+		}
+
+		u32WaitUs = (WILC_Uint32)ktime_us_delta(ktime_get(), pstrMessage->tQueued);
+		pstrStats = &pHandle->astrStats[u32Prio];
+		pstrStats->u32Depth--;
+		pstrStats->u32Count++;
+		pstrStats->u64WaitUs += u32WaitUs;
+		if(u32WaitUs > pstrStats->u32MaxWaitUs)
+		{
+			pstrStats->u32MaxWaitUs = u32WaitUs;
+		}
 		
 		WILC_FREE(pstrMessage->pvBuffer);
 		WILC_FREE(pstrMessage);	
@@ -230,4 +276,29 @@ WILC_ErrNo WILC_MsgQueueRecv(WILC_MsgQueueHandle* pHandle,
 	return s32RetStatus;
 }
 
+WILC_ErrNo WILC_MsgQueueGetStats(WILC_MsgQueueHandle* pHandle, WILC_Uint32 u32Prio,
+			tstrWILC_MsgQueueStats* pstrStats, WILC_Bool bReset)
+{
+	unsigned long flags;
+
+	if( (pHandle == NULL) || (pstrStats == NULL) || (u32Prio >= WILC_MSG_QUEUE_PRIOS) )
+	{
+		return WILC_INVALID_ARGUMENT;
+	}
+
+	spin_lock_irqsave(&pHandle->strCriticalSection,flags);
+	*pstrStats = pHandle->astrStats[u32Prio];
+	if(bReset)
+	{
+		WILC_Uint32 u32Depth = pHandle->astrStats[u32Prio].u32Depth;
+
+		WILC_memset(&pHandle->astrStats[u32Prio], 0, sizeof(tstrWILC_MsgQueueStats));
+		pHandle->astrStats[u32Prio].u32Depth = u32Depth;
+		pHandle->astrStats[u32Prio].u32MaxDepth = u32Depth;
+	}
+	spin_unlock_irqrestore(&pHandle->strCriticalSection,flags);
+
+	return WILC_SUCCESS;
+}
+
 #endif
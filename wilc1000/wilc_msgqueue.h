@@ -93,6 +93,25 @@ WILC_ErrNo WILC_MsgQueueSend(WILC_MsgQueueHandle* pHandle,
 			tstrWILC_MsgQueueAttrs* pstrAttrs);
 
 
+/*!
+*  @brief		Sends a message with a priority
+*  @details		Like WILC_MsgQueueSend, the message goes to the tail of
+				priority class u32Prio. WILC_MsgQueueRecv returns the oldest
+				message of the lowest numbered non empty class, so order is
+				only kept within a class. WILC_MsgQueueSend uses class 0
+*  @param[in]	pHandle handle to the message queue object
+*  @param[in]	pvSendBuffer pointer to the data to send
+*  @param[in]	u32SendBufferSize the size of the data to send
+*  @param[in]	u32Prio priority class, below WILC_MSG_QUEUE_PRIOS
+*  @param[in]	pstrAttrs Optional attributes, NULL for default
+*  @return		Error code indicating sucess/failure
+*  @sa			tstrWILC_MsgQueueAttrs
+*/
+WILC_ErrNo WILC_MsgQueueSendPrio(WILC_MsgQueueHandle* pHandle,
+			const void * pvSendBuffer, WILC_Uint32 u32SendBufferSize,
+			WILC_Uint32 u32Prio, tstrWILC_MsgQueueAttrs* pstrAttrs);
+
+
 /*!
 *  @brief		Receives a message
 *  @details		Receives a message, this API will block unil a message is 
@@ -130,5 +149,19 @@ WILC_ErrNo WILC_MsgQueueDestroy(WILC_MsgQueueHandle* pHandle,
 			tstrWILC_MsgQueueAttrs* pstrAttrs);
 
 
+/*!
+*  @brief		Gets the statistics of a priority class
+*  @details		Current and maximum depth, number of messages received and
+				the time they waited in the queue
+*  @param[in]	pHandle handle to the message queue object
+*  @param[in]	u32Prio priority class, below WILC_MSG_QUEUE_PRIOS
+*  @param[out]	pstrStats filled with the statistics
+*  @param[in]	bReset clear the counters after reading them
+*  @return		Error code indicating sucess/failure
+*/
+WILC_ErrNo WILC_MsgQueueGetStats(WILC_MsgQueueHandle* pHandle, WILC_Uint32 u32Prio,
+			tstrWILC_MsgQueueStats* pstrStats, WILC_Bool bReset);
+
+
 
 #endif
@@ -135,6 +135,7 @@
 #include <linux/stat.h> 
 #include <linux/time.h> 
 #include <linux/version.h>
+#include <linux/ktime.h>
 #include "linux/string.h"
 /******************************************************************
 	OS specific types
@@ -149,21 +150,36 @@ typedef struct timer_list WILC_TimerHandle ;
 
 
 
+/* Priority classes of a message queue, 0 is served first */
+#define WILC_MSG_QUEUE_PRIOS	4
+
 /* Message Queue type is a structure */
 typedef struct __Message_struct
 {
 	void* pvBuffer;
 	WILC_Uint32 u32Length;
+	ktime_t tQueued;
 	struct __Message_struct *pstrNext;
 } Message;
 
+typedef struct
+{
+	WILC_Uint32 u32Depth;
+	WILC_Uint32 u32MaxDepth;
+	WILC_Uint32 u32Count;
+	WILC_Uint32 u32MaxWaitUs;
+	WILC_Uint64 u64WaitUs;
+} tstrWILC_MsgQueueStats;
+
 typedef struct __MessageQueue_struct
 {	
 	WILC_SemaphoreHandle hSem;
 	spinlock_t strCriticalSection;
 	WILC_Bool bExiting;
 	WILC_Uint32 u32ReceiversCount;
-	Message * pstrMessageList;
+	Message * pstrMessageList[WILC_MSG_QUEUE_PRIOS];
+	Message * pstrMessageTail[WILC_MSG_QUEUE_PRIOS];
+	tstrWILC_MsgQueueStats astrStats[WILC_MSG_QUEUE_PRIOS];
 } WILC_MsgQueueHandle;
 
 
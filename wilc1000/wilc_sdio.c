@@ -9,6 +9,7 @@
 
 #include "wilc_wlan_if.h"
 #include "wilc_wlan.h"
+#include <linux/ktime.h>
 
 
 #ifdef WILC1000_SINGLE_TRANSFER
@@ -21,29 +22,130 @@
 	#define WILC_SDIO_BLOCK_SIZE 512
  #endif
 #endif
+/* largest func 0 block size tried at init */
+#define WILC_SDIO_MAX_BLOCK_SIZE	2048
+
+/**
+	Block size / transfer mode benchmark, reads through the func 0 CSA
+	window which has the same CMD53 cost as func 1 data transfers.
+**/
+#define SDIO_BENCH_ADDR		WILC_AHB_DATA_MEM_BASE
+#define SDIO_BENCH_LEN		1600	/* typical data burst */
+#define SDIO_BENCH_LOOPS	16
 
 typedef struct {
 	void *os_context;
 	wilc_wlan_os_func_t os_func;
-	uint32_t block_size;
+	uint32_t block_size;	/* func 0, func 1 always uses WILC_SDIO_BLOCK_SIZE */
 	int (*sdio_cmd52)(sdio_cmd52_t *);
 	int (*sdio_cmd53)(sdio_cmd53_t *);
 	int (*sdio_set_max_speed)(void);
 	int (*sdio_set_default_speed)(void);
+	void (*sdio_claim)(void);
+	void (*sdio_release)(void);
+	int (*sdio_max_block_size)(void);
 	wilc_debug_func dPrint;
 	int nint;
 #define MAX_NUN_INT_THRPT_ENH2 (5) /* Max num interrupts allowed in registers 0xf7, 0xf8 */
 	int has_thrpt_enh3;
+	uint32_t csa_addr;	/* last address programmed in 0x10c..0x10e */
+	int csa_valid;
+	int pad_to_block;	/* pad func 1 transfers instead of a trailing byte mode CMD53 */
 } wilc_sdio_t;
 
 static wilc_sdio_t g_sdio;
 
+/* bus command counters, exported through debugfs */
+static struct {
+	uint32_t cmd52;
+	uint32_t cmd53;
+	uint32_t csa_set;	/* CSA bytes written */
+	uint32_t csa_skip;	/* CSA bytes already programmed */
+	uint32_t data_tx;	/* func 1 transfers */
+	uint32_t data_rx;
+} sdio_stats;
+
 #ifdef WILC_SDIO_IRQ_GPIO
 static int sdio_write_reg(uint32_t addr, uint32_t data);
 static int sdio_read_reg(uint32_t addr, uint32_t *data);
 #endif
 extern unsigned int int_clrd;
 
+/********************************************
+
+	Bus access
+
+********************************************/
+
+static int sdio_cmd52(sdio_cmd52_t *cmd)
+{
+	int ret;
+
+	sdio_stats.cmd52++;
+	ret = g_sdio.sdio_cmd52(cmd);
+	if (!ret) {
+		g_sdio.csa_valid = 0;
+		wilc_bus_gov_error();
+	}
+	return ret;
+}
+
+static int sdio_cmd53(sdio_cmd53_t *cmd)
+{
+	int ret;
+
+	sdio_stats.cmd53++;
+	ret = g_sdio.sdio_cmd53(cmd);
+	if (!ret) {
+		g_sdio.csa_valid = 0;
+		wilc_bus_gov_error();
+	}
+	return ret;
+}
+
+/**
+	Hold the host across a sequence of commands, so each command
+	does not claim and release it on its own. Calls can nest.
+**/
+static void sdio_claim(void)
+{
+	if (g_sdio.sdio_claim)
+		g_sdio.sdio_claim();
+}
+
+static void sdio_release(void)
+{
+	if (g_sdio.sdio_release)
+		g_sdio.sdio_release();
+}
+
+int sdio_stats_print(char *buf, int size)
+{
+	uint32_t data = sdio_stats.data_tx + sdio_stats.data_rx;
+	int res;
+
+	res = scnprintf(buf, size,
+			"block size func0 %u func1 %u, %s mode\n"
+			"cmd52 %u cmd53 %u csa set %u skipped %u\n"
+			"data tx %u rx %u\n",
+			g_sdio.block_size, WILC_SDIO_BLOCK_SIZE,
+			g_sdio.pad_to_block ? "pad" : "split",
+			sdio_stats.cmd52, sdio_stats.cmd53,
+			sdio_stats.csa_set, sdio_stats.csa_skip,
+			sdio_stats.data_tx, sdio_stats.data_rx);
+	if (data)
+		res += scnprintf(buf + res, size - res,
+				 "per data transfer: cmd52 %u.%02u cmd53 %u.%02u\n",
+				 sdio_stats.cmd52 / data, (sdio_stats.cmd52 % data) * 100 / data,
+				 sdio_stats.cmd53 / data, (sdio_stats.cmd53 % data) * 100 / data);
+	return res;
+}
+
+void sdio_stats_reset(void)
+{
+	memset(&sdio_stats, 0, sizeof(sdio_stats));
+}
+
 /********************************************
 
 	Function 0
@@ -53,6 +155,7 @@ extern unsigned int int_clrd;
 static int sdio_set_func0_csa_address(uint32_t adr)
 {
 	sdio_cmd52_t cmd;
+	int i;
 
 	/**
 		Review: BIG ENDIAN
@@ -60,26 +163,27 @@ static int sdio_set_func0_csa_address(uint32_t adr)
 	cmd.read_write = 1;
 	cmd.function = 0;
 	cmd.raw = 0;
-	cmd.address = 0x10c;
-	cmd.data = (uint8_t)adr;
-	if (!g_sdio.sdio_cmd52(&cmd)) {
-		g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x10c data...\n");
-		goto _fail_;
-	}
 
-	cmd.address = 0x10d;
-	cmd.data = (uint8_t)(adr>>8);
-	if (!g_sdio.sdio_cmd52(&cmd)) {
-		g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x10d data...\n");
-		goto _fail_;
-	}
+	/**
+		only write the bytes that differ from the programmed address
+	**/
+	for (i = 0; i < 3; i++) {
+		uint8_t byte = (uint8_t)(adr >> (i * 8));
 
-	cmd.address = 0x10e;
-	cmd.data = (uint8_t)(adr>>16);
-	if (!g_sdio.sdio_cmd52(&cmd)) {
-		g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x10e data...\n");
-		goto _fail_;
+		if (g_sdio.csa_valid && byte == (uint8_t)(g_sdio.csa_addr >> (i * 8))) {
+			sdio_stats.csa_skip++;
+			continue;
+		}
+		cmd.address = 0x10c + i;
+		cmd.data = byte;
+		sdio_stats.csa_set++;
+		if (!sdio_cmd52(&cmd)) {
+			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x%x data...\n", cmd.address);
+			goto _fail_;
+		}
 	}
+	g_sdio.csa_addr = adr;
+	g_sdio.csa_valid = 1;
 
 	return 1;
 _fail_:
@@ -99,10 +203,11 @@ static int sdio_set_func0_csa_address_byte0(uint32_t adr)
 	cmd.raw = 0;
 	cmd.address = 0x10c;
 	cmd.data = (uint8_t)adr;
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x10c data...\n");
 		goto _fail_;
 	}
+	g_sdio.csa_addr = (g_sdio.csa_addr & ~0xff) | (adr & 0xff);
 
 	return 1;
 _fail_:
@@ -117,14 +222,14 @@ static int sdio_set_func0_block_size(uint32_t block_size)
 	cmd.raw = 0;
 	cmd.address = 0x10;
 	cmd.data = (uint8_t)block_size;
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x10 data...\n");
 		goto _fail_;
 	}
 
 	cmd.address = 0x11;
 	cmd.data = (uint8_t)(block_size>>8);
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x11 data...\n");
 		goto _fail_;
 	}
@@ -149,13 +254,13 @@ static int sdio_set_func1_block_size(uint32_t block_size)
 	cmd.raw = 0;
 	cmd.address = 0x110;
 	cmd.data = (uint8_t)block_size;
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x110 data...\n");
 		goto _fail_;
 	}
 	cmd.address = 0x111;
 	cmd.data = (uint8_t)(block_size>>8);
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0x111 data...\n");
 		goto _fail_;
 	}
@@ -175,7 +280,7 @@ static int sdio_clear_int(void)
 	cmd.raw = 0;
 	cmd.address = 0x4;
 	cmd.data = 0;
-	g_sdio.sdio_cmd52(&cmd);
+	sdio_cmd52(&cmd);
 	int_clrd++;
 
 	return cmd.data;
@@ -197,12 +302,14 @@ uint32_t sdio_xfer_cnt(void)
 {
 	uint32_t cnt = 0;
 	sdio_cmd52_t cmd;
+
+	sdio_claim();
 	cmd.read_write = 0;
 	cmd.function = 1;
 	cmd.raw = 0;
 	cmd.address = 0x1C;
 	cmd.data = 0;
-	g_sdio.sdio_cmd52(&cmd);
+	sdio_cmd52(&cmd);
 	cnt = cmd.data;
 
 	cmd.read_write = 0;
@@ -210,7 +317,7 @@ uint32_t sdio_xfer_cnt(void)
 	cmd.raw = 0;
 	cmd.address = 0x1D;
 	cmd.data = 0;
-	g_sdio.sdio_cmd52(&cmd);
+	sdio_cmd52(&cmd);
 	cnt |= (cmd.data<<8);	
 
 	cmd.read_write = 0;
@@ -218,8 +325,9 @@ uint32_t sdio_xfer_cnt(void)
 	cmd.raw = 0;
 	cmd.address = 0x1E;
 	cmd.data = 0;
-	g_sdio.sdio_cmd52(&cmd);
+	sdio_cmd52(&cmd);
 	cnt |= (cmd.data<<16);		
+	sdio_release();
 	
 	return cnt;
 	
@@ -243,7 +351,7 @@ int sdio_check_bs(void)
 	cmd.raw = 0;
 	cmd.address = 0xc;
 	cmd.data = 0;
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Fail cmd 52, get BS register...\n");
 		goto _fail_;
 	}
@@ -261,6 +369,8 @@ static int sdio_write_reg(uint32_t addr, uint32_t data)
 	data = BYTE_SWAP(data);
 #endif
 
+	sdio_claim();
+
 	if((addr >= 0xf0) && (addr <= 0xff))
 	{
 		sdio_cmd52_t cmd;
@@ -269,7 +379,7 @@ static int sdio_write_reg(uint32_t addr, uint32_t data)
 		cmd.raw = 0;
 		cmd.address = addr;
 		cmd.data = data;
-		if (!g_sdio.sdio_cmd52(&cmd)) {
+		if (!sdio_cmd52(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd 52, read reg (%08x) ...\n", addr);
 			goto _fail_;
 		}
@@ -293,7 +403,7 @@ static int sdio_write_reg(uint32_t addr, uint32_t data)
 		cmd.buffer = (uint8_t *)&data;
 		cmd.block_size = g_sdio.block_size; //johnny : prevent it from setting unexpected value
 	
-		if (!g_sdio.sdio_cmd53(&cmd)) {
+		if (!sdio_cmd53(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd53, write reg (%08x)...\n", addr);
 			goto _fail_;
 		}
@@ -306,10 +416,11 @@ static int sdio_write_reg(uint32_t addr, uint32_t data)
 #endif
 	}
 
+	sdio_release();
 	return 1; 
 
 _fail_:
-
+	sdio_release();
 	return 0;
 }
 
@@ -319,6 +430,8 @@ static int sdio_write(uint32_t addr, uint8_t *buf, uint32_t size)
 	sdio_cmd53_t cmd;
 	int nblk, nleft;
 
+	sdio_claim();
+
 	cmd.read_write = 1;
 	if (addr > 0) {
 		/**
@@ -335,6 +448,7 @@ static int sdio_write(uint32_t addr, uint8_t *buf, uint32_t size)
 		cmd.function = 0;
 		cmd.address = 0x10f;
 	} else {
+		block_size = WILC_SDIO_BLOCK_SIZE;
 #ifdef WILC1000_SINGLE_TRANSFER
 		/**
 			has to be block aligned...
@@ -346,9 +460,12 @@ static int sdio_write(uint32_t addr, uint8_t *buf, uint32_t size)
 		}
 #else
 		/**
-			has to be word aligned...
+			pad to a whole number of blocks if that saves the
+			trailing byte mode CMD53, word align otherwise
 		**/
-		if (size & 0x3) {
+		if (g_sdio.pad_to_block && size > block_size && (size % block_size)) {
+			size += block_size - (size % block_size);
+		} else if (size & 0x3) {
 			size += 4;
 			size &= ~0x3;
 		}
@@ -359,6 +476,7 @@ static int sdio_write(uint32_t addr, uint8_t *buf, uint32_t size)
 		**/
 		cmd.function = 1;
 		cmd.address = 0;
+		sdio_stats.data_tx++;
 	}
 
 	nblk = size/block_size;
@@ -374,12 +492,15 @@ static int sdio_write(uint32_t addr, uint8_t *buf, uint32_t size)
 			if (!sdio_set_func0_csa_address(addr))
 				goto _fail_;
 		}
-		if (!g_sdio.sdio_cmd53(&cmd)) {
+		if (!sdio_cmd53(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd53 [%x], block send...\n",addr);
 			goto _fail_;
 		}
-		if (addr > 0)	
+		if (addr > 0) {
 			addr += nblk*block_size;
+			/* do not trust the CSA address after a burst */
+			g_sdio.csa_valid = 0;
+		}
 		buf += nblk*block_size;
 
 #if 0
@@ -404,10 +525,12 @@ static int sdio_write(uint32_t addr, uint8_t *buf, uint32_t size)
 			if (!sdio_set_func0_csa_address(addr))
 				goto _fail_;
 		}
-		if (!g_sdio.sdio_cmd53(&cmd)) {
+		if (!sdio_cmd53(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd53 [%x], bytes send...\n",addr);
 			goto _fail_;
 		}
+		if (addr > 0)
+			g_sdio.csa_valid = 0;
 
 #if 0
 		if (!sdio_check_bs())
@@ -417,15 +540,18 @@ static int sdio_write(uint32_t addr, uint8_t *buf, uint32_t size)
 #endif
 	}
 
+	sdio_release();
 	return 1; 
 
 _fail_:
-
+	sdio_release();
 	return 0;
 }
 
 static int sdio_read_reg(uint32_t addr, uint32_t *data)
 {
+	sdio_claim();
+
 	if((addr >= 0xf0) && (addr <= 0xff))
 	{
 		sdio_cmd52_t cmd;
@@ -433,7 +559,7 @@ static int sdio_read_reg(uint32_t addr, uint32_t *data)
 		cmd.function = 0;
 		cmd.raw = 0;
 		cmd.address= addr;
-		if (!g_sdio.sdio_cmd52(&cmd)) {
+		if (!sdio_cmd52(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd 52, read reg (%08x) ...\n", addr);
 			goto _fail_;
 		}
@@ -456,7 +582,7 @@ static int sdio_read_reg(uint32_t addr, uint32_t *data)
 
 		cmd.block_size = g_sdio.block_size; //johnny : prevent it from setting unexpected value
 
-		if (!g_sdio.sdio_cmd53(&cmd)) {
+		if (!sdio_cmd53(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd53, read reg (%08x)...\n", addr);
 			goto _fail_;
 		}
@@ -473,10 +599,11 @@ static int sdio_read_reg(uint32_t addr, uint32_t *data)
 	*data = BYTE_SWAP(*data);
 #endif
 
+	sdio_release();
 	return 1; 
 
 _fail_:
-
+	sdio_release();
 	return 0;
 }
 
@@ -486,6 +613,8 @@ static int sdio_read(uint32_t addr, uint8_t *buf, uint32_t size)
 	sdio_cmd53_t cmd;
 	int nblk, nleft;
 
+	sdio_claim();
+
 	cmd.read_write = 0;
 	if (addr > 0) {
 		/**
@@ -502,6 +631,7 @@ static int sdio_read(uint32_t addr, uint8_t *buf, uint32_t size)
 		cmd.function = 0;
 		cmd.address = 0x10f;
 	} else {
+		block_size = WILC_SDIO_BLOCK_SIZE;
 #ifdef WILC1000_SINGLE_TRANSFER
 		/**
 			has to be block aligned...
@@ -513,9 +643,12 @@ static int sdio_read(uint32_t addr, uint8_t *buf, uint32_t size)
 		}
 #else
 		/**
-			has to be word aligned...
+			pad to a whole number of blocks if that saves the
+			trailing byte mode CMD53, word align otherwise
 		**/
-		if (size & 0x3) {
+		if (g_sdio.pad_to_block && size > block_size && (size % block_size)) {
+			size += block_size - (size % block_size);
+		} else if (size & 0x3) {
 			size += 4;
 			size &= ~0x3;
 		}
@@ -526,6 +659,7 @@ static int sdio_read(uint32_t addr, uint8_t *buf, uint32_t size)
 		**/
 		cmd.function = 1;
 		cmd.address = 0;
+		sdio_stats.data_rx++;
 	}
 
 	nblk = size/block_size;
@@ -541,12 +675,15 @@ static int sdio_read(uint32_t addr, uint8_t *buf, uint32_t size)
 			if (!sdio_set_func0_csa_address(addr))
 				goto _fail_;
 		}
-		if (!g_sdio.sdio_cmd53(&cmd)) {
+		if (!sdio_cmd53(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd53 [%x], block read...\n",addr);
 			goto _fail_;
 		}
-		if (addr > 0)	
+		if (addr > 0) {
 			addr += nblk*block_size;
+			/* do not trust the CSA address after a burst */
+			g_sdio.csa_valid = 0;
+		}
 		buf += nblk*block_size;
 
 #if 0
@@ -570,10 +707,12 @@ static int sdio_read(uint32_t addr, uint8_t *buf, uint32_t size)
 			if (!sdio_set_func0_csa_address(addr))
 				goto _fail_;
 		}
-		if (!g_sdio.sdio_cmd53(&cmd)) {
+		if (!sdio_cmd53(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd53 [%x], bytes read...\n",addr);
 			goto _fail_;
 		}
+		if (addr > 0)
+			g_sdio.csa_valid = 0;
 
 #if 0
 		if (!sdio_check_bs())
@@ -583,10 +722,11 @@ static int sdio_read(uint32_t addr, uint8_t *buf, uint32_t size)
 #endif
 	}
 
+	sdio_release();
 	return 1; 
 
 _fail_:
-
+	sdio_release();
 	return 0;
 }
 
@@ -616,7 +756,8 @@ int wilc_sdio_reset(void *pv)
     cmd.raw = 0;
     cmd.address = 0x6;
     cmd.data = 0x8;
-    if (!g_sdio.sdio_cmd52(&cmd)) 
+    g_sdio.csa_valid = 0;
+    if (!sdio_cmd52(&cmd)) 
 	{
     	 g_sdio.dPrint(N_ERR, "[atwilc sdio]: Fail cmd 52, reset cmd ...\n");
     }
@@ -683,6 +824,91 @@ static int sdio_sync(void)
 	return 1;
 }
 
+#ifndef WILC1000_SINGLE_TRANSFER
+/**
+	Time the same burst with every block size the host and card allow,
+	split (full blocks + byte mode remainder) and padded to whole blocks.
+	A setting is rejected if it fails or reads back different data.
+	The fastest size is kept for func 0. Func 1 reads the RX FIFO and
+	cannot be checked this way, so it stays at WILC_SDIO_BLOCK_SIZE and
+	only takes the pad/split mode measured at that size.
+**/
+static void sdio_bench_block_size(void)
+{
+	uint32_t max_bs = WILC_SDIO_BLOCK_SIZE;
+	uint32_t bs, best_bs = WILC_SDIO_BLOCK_SIZE;
+	uint32_t len, best_time = 0xffffffff, best_time_f1 = 0xffffffff;
+	int pad, best_pad = 0, i;
+	uint8_t *ref, *buf;
+	ktime_t start;
+
+	if (g_sdio.sdio_max_block_size) {
+		max_bs = g_sdio.sdio_max_block_size();
+		if (max_bs > WILC_SDIO_MAX_BLOCK_SIZE)
+			max_bs = WILC_SDIO_MAX_BLOCK_SIZE;
+	}
+
+	ref = g_sdio.os_func.os_malloc(SDIO_BENCH_LEN);
+	buf = g_sdio.os_func.os_malloc(SDIO_BENCH_LEN + WILC_SDIO_MAX_BLOCK_SIZE);
+	if (ref == NULL || buf == NULL)
+		goto _out_;
+
+	if (!sdio_read(SDIO_BENCH_ADDR, ref, SDIO_BENCH_LEN))
+		goto _out_;
+
+	for (bs = WILC_SDIO_BLOCK_SIZE; bs <= max_bs; bs <<= 1) {
+		if (!sdio_set_func0_block_size(bs))
+			break;
+		g_sdio.block_size = bs;
+
+		for (pad = 0; pad < 2; pad++) {
+			uint32_t elapsed;
+
+			len = SDIO_BENCH_LEN;
+			if (pad && (len % bs))
+				len += bs - (len % bs);
+
+			start = ktime_get();
+			for (i = 0; i < SDIO_BENCH_LOOPS; i++) {
+				if (!sdio_read(SDIO_BENCH_ADDR, buf, len))
+					break;
+			}
+			elapsed = (uint32_t)ktime_us_delta(ktime_get(), start);
+
+			if (i < SDIO_BENCH_LOOPS || memcmp(ref, buf, SDIO_BENCH_LEN)) {
+				g_sdio.dPrint(N_INIT, "[wilc sdio]: block size %d (%s) not usable\n", bs, pad ? "pad" : "split");
+				continue;
+			}
+			g_sdio.dPrint(N_INIT, "[wilc sdio]: block size %d (%s): %d us\n", bs, pad ? "pad" : "split", elapsed);
+			if (elapsed < best_time) {
+				best_time = elapsed;
+				best_bs = bs;
+			}
+			if (bs == WILC_SDIO_BLOCK_SIZE && elapsed < best_time_f1) {
+				best_time_f1 = elapsed;
+				best_pad = pad;
+			}
+		}
+	}
+
+_out_:
+	if (ref != NULL)
+		g_sdio.os_func.os_free(ref);
+	if (buf != NULL)
+		g_sdio.os_func.os_free(buf);
+
+	if (!sdio_set_func0_block_size(best_bs)) {
+		/* fall back to the default the card was initialized with */
+		best_bs = WILC_SDIO_BLOCK_SIZE;
+		sdio_set_func0_block_size(best_bs);
+	}
+	g_sdio.block_size = best_bs;
+	g_sdio.pad_to_block = best_pad;
+	g_sdio.dPrint(N_INIT, "[wilc sdio]: using func 0 block size %d, func 1 %d %s mode\n",
+		      best_bs, WILC_SDIO_BLOCK_SIZE, best_pad ? "pad" : "split");
+}
+#endif
+
 int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 {
 	sdio_cmd52_t cmd;
@@ -709,7 +935,11 @@ int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 		g_sdio.sdio_cmd53 	= inp->io_func.u.sdio.sdio_cmd53;
 		g_sdio.sdio_set_max_speed 	= inp->io_func.u.sdio.sdio_set_max_speed;
 		g_sdio.sdio_set_default_speed 	= inp->io_func.u.sdio.sdio_set_default_speed;
+		g_sdio.sdio_claim 	= inp->io_func.u.sdio.sdio_claim;
+		g_sdio.sdio_release 	= inp->io_func.u.sdio.sdio_release;
+		g_sdio.sdio_max_block_size 	= inp->io_func.u.sdio.sdio_max_block_size;
 	}
+	g_sdio.csa_valid = 0;
 	/**
 		function 0 csa enable 
 	**/
@@ -718,7 +948,7 @@ int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 	cmd.raw = 1;
 	cmd.address = 0x100;
 	cmd.data = 0x80;
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Fail cmd 52, enable csa...\n");
 		goto _fail_;
 	}
@@ -726,11 +956,12 @@ int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 	/**
 		function 0 block size
 	**/
-	if (!sdio_set_func0_block_size(WILC_SDIO_BLOCK_SIZE)) {
+	if (inp != NULL)
+		g_sdio.block_size = WILC_SDIO_BLOCK_SIZE;
+	if (!sdio_set_func0_block_size(g_sdio.block_size)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Fail cmd 52, set func 0 block size...\n");
 		goto _fail_;
 	}
-	g_sdio.block_size = WILC_SDIO_BLOCK_SIZE;
 
 	/**
 		enable func1 IO
@@ -740,7 +971,7 @@ int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 	cmd.raw = 1;
 	cmd.address = 0x2;
 	cmd.data = 0x2;
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio] Fail cmd 52, set IOE register...\n");
 		goto _fail_;
 	}
@@ -755,7 +986,7 @@ int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 	loop = 3;
 	do {
 		cmd.data = 0;
-		if (!g_sdio.sdio_cmd52(&cmd)) {
+		if (!sdio_cmd52(&cmd)) {
 			g_sdio.dPrint(N_ERR, "[wilc sdio]: Fail cmd 52, get IOR register...\n");
 			goto _fail_;
 		}
@@ -784,7 +1015,7 @@ int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 	cmd.raw = 1;
 	cmd.address = 0x4;
 	cmd.data = 0x3;
-	if (!g_sdio.sdio_cmd52(&cmd)) {
+	if (!sdio_cmd52(&cmd)) {
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: Fail cmd 52, set IEN register...\n");
 		goto _fail_;
 	}
@@ -805,6 +1036,10 @@ int sdio_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 			g_sdio.has_thrpt_enh3 = 0;
 		}
 		g_sdio.dPrint(N_ERR, "[wilc sdio]: has_thrpt_enh3 = %d...\n", g_sdio.has_thrpt_enh3);
+
+#ifndef WILC1000_SINGLE_TRANSFER
+		sdio_bench_block_size();
+#endif
 	}
 
 	return 1;
@@ -833,13 +1068,14 @@ static int sdio_read_size(uint32_t * size)
 	/**
 		Read DMA count in words
 	**/	
+	sdio_claim();
 	{
 		cmd.read_write = 0;
 		cmd.function = 0;
 		cmd.raw = 0;
 		cmd.address = 0xf2;
 		cmd.data = 0;
-		g_sdio.sdio_cmd52(&cmd);
+		sdio_cmd52(&cmd);
 		tmp = cmd.data;
 
 		//cmd.read_write = 0;
@@ -847,9 +1083,10 @@ static int sdio_read_size(uint32_t * size)
 		//cmd.raw = 0;
 		cmd.address = 0xf3;
 		cmd.data = 0;
-		g_sdio.sdio_cmd52(&cmd);
+		sdio_cmd52(&cmd);
 		tmp |= (cmd.data << 8);	
 	}
+	sdio_release();
 	
 	*size=tmp;	
 	return 1;
@@ -861,6 +1098,7 @@ static int sdio_read_int(uint32_t * int_status)
 	uint32_t tmp;
 	sdio_cmd52_t cmd;
 
+	sdio_claim();
 	sdio_read_size(&tmp);
 
 	/**
@@ -872,7 +1110,7 @@ static int sdio_read_int(uint32_t * int_status)
 	//cmd.raw = 0;
 	cmd.address = 0x04;
 	cmd.data = 0;
-	g_sdio.sdio_cmd52(&cmd);
+	sdio_cmd52(&cmd);
 
 	if(cmd.data & (1 << 0)) {
 		tmp |= INT_0;
@@ -910,12 +1148,13 @@ static int sdio_read_int(uint32_t * int_status)
 		cmd.raw = 0;
 		cmd.address = 0xf7;
 		cmd.data = 0;
-		g_sdio.sdio_cmd52(&cmd);
+		sdio_cmd52(&cmd);
 		irq_flags = cmd.data & 0x1f;
 		tmp |= ((irq_flags >> 0) << IRG_FLAGS_OFFSET);		
 	} 
 
 #endif
+	sdio_release();
 	
 	*int_status = tmp;
 
@@ -952,7 +1191,7 @@ static int sdio_clear_int_ext(uint32_t val)
 			cmd.address = 0xf8;
 			cmd.data = reg;
 			
-			ret = g_sdio.sdio_cmd52(&cmd);
+			ret = sdio_cmd52(&cmd);
 			if (!ret) {
 				g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0xf8 data (%d) ...\n", __LINE__);
 				goto _fail_;
@@ -979,7 +1218,7 @@ static int sdio_clear_int_ext(uint32_t val)
 						cmd.address = 0xf8;
 						cmd.data = (1 << i);
 					
-						ret = g_sdio.sdio_cmd52(&cmd);
+						ret = sdio_cmd52(&cmd);
 						if (!ret) {
 							g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0xf8 data (%d) ...\n", __LINE__);
 							goto _fail_;
@@ -1020,7 +1259,7 @@ static int sdio_clear_int_ext(uint32_t val)
 				cmd.raw = 0;
 				cmd.address = 0xf6;
 				cmd.data = vmm_ctl;
-				ret = g_sdio.sdio_cmd52(&cmd);
+				ret = sdio_cmd52(&cmd);
 				if (!ret) {
 					g_sdio.dPrint(N_ERR, "[wilc sdio]: Failed cmd52, set 0xf6 data (%d) ...\n", __LINE__);
 					goto _fail_;
@@ -9,9 +9,14 @@
 
 #include "wilc_wlan_if.h"
 #include "wilc_wlan.h"
+#include <linux/crc-itu-t.h>
 
 extern unsigned int int_clrd;
 
+/* CRC16 on data blocks, applied when the bus is initialized */
+static int spi_data_crc = 0;
+module_param(spi_data_crc, int, 0644);
+
 /*
 #include <linux/kernel.h>
 #include <linux/string.h>
@@ -21,9 +26,13 @@ typedef struct {
 	int (*spi_tx)(uint8_t *, uint32_t);
 	int (*spi_rx)(uint8_t *, uint32_t);
 	int (*spi_trx)(uint8_t *, uint8_t *, uint32_t);
+	int (*spi_tx_async)(uint8_t *, uint32_t, uint8_t *, uint32_t, uint8_t *, uint32_t);
+	int (*spi_tx_async_flush)(void);
 	int (*spi_max_speed)(void);
+	int (*spi_default_speed)(void);
 	wilc_debug_func dPrint;
-	int crc_off;
+	int crc_off;		/* CRC7 on commands */
+	int data_crc_off;	/* CRC16 on data */
 	int nint;
 	int has_thrpt_enh;
 } wilc_spi_t;
@@ -86,6 +95,55 @@ static uint8_t crc7(uint8_t crc, const uint8_t *buffer, uint32_t len)
 	return crc;
 }
 
+/********************************************
+
+	Crc16
+
+********************************************/
+
+#define SPI_CRC_RETRY	3
+
+static struct {
+	uint32_t crc_err;	/* data blocks with a bad CRC16 */
+	uint32_t retries;	/* transactions repeated after a bad CRC16 */
+	uint32_t failed;	/* given up after SPI_CRC_RETRY */
+} spi_crc_stats;
+
+static void spi_crc16(const uint8_t *b, uint32_t len, uint8_t *crc)
+{
+	uint16_t val = crc_itu_t(0xffff, b, len);
+
+	crc[0] = (uint8_t)(val >> 8);
+	crc[1] = (uint8_t)val;
+}
+
+static int spi_crc16_check(const uint8_t *b, uint32_t len, const uint8_t *crc)
+{
+	uint8_t calc[2];
+
+	spi_crc16(b, len, calc);
+	if (calc[0] == crc[0] && calc[1] == crc[1])
+		return 1;
+
+	spi_crc_stats.crc_err++;
+	wilc_bus_gov_error();
+	PRINT_ER("[wilc spi]: Data CRC error, got %02x%02x expected %02x%02x\n",
+		 crc[0], crc[1], calc[0], calc[1]);
+	return 0;
+}
+
+int spi_crc_stats_print(char *buf, int size)
+{
+	return scnprintf(buf, size, "data crc %s\ncrc errors %u retries %u failed %u\n",
+			 g_spi.data_crc_off ? "off" : "on", spi_crc_stats.crc_err,
+			 spi_crc_stats.retries, spi_crc_stats.failed);
+}
+
+void spi_crc_stats_reset(void)
+{
+	memset(&spi_crc_stats, 0, sizeof(spi_crc_stats));
+}
+
 /********************************************
 
 	Spi protocol Function
@@ -270,6 +328,7 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 	uint8_t rsp;
 	int len = 0;
 	int result = N_OK;
+	int crc_err = 0;
 
 	wb[0] = cmd;
 	switch (cmd) {
@@ -369,7 +428,7 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 		(cmd == CMD_REPEAT)) {
 			len2 = len + (NUM_SKIP_BYTES + NUM_RSP_BYTES + NUM_DUMMY_BYTES);
 	} else if ((cmd == CMD_INTERNAL_READ) || (cmd == CMD_SINGLE_READ)) {
-		if (!g_spi.crc_off) {
+		if (!g_spi.data_crc_off) {
 			len2 = len + (NUM_RSP_BYTES + NUM_DATA_HDR_BYTES + NUM_DATA_BYTES 
 			+ NUM_CRC_BYTES + NUM_DUMMY_BYTES);	
 		} else {
@@ -450,6 +509,7 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 	if (rsp != cmd) {
 		PRINT_ER("[wilc spi]: Failed cmd response, cmd (%02x)"
 			", resp (%02x)\n", cmd, rsp);
+		wilc_bus_gov_error();
 		result = N_FAIL;
 		return result;
 	}
@@ -461,6 +521,7 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 	if (rsp != 0x00) {
 		PRINT_ER("[wilc spi]: Failed cmd state response "
 			"state (%02x)\n", rsp);
+		wilc_bus_gov_error();
 		result = N_FAIL;
 		return result;
 	}
@@ -508,7 +569,7 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 					return result;
 				}
 
-				if (!g_spi.crc_off) {						
+				if (!g_spi.data_crc_off) {						
 					/**
 					Read Crc
 					**/
@@ -520,6 +581,10 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 						result = N_FAIL;
 						return result;
 					}
+					if (!spi_crc16_check(b, 4, crc)) {
+						result = N_RETRY;
+						return result;
+					}
 				}
 			} else if((cmd == CMD_DMA_READ) || (cmd == CMD_DMA_EXT_READ)) {
 				int ix;
@@ -534,6 +599,24 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 #endif
 				sz -= ix;
 
+				if ((sz == 0) && ix && !g_spi.data_crc_off) {
+					int n = 0;
+
+					/**
+					The whole block came with the response,
+					its Crc follows
+					**/
+					while ((rix < len2) && (n < 2))
+						crc[n++] = rb[rix++];
+					if ((n < 2) && !g_spi.spi_rx(&crc[n], 2 - n)) {
+						PRINT_ER("[wilc spi]: Failed data block crc read, bus error...\n");
+						result = N_FAIL;
+						goto _error_;
+					}
+					if (!spi_crc16_check(b, ix, crc))
+						crc_err = 1;
+				}
+
 				if(sz > 0) {
 					int nbytes;
 					
@@ -553,14 +636,18 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 					}
 
 					/**
-					Read Crc
+					Read Crc, it covers the bytes read with the
+					response too
 					**/
-					if (!g_spi.crc_off) {
+					if (!g_spi.data_crc_off) {
 						if (!g_spi.spi_rx(crc, 2)) {
 							PRINT_ER("[wilc spi]: Failed data block crc read, bus error...\n");
 							result = N_FAIL;
 							goto _error_;
 						}
+						/* keep draining the transfer, report at the end */
+						if (!spi_crc16_check(b, ix + nbytes, crc))
+							crc_err = 1;
 					}
 
 					
@@ -616,12 +703,14 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 					/**
 					Read Crc
 					**/
-					if (!g_spi.crc_off) {
+					if (!g_spi.data_crc_off) {
 						if (!g_spi.spi_rx(crc, 2)) {
 							PRINT_ER("[wilc spi]: Failed data block crc read, bus error...\n");
 							result = N_FAIL;
 							break;
 						}
+						if (!spi_crc16_check(&b[ix], nbytes, crc))
+							crc_err = 1;
 					}
 
 					ix += nbytes;
@@ -630,6 +719,8 @@ static int spi_cmd_complete(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz,
 			}
 	}
 _error_:
+	if (result == N_OK && crc_err)
+		result = N_RETRY;
 	return result;
 }
 
@@ -637,6 +728,7 @@ static int spi_data_read(uint8_t *b, uint32_t sz)
 {
 	int retry, ix, nbytes;
 	int result = N_OK;
+	int crc_err = 0;
 	uint8_t crc[2];
 	uint8_t rsp;
 
@@ -685,12 +777,14 @@ static int spi_data_read(uint8_t *b, uint32_t sz)
 		/**
 			Read Crc
 		**/
-		if (!g_spi.crc_off) {
+		if (!g_spi.data_crc_off) {
 			if (!g_spi.spi_rx(crc, 2)) {
 				PRINT_ER("[wilc spi]: Failed data block crc read, bus error...\n");
 				result = N_FAIL;
 				break;
 			}
+			if (!spi_crc16_check(&b[ix], nbytes, crc))
+				crc_err = 1;
 		}
 
 		ix += nbytes;
@@ -698,6 +792,8 @@ static int spi_data_read(uint8_t *b, uint32_t sz)
 
 	} while (sz);
 
+	if (result == N_OK && crc_err)
+		result = N_RETRY;
 	return result;
 }
 
@@ -735,6 +831,25 @@ static int spi_data_write(uint8_t *b, uint32_t sz)
 				order = 0x2;
 		}
 		cmd |= order;	
+
+		if (!g_spi.data_crc_off)
+			spi_crc16(&b[ix], nbytes, crc);
+
+		/**
+			Queue command, data and crc as one block, the next
+			block is prepared while this one is on the bus
+		**/
+		if (g_spi.spi_tx_async) {
+			if (!g_spi.spi_tx_async(&cmd, 1, &b[ix], nbytes, crc, g_spi.data_crc_off ? 0 : 2)) {
+				PRINT_ER("[wilc spi]: Failed data block write, bus error...\n");
+				result = N_FAIL;
+				break;
+			}
+			ix += nbytes;
+			sz -= nbytes;
+			continue;
+		}
+
 		if (!g_spi.spi_tx(&cmd, 1)) {
 			PRINT_ER("[wilc spi]: Failed data block cmd write, bus error...\n");
 			result = N_FAIL;
@@ -753,7 +868,7 @@ static int spi_data_write(uint8_t *b, uint32_t sz)
 		/**
 			Write Crc
 		**/
-		if (!g_spi.crc_off) {
+		if (!g_spi.data_crc_off) {
 			if (!g_spi.spi_tx(crc, 2)) {
 				PRINT_ER("[wilc spi]: Failed data block crc write, bus error...\n");
 				result = N_FAIL;
@@ -794,10 +909,36 @@ static int spi_data_write(uint8_t *b, uint32_t sz)
 		sz -= nbytes;
 	} while (sz);
 
+	if (g_spi.spi_tx_async && !g_spi.spi_tx_async_flush()) {
+		PRINT_ER("[wilc spi]: Failed data block write, bus error...\n");
+		result = N_FAIL;
+	}
 
 	return result;
 }
 
+/**
+	Repeat a read transaction whose data failed the CRC16 check. Only for
+	register reads, a block read drains the RX FIFO and can't be repeated.
+**/
+static int spi_cmd_complete_retry(uint8_t cmd, uint32_t adr, uint8_t *b, uint32_t sz, uint8_t clockless)
+{
+	int retry = 0;
+	int result;
+
+	while (1) {
+		result = spi_cmd_complete(cmd, adr, b, sz, clockless);
+		if (result != N_RETRY)
+			return result;
+		if (++retry > SPI_CRC_RETRY)
+			break;
+		spi_crc_stats.retries++;
+	}
+
+	spi_crc_stats.failed++;
+	return N_FAIL;
+}
+
 /********************************************
 
 	Spi Internal Read/Write Function
@@ -862,7 +1003,7 @@ static int spi_internal_read(uint32_t adr, uint32_t *data)
 		return 0;
 	}
 #else
-	result = spi_cmd_complete(CMD_INTERNAL_READ, adr, (uint8_t*)data, 4, 0);
+	result = spi_cmd_complete_retry(CMD_INTERNAL_READ, adr, (uint8_t*)data, 4, 0);
 	if (result != N_OK) {
 		PRINT_ER("[wilc spi]: Failed internal read cmd...\n");
 		return 0;
@@ -1004,7 +1145,7 @@ static int spi_read_reg(uint32_t addr, uint32_t *data)
 		clockless = 1;
 	}
 	
-	result = spi_cmd_complete(cmd, addr, (uint8_t*)data, 4, clockless);
+	result = spi_cmd_complete_retry(cmd, addr, (uint8_t*)data, 4, clockless);
 	if (result != N_OK) {
 		PRINT_ER("[wilc spi]: Failed cmd, read reg (%08x)...\n", addr);
 		return 0;
@@ -1052,7 +1193,10 @@ static int spi_read(uint32_t addr, uint8_t *buf, uint32_t size)
 		return 0;
 	}
 #else
+		/* the data is gone from the FIFO, drop the frame on a bad CRC */
 		result = spi_cmd_complete(cmd, addr, buf, size, 0);
+		if (result == N_RETRY)
+			spi_crc_stats.failed++;
 		if (result != N_OK) {
 			PRINT_ER("[wilc spi]: Failed cmd, read block (%08x)...\n", addr);
 			return 0;
@@ -1063,6 +1207,47 @@ static int spi_read(uint32_t addr, uint8_t *buf, uint32_t size)
 	return 1;
 }
 
+/**
+	Read a list of registers, adjacent ones are coalesced into one
+	DMA transfer, clockless and isolated ones go out back to back.
+**/
+static uint32_t spi_regs_run(uint32_t *addrs, uint32_t n)
+{
+	uint32_t run = 1;
+
+	if (addrs[0] < 0x30)
+		return 1;
+	while ((run < n) && (addrs[run] == addrs[0] + (run * 4)))
+		run++;
+	return run;
+}
+
+static int spi_read_regs(uint32_t *addrs, uint32_t *vals, uint32_t n)
+{
+	uint32_t i, run;
+
+	for (i = 0; i < n; i += run) {
+		run = spi_regs_run(&addrs[i], n - i);
+		if (run == 1) {
+			if (!spi_read_reg(addrs[i], &vals[i]))
+				return 0;
+			continue;
+		}
+		if (!spi_read(addrs[i], (uint8_t *)&vals[i], run * 4))
+			return 0;
+#ifdef BIG_ENDIAN
+		{
+			uint32_t j;
+
+			for (j = i; j < i + run; j++)
+				vals[j] = BYTE_SWAP(vals[j]);
+		}
+#endif
+	}
+
+	return 1;
+}
+
 /********************************************
 
 	Bus interfaces
@@ -1159,12 +1344,16 @@ static int spi_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 	g_spi.spi_tx = inp->io_func.u.spi.spi_tx;
 	g_spi.spi_rx = inp->io_func.u.spi.spi_rx;
 	g_spi.spi_trx = inp->io_func.u.spi.spi_trx;
+	g_spi.spi_tx_async = inp->io_func.u.spi.spi_tx_async;
+	g_spi.spi_tx_async_flush = inp->io_func.u.spi.spi_tx_async_flush;
 	g_spi.spi_max_speed = inp->io_func.u.spi.spi_max_speed;
+	g_spi.spi_default_speed = inp->io_func.u.spi.spi_default_speed;
 
 	/**
 		configure protocol 
 	**/
 	g_spi.crc_off = 0;
+	g_spi.data_crc_off = 0;
 	
 	// TODO: We can remove the CRC trials if there is a definite way to reset 
 	// the SPI to it's initial value.
@@ -1172,6 +1361,7 @@ static int spi_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 		/* Read failed. Try with CRC off. This might happen when module 
 		is removed but chip isn't reset*/
 		g_spi.crc_off = 1;
+		g_spi.data_crc_off = 1;
 		PRINT_ER("[wilc spi]: Failed internal read protocol with CRC on, retyring with CRC off...\n");
 		if (!spi_internal_read(WILC_SPI_PROTOCOL_OFFSET, &reg)){
 			// Reaad failed with both CRC on and off, something went bad
@@ -1179,17 +1369,22 @@ static int spi_init(wilc_wlan_inp_t *inp, wilc_debug_func func)
 			return 0;
 		}
 	}
-	if(g_spi.crc_off == 0)
-	{
-		reg &= ~0xc;	/* disable crc checking */
-		reg &= ~0x70;
-		reg |= (0x5 << 4);
-		if (!spi_internal_write(WILC_SPI_PROTOCOL_OFFSET, reg)) {
-			PRINT_ER("[wilc spi]: Failed internal write protocol reg...\n");
-			return 0;
-		}
-		g_spi.crc_off = 1;
+
+	/**
+		always rewrite, a previous load may have left CRC16 in
+		a different state than spi_data_crc asks for
+	**/
+	reg &= ~0xc;	/* disable crc checking */
+	if (spi_data_crc)
+		reg |= (1 << 3);	/* keep CRC16 on data */
+	reg &= ~0x70;
+	reg |= (0x5 << 4);
+	if (!spi_internal_write(WILC_SPI_PROTOCOL_OFFSET, reg)) {
+		PRINT_ER("[wilc spi]: Failed internal write protocol reg...\n");
+		return 0;
 	}
+	g_spi.crc_off = 1;
+	g_spi.data_crc_off = !spi_data_crc;
 		
 
 	/**
@@ -1215,6 +1410,8 @@ static void spi_max_bus_speed(void)
 
 static void spi_default_bus_speed(void)
 {
+	if (g_spi.spi_default_speed)
+		g_spi.spi_default_speed();
 }
 
 static int spi_read_size(uint32_t * size)
@@ -1263,16 +1460,17 @@ static int spi_read_int(uint32_t * int_status)
 
 			j = 0;
 			do {
-				uint32_t irq_flags;
+				uint32_t irq_addrs[2] = {0x1a90, 0x1a94};
+				uint32_t irq_flags[2] = {0, 0};
 
 				happended = 0;
 
-				spi_read_reg(0x1a90, &irq_flags);		
-				tmp |= ((irq_flags >> 27) << IRG_FLAGS_OFFSET);
+				/* both flag registers in one transfer when needed */
+				spi_read_regs(irq_addrs, irq_flags, (g_spi.nint > 5) ? 2 : 1);
+				tmp |= ((irq_flags[0] >> 27) << IRG_FLAGS_OFFSET);
 				
 				if(g_spi.nint > 5) {
-					spi_read_reg(0x1a94, &irq_flags);		
-					tmp |= (((irq_flags >> 0) & 0x7) << (IRG_FLAGS_OFFSET+5));
+					tmp |= (((irq_flags[1] >> 0) & 0x7) << (IRG_FLAGS_OFFSET+5));
 				}		
 				
 				{
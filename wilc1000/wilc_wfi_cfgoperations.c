@@ -13,6 +13,7 @@
 #include "wilc_wfi_cfgoperations.h"
 #include "wilc_wlan.c"
 #include "linux_wlan.h"
+#include <linux/jhash.h>
 #ifdef WILC_SDIO
 #include "linux_wlan_sdio.h"    //tony : for set_wiphy_dev()
 #endif
@@ -37,7 +38,6 @@ WILC_Uint32 u32LastScannedNtwrksCountShadow;
 WILC_TimerHandle hDuringIpTimer;
 #endif
 WILC_TimerHandle hAgingTimer;
-struct timer_list hEAPFrameBuffTimer;
 static WILC_Uint8 op_ifcs=0;
 extern WILC_Uint8 u8ConnectedSSID[6];
 
@@ -184,12 +184,79 @@ uint32_t get_rssi_avg(struct tstrNetworkInfo* pstrNetworkInfo)
 	return rssi_v;
 }
 
-void refresh_scan(void* pUserVoid,uint8_t all,WILC_Bool bDirectScan){
+/* Start of the last cfg80211 scan, networks not reported since then are flushed at scan done */
+static unsigned long u32ShadowScanStart;
+
+/**
+*  @brief 	shadow_ies_hash
+*  @details  Hashes the IEs of a scanned network so that a re-received beacon or probe
+*  			  response can be compared with the cached copy without a byte compare.
+*  			  The TIM element is skipped as its DTIM count changes with every beacon.
+*/
+static WILC_Uint32 shadow_ies_hash(WILC_Uint8* pu8IEs, WILC_Uint16 u16IEsLen)
+{
+	WILC_Uint32 u32Hash = 0;
+	WILC_Uint16 u16Index = 0;
+
+	while(u16Index + 2 <= u16IEsLen)
+	{
+		WILC_Uint16 u16ElemLen = pu8IEs[u16Index + 1] + 2;
+
+		if(u16Index + u16ElemLen > u16IEsLen)
+			break;
+		if(pu8IEs[u16Index] != WLAN_EID_TIM)
+			u32Hash = jhash(&pu8IEs[u16Index], u16ElemLen, u32Hash);
+		u16Index += u16ElemLen;
+	}
+
+	/* Trailing bytes that do not form a complete element */
+	if(u16Index < u16IEsLen)
+		u32Hash = jhash(&pu8IEs[u16Index], u16IEsLen - u16Index, u32Hash);
+
+	return u32Hash;
+}
+
+/**
+*  @brief 	shadow_needs_inform
+*  @details  Returns WILC_TRUE if the cached network has to be (re)reported to cfg80211:
+*  			  its IEs changed since the last report, its averaged RSSI moved by
+*  			  SCAN_RSSI_REPORT_DELTA or more, or the cfg80211 entry is about to expire.
+*  			  cfg80211 drops every BSS not updated since the start of the scan when the
+*  			  scan is done, so a network reported before that has to be reported again.
+*/
+static WILC_Bool shadow_needs_inform(struct tstrNetworkInfo* pstrNetworkInfo, int rssi)
+{
+	if(pstrNetworkInfo->u8Changed)
+		return WILC_TRUE;
+
+	if(abs(rssi - pstrNetworkInfo->s8RssiInformed) >= SCAN_RSSI_REPORT_DELTA)
+		return WILC_TRUE;
+
+	if(time_before(pstrNetworkInfo->u32TimeInformed, u32ShadowScanStart))
+		return WILC_TRUE;
+
+	/* BugID_4209: same margin as the connect time refresh */
+	if(time_after(jiffies, pstrNetworkInfo->u32TimeInformed + (unsigned long)(nl80211_SCAN_RESULT_EXPIRE - (1 * HZ))))
+		return WILC_TRUE;
+
+	return WILC_FALSE;
+}
+
+static void shadow_mark_informed(struct tstrNetworkInfo* pstrNetworkInfo, int rssi)
+{
+	pstrNetworkInfo->u8Changed = 0;
+	pstrNetworkInfo->s8RssiInformed = rssi;
+	pstrNetworkInfo->u32TimeInformed = jiffies;
+}
+
+void refresh_scan(void* pUserVoid,uint8_t all,WILC_Bool bDirectScan,WILC_Bool bForce){
  	struct WILC_WFI_priv* priv;
 	struct wiphy* wiphy;
 	struct cfg80211_bss* bss = NULL;
 	int i;
 	int rssi = 0;
+	WILC_Uint32 u32Informed = 0;
+	WILC_Uint32 u32Skipped = 0;
 
  	priv = (struct WILC_WFI_priv*)pUserVoid;
 	wiphy = priv->dev->ieee80211_ptr->wiphy;
@@ -216,6 +283,12 @@ void refresh_scan(void* pUserVoid,uint8_t all,WILC_Bool bDirectScan){
 				channel = ieee80211_get_channel(wiphy, s32Freq);
 
 				rssi = get_rssi_avg(pstrNetworkInfo);
+				if(!bForce && !shadow_needs_inform(pstrNetworkInfo, rssi))
+				{
+					u32Skipped++;
+					continue;
+				}
+
 				if(WILC_memcmp("DIRECT-", pstrNetworkInfo->au8ssid, 7) || bDirectScan)
 				{
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 18, 0)
@@ -232,18 +305,22 @@ void refresh_scan(void* pUserVoid,uint8_t all,WILC_Bool bDirectScan){
 #else
 					cfg80211_put_bss(bss);
 #endif
+					shadow_mark_informed(pstrNetworkInfo, rssi);
+					u32Informed++;
 				}
 			}
 
 		}
 	}
 
+	PRINT_D(CFG80211_DBG,"Refresh scan: %d network(s) informed, %d unchanged\n",u32Informed,u32Skipped);
 }
 
 void reset_shadow_found(void* pUserVoid){
  	struct WILC_WFI_priv* priv;
 	int i;
  	priv = (struct WILC_WFI_priv*)pUserVoid;
+	u32ShadowScanStart = jiffies;
 	for(i=0;i<u32LastScannedNtwrksCountShadow;i++){
 		astrLastScannedNtwrksShadow[i].u8Found = 0;
 
@@ -323,16 +400,18 @@ int8_t is_network_in_shadow(struct tstrNetworkInfo* pstrNetworkInfo,void* pUserV
 	return state;
 }
 
-void add_network_to_shadow(struct tstrNetworkInfo* pstrNetworkInfo,void* pUserVoid, void* pJoinParams){
+struct tstrNetworkInfo* add_network_to_shadow(struct tstrNetworkInfo* pstrNetworkInfo,void* pUserVoid, void* pJoinParams){
  	struct WILC_WFI_priv* priv;
 	int8_t ap_found = is_network_in_shadow(pstrNetworkInfo,pUserVoid);
 	uint32_t ap_index = 0;
 	uint8_t rssi_index = 0;
+	WILC_Uint32 u32IEsHash;
+	struct tstrNetworkInfo* pstrShadow;
  	priv = (struct WILC_WFI_priv*)pUserVoid;
 
 	if(u32LastScannedNtwrksCountShadow >= MAX_NUM_SCANNED_NETWORKS_SHADOW){
 		PRINT_D(CFG80211_DBG,"Shadow network reached its maximum limit\n");
-		return;
+		return WILC_NULL;
 	}
 	if(ap_found == -1){
 			ap_index = u32LastScannedNtwrksCountShadow;
@@ -341,46 +420,76 @@ void add_network_to_shadow(struct tstrNetworkInfo* pstrNetworkInfo,void* pUserVo
 		}else{
 			ap_index = ap_found;
 			}
-		rssi_index = astrLastScannedNtwrksShadow[ap_index].strRssi.u8Index;
-		astrLastScannedNtwrksShadow[ap_index].strRssi.as8RSSI[rssi_index++] = pstrNetworkInfo->s8rssi;
+		pstrShadow = &astrLastScannedNtwrksShadow[ap_index];
+		u32IEsHash = shadow_ies_hash(pstrNetworkInfo->pu8IEs, pstrNetworkInfo->u16IEsLen);
+
+		if(ap_found == -1)
+		{
+			pstrShadow->strRssi.u8Full = 0;
+			pstrShadow->strRssi.u8Index = 0;
+		}
+		rssi_index = pstrShadow->strRssi.u8Index;
+		pstrShadow->strRssi.as8RSSI[rssi_index++] = pstrNetworkInfo->s8rssi;
 		if(rssi_index == NUM_RSSI)
 		{
 			rssi_index = 0;
-			astrLastScannedNtwrksShadow[ap_index].strRssi.u8Full = 1;
+			pstrShadow->strRssi.u8Full = 1;
 		}
-		astrLastScannedNtwrksShadow[ap_index].strRssi.u8Index = rssi_index;
+		pstrShadow->strRssi.u8Index = rssi_index;
+
+		pstrShadow->s8rssi = pstrNetworkInfo->s8rssi;
+		pstrShadow->u64Tsf = pstrNetworkInfo->u64Tsf;
+		pstrShadow->u32TimeRcvdInScan = jiffies;
+		pstrShadow->u32TimeRcvdInScanCached = jiffies;
+		pstrShadow->u8Found = 1;
+
+	/* Nothing but the RSSI and TSF changed, keep the cached IEs instead of reallocating them */
+	if(ap_found != -1
+	   && pstrShadow->pu8IEs != NULL
+	   && pstrShadow->u32IEsHash == u32IEsHash
+	   && pstrShadow->u16IEsLen == pstrNetworkInfo->u16IEsLen
+	   && pstrShadow->u16CapInfo == pstrNetworkInfo->u16CapInfo
+	   && pstrShadow->u8channel == pstrNetworkInfo->u8channel)
+	{
+		if(pJoinParams != NULL)
+		{
+			host_int_freeJoinParams(pstrShadow->pJoinParams);
+			pstrShadow->pJoinParams = pJoinParams;
+		}
+		return pstrShadow;
+	}
 
-		astrLastScannedNtwrksShadow[ap_index].s8rssi = pstrNetworkInfo->s8rssi;
-		astrLastScannedNtwrksShadow[ap_index].u16CapInfo = pstrNetworkInfo->u16CapInfo;
+		pstrShadow->u16CapInfo = pstrNetworkInfo->u16CapInfo;
 
-		astrLastScannedNtwrksShadow[ap_index].u8SsidLen = pstrNetworkInfo->u8SsidLen;
-		WILC_memcpy(astrLastScannedNtwrksShadow[ap_index].au8ssid,
+		pstrShadow->u8SsidLen = pstrNetworkInfo->u8SsidLen;
+		WILC_memcpy(pstrShadow->au8ssid,
 				  	  pstrNetworkInfo->au8ssid, pstrNetworkInfo->u8SsidLen);
 
-		WILC_memcpy(astrLastScannedNtwrksShadow[ap_index].au8bssid,
+		WILC_memcpy(pstrShadow->au8bssid,
 				  	  pstrNetworkInfo->au8bssid, ETH_ALEN);
 
-		astrLastScannedNtwrksShadow[ap_index].u16BeaconPeriod = pstrNetworkInfo->u16BeaconPeriod;
-		astrLastScannedNtwrksShadow[ap_index].u8DtimPeriod = pstrNetworkInfo->u8DtimPeriod;
-		astrLastScannedNtwrksShadow[ap_index].u8channel = pstrNetworkInfo->u8channel;
+		pstrShadow->u16BeaconPeriod = pstrNetworkInfo->u16BeaconPeriod;
+		pstrShadow->u8DtimPeriod = pstrNetworkInfo->u8DtimPeriod;
+		pstrShadow->u8channel = pstrNetworkInfo->u8channel;
 
-		astrLastScannedNtwrksShadow[ap_index].u16IEsLen = pstrNetworkInfo->u16IEsLen;
-		astrLastScannedNtwrksShadow[ap_index].u64Tsf = pstrNetworkInfo->u64Tsf;
+		pstrShadow->u16IEsLen = pstrNetworkInfo->u16IEsLen;
 	if(ap_found != -1)
-		WILC_FREE(astrLastScannedNtwrksShadow[ap_index].pu8IEs);
-		astrLastScannedNtwrksShadow[ap_index].pu8IEs =
+		WILC_FREE(pstrShadow->pu8IEs);
+		pstrShadow->pu8IEs =
 			(WILC_Uint8*)WILC_MALLOC(pstrNetworkInfo->u16IEsLen); /* will be deallocated
 																   by the WILC_WFI_CfgScan() function */
-		WILC_memcpy(astrLastScannedNtwrksShadow[ap_index].pu8IEs,
+		WILC_memcpy(pstrShadow->pu8IEs,
 				  	  pstrNetworkInfo->pu8IEs, pstrNetworkInfo->u16IEsLen);
+		WILC_memcpy(pstrShadow->au16IEOffset,
+				  	  pstrNetworkInfo->au16IEOffset, sizeof(pstrShadow->au16IEOffset));
+		pstrShadow->u32IEsHash = u32IEsHash;
+		pstrShadow->u8Changed = 1;
 
-		astrLastScannedNtwrksShadow[ap_index].u32TimeRcvdInScan = jiffies;
-		astrLastScannedNtwrksShadow[ap_index].u32TimeRcvdInScanCached = jiffies;
-		astrLastScannedNtwrksShadow[ap_index].u8Found = 1;
 	if(ap_found != -1)
-		host_int_freeJoinParams(astrLastScannedNtwrksShadow[ap_index].pJoinParams);
-		astrLastScannedNtwrksShadow[ap_index].pJoinParams = pJoinParams;
+		host_int_freeJoinParams(pstrShadow->pJoinParams);
+		pstrShadow->pJoinParams = pJoinParams;
 
+	return pstrShadow;
 }
 
 
@@ -405,6 +514,8 @@ static void CfgScanResult(enum tenuScanEvent enuScanEvent, struct tstrNetworkInf
  	struct ieee80211_channel *channel;
 	WILC_Sint32 s32Error = WILC_SUCCESS;
 	struct cfg80211_bss* bss = NULL;
+	struct tstrNetworkInfo* pstrShadow = WILC_NULL;
+	WILC_Sint32 s32RssiAvg = 0;
 
  	priv = (struct WILC_WFI_priv*)pUserVoid;
  	if(priv->bCfgScanning == WILC_TRUE)
@@ -453,11 +564,15 @@ static void CfgScanResult(enum tenuScanEvent enuScanEvent, struct tstrNetworkInf
 							if(pJoinParams == NULL){
 								PRINT_INFO(CORECONFIG_DBG, ">> Something really bad happened\n");
 							}
-							add_network_to_shadow(pstrNetworkInfo,priv,pJoinParams);
+							pstrShadow = add_network_to_shadow(pstrNetworkInfo,priv,pJoinParams);
+							/* judge and record changes on the averaged RSSI, as refresh_scan() does */
+							if(pstrShadow != WILC_NULL)
+								s32RssiAvg = get_rssi_avg(pstrShadow);
 
 							/*P2P peers are sent to WPA supplicant and added to shadow table*/
 
-							if(!(WILC_memcmp("DIRECT-", pstrNetworkInfo->au8ssid, 7) ))
+							if(!(WILC_memcmp("DIRECT-", pstrNetworkInfo->au8ssid, 7) )
+							   && (pstrShadow == WILC_NULL || shadow_needs_inform(pstrShadow, s32RssiAvg)))
 							{
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 18, 0)
 								bss = cfg80211_inform_bss(wiphy, channel, CFG80211_BSS_FTYPE_UNKNOWN,  pstrNetworkInfo->au8bssid, pstrNetworkInfo->u64Tsf, pstrNetworkInfo->u16CapInfo,
@@ -473,6 +588,8 @@ static void CfgScanResult(enum tenuScanEvent enuScanEvent, struct tstrNetworkInf
 #else
 								cfg80211_put_bss(bss);
 #endif
+								if(pstrShadow != WILC_NULL)
+									shadow_mark_informed(pstrShadow, s32RssiAvg);
 							}
 
 
@@ -504,7 +621,7 @@ static void CfgScanResult(enum tenuScanEvent enuScanEvent, struct tstrNetworkInf
  		{
  			PRINT_D(CFG80211_DBG,"Scan Done[%p] \n",priv->dev);
  			PRINT_D(CFG80211_DBG,"Refreshing Scan ... \n");
-			refresh_scan(priv,1,WILC_FALSE);
+			refresh_scan(priv,1,WILC_FALSE,WILC_FALSE);
 
  			if(priv->u32RcvdChCount > 0)
  			{
@@ -524,6 +641,12 @@ static void CfgScanResult(enum tenuScanEvent enuScanEvent, struct tstrNetworkInf
 				priv->bCfgScanning = WILC_FALSE;
 				priv->pstrScanReq = WILC_NULL;
 			}
+			else if(priv->bJoinProbe)
+			{
+				priv->u32RcvdChCount = 0;
+				priv->bCfgScanning = WILC_FALSE;
+				priv->bJoinProbe = WILC_FALSE;
+			}
 			WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
 
  		}
@@ -537,12 +660,18 @@ static void CfgScanResult(enum tenuScanEvent enuScanEvent, struct tstrNetworkInf
    			{
 
 				update_scan_time(priv);
-				refresh_scan(priv,1,WILC_FALSE);
+				refresh_scan(priv,1,WILC_FALSE,WILC_FALSE);
 
 				cfg80211_scan_done(priv->pstrScanReq,WILC_FALSE);
 				priv->bCfgScanning = WILC_FALSE;
 				priv->pstrScanReq = WILC_NULL;
   			}
+			else if(priv->bJoinProbe)
+			{
+				priv->u32RcvdChCount = 0;
+				priv->bCfgScanning = WILC_FALSE;
+				priv->bJoinProbe = WILC_FALSE;
+			}
 			WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
 		}
  	}
@@ -593,6 +722,370 @@ int WILC_WFI_Set_PMKSA(WILC_Uint8 * bssid,struct WILC_WFI_priv* priv)
 }
 int linux_wlan_set_bssid(struct net_device * wilc_netdev,uint8_t * pBSSID,uint8_t mode);
 
+/*
+ * Join cache: the last few networks we joined successfully, kept apart from
+ * the scan shadow so that they survive its aging. When the shadow no longer
+ * holds the requested network we join straight on the cached channel with
+ * the cached join parameters. Each entry gets one direct attempt; if it
+ * fails the entry is dropped and the cached channel is probed once for the
+ * SSID, so the shadow is fresh for the supplicant's next connect.
+ */
+#define WILC_JOIN_CACHE_SIZE	4
+
+enum {
+	JOIN_VIA_SCAN = 0,
+	JOIN_VIA_CACHE,
+	JOIN_VIA_MAX
+};
+
+struct wilc_join_stats {
+	WILC_Uint32 u32Attempts;
+	WILC_Uint32 u32Success;
+	WILC_Uint32 u32Failed;
+	WILC_Uint32 u32TotalMs;
+	WILC_Uint32 u32LastMs;
+	WILC_Uint32 u32MaxMs;
+};
+
+static struct wilc_join_cache_ent astrJoinCache[WILC_JOIN_CACHE_SIZE];
+static struct wilc_join_stats astrJoinStats[JOIN_VIA_MAX];
+static DEFINE_MUTEX(join_cache_lock);
+
+static void join_ent_free(struct wilc_join_cache_ent *pstrEnt)
+{
+	if (pstrEnt->pu8IEs != NULL)
+		WILC_FREE(pstrEnt->pu8IEs);
+	if (pstrEnt->pJoinParams != NULL)
+		host_int_freeJoinParams(pstrEnt->pJoinParams);
+	WILC_memset(pstrEnt, 0, sizeof(*pstrEnt));
+}
+
+/* must be called with join_cache_lock held */
+static struct wilc_join_cache_ent *join_cache_find(const WILC_Uint8 *pu8ssid, WILC_Uint8 u8SsidLen,
+						   const WILC_Uint8 *pu8bssid)
+{
+	struct wilc_join_cache_ent *pstrBest = NULL;
+	int i;
+
+	for (i = 0; i < WILC_JOIN_CACHE_SIZE; i++) {
+		struct wilc_join_cache_ent *pstrEnt = &astrJoinCache[i];
+
+		if (!pstrEnt->bValid || pstrEnt->u8SsidLen != u8SsidLen ||
+		    WILC_memcmp(pstrEnt->au8ssid, pu8ssid, u8SsidLen) != 0)
+			continue;
+		if (pu8bssid != NULL && WILC_memcmp(pstrEnt->au8bssid, pu8bssid, ETH_ALEN) != 0)
+			continue;
+		/* without a BSSID hint, take the one we joined most recently */
+		if (pstrBest == NULL || time_after(pstrEnt->u32Stamp, pstrBest->u32Stamp))
+			pstrBest = pstrEnt;
+	}
+
+	return pstrBest;
+}
+
+/* must be called with join_cache_lock held */
+static WILC_Sint32 join_ent_copy(struct wilc_join_cache_ent *pstrDst,
+				 const struct wilc_join_cache_ent *pstrSrc)
+{
+	*pstrDst = *pstrSrc;
+	pstrDst->pu8IEs = NULL;
+	pstrDst->pJoinParams = host_int_copyJoinParams(pstrSrc->pJoinParams);
+	if (pstrSrc->u16IEsLen > 0) {
+		pstrDst->pu8IEs = WILC_MALLOC(pstrSrc->u16IEsLen);
+		if (pstrDst->pu8IEs != NULL)
+			WILC_memcpy(pstrDst->pu8IEs, pstrSrc->pu8IEs, pstrSrc->u16IEsLen);
+		else
+			pstrDst->u16IEsLen = 0;
+	}
+
+	if (pstrDst->pJoinParams == NULL) {
+		join_ent_free(pstrDst);
+		return WILC_NO_MEM;
+	}
+
+	return WILC_SUCCESS;
+}
+
+/* Take a private copy of what we are about to join from the scan shadow */
+static WILC_Sint32 join_pending_from_shadow(struct WILC_WFI_priv *priv,
+					    struct tstrNetworkInfo *pstrNetworkInfo)
+{
+	struct wilc_join_cache_ent strEnt;
+	WILC_Sint32 s32Error;
+
+	WILC_memset(&strEnt, 0, sizeof(strEnt));
+	strEnt.bValid = WILC_TRUE;
+	strEnt.u8SsidLen = pstrNetworkInfo->u8SsidLen;
+	WILC_memcpy(strEnt.au8ssid, pstrNetworkInfo->au8ssid, MAX_SSID_LEN);
+	WILC_memcpy(strEnt.au8bssid, pstrNetworkInfo->au8bssid, ETH_ALEN);
+	strEnt.u8channel = pstrNetworkInfo->u8channel;
+	strEnt.u16CapInfo = pstrNetworkInfo->u16CapInfo;
+	strEnt.u16BeaconPeriod = pstrNetworkInfo->u16BeaconPeriod;
+	strEnt.s8rssi = pstrNetworkInfo->s8rssi;
+	strEnt.pu8IEs = pstrNetworkInfo->pu8IEs;
+	strEnt.u16IEsLen = pstrNetworkInfo->u16IEsLen;
+	strEnt.pJoinParams = pstrNetworkInfo->pJoinParams;
+
+	mutex_lock(&join_cache_lock);
+	join_ent_free(&priv->strJoinPending);
+	s32Error = join_ent_copy(&priv->strJoinPending, &strEnt);
+	priv->bJoinFromCache = WILC_FALSE;
+	if (s32Error == WILC_SUCCESS)
+		astrJoinStats[JOIN_VIA_SCAN].u32Attempts++;
+	mutex_unlock(&join_cache_lock);
+
+	return s32Error;
+}
+
+/* Fall back on the join cache when the scan shadow has nothing to offer */
+static WILC_Sint32 join_pending_from_cache(struct WILC_WFI_priv *priv,
+					   struct cfg80211_connect_params *sme)
+{
+	struct wilc_join_cache_ent *pstrEnt;
+	WILC_Sint32 s32Error = WILC_NOT_FOUND;
+
+	mutex_lock(&join_cache_lock);
+	join_ent_free(&priv->strJoinPending);
+	pstrEnt = join_cache_find(sme->ssid, sme->ssid_len, sme->bssid);
+	/* the supplicant may already know the AP moved */
+	if (pstrEnt != NULL && sme->channel != NULL &&
+	    ieee80211_frequency_to_channel(sme->channel->center_freq) != pstrEnt->u8channel)
+		pstrEnt = NULL;
+	if (pstrEnt != NULL) {
+		s32Error = join_ent_copy(&priv->strJoinPending, pstrEnt);
+		priv->bJoinFromCache = WILC_TRUE;
+		if (s32Error == WILC_SUCCESS)
+			astrJoinStats[JOIN_VIA_CACHE].u32Attempts++;
+	}
+	mutex_unlock(&join_cache_lock);
+
+	return s32Error;
+}
+
+/*
+ * The pending join is not in the scan shadow, so cfg80211 may have lost its
+ * BSS too. Inform it again from the cached beacon before reporting the
+ * connection.
+ */
+static void join_pending_inform(struct WILC_WFI_priv *priv)
+{
+	struct wiphy *wiphy = priv->dev->ieee80211_ptr->wiphy;
+	struct wilc_join_cache_ent *pstrEnt = &priv->strJoinPending;
+	struct ieee80211_channel *channel;
+	struct cfg80211_bss *bss;
+	WILC_Sint32 s32Freq;
+
+	if (!pstrEnt->bValid || pstrEnt->pu8IEs == NULL)
+		return;
+
+	#if LINUX_VERSION_CODE > KERNEL_VERSION(2,6,38)
+	s32Freq = ieee80211_channel_to_frequency((WILC_Sint32)pstrEnt->u8channel, IEEE80211_BAND_2GHZ);
+	#else
+	s32Freq = ieee80211_channel_to_frequency((WILC_Sint32)pstrEnt->u8channel);
+	#endif
+	channel = ieee80211_get_channel(wiphy, s32Freq);
+	if (channel == NULL)
+		return;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 18, 0)
+	bss = cfg80211_inform_bss(wiphy, channel, CFG80211_BSS_FTYPE_UNKNOWN, pstrEnt->au8bssid, 0, pstrEnt->u16CapInfo,
+				  pstrEnt->u16BeaconPeriod, (const u8 *)pstrEnt->pu8IEs,
+				  (size_t)pstrEnt->u16IEsLen, (((WILC_Sint32)pstrEnt->s8rssi) * 100), GFP_KERNEL);
+#else
+	bss = cfg80211_inform_bss(wiphy, channel, pstrEnt->au8bssid, 0, pstrEnt->u16CapInfo,
+				  pstrEnt->u16BeaconPeriod, (const u8 *)pstrEnt->pu8IEs,
+				  (size_t)pstrEnt->u16IEsLen, (((WILC_Sint32)pstrEnt->s8rssi) * 100), GFP_KERNEL);
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 9, 0)
+	cfg80211_put_bss(wiphy, bss);
+#else
+	cfg80211_put_bss(bss);
+#endif
+}
+
+/*
+ * Active scan of the one channel a cached join failed on. The results go to
+ * the shadow and cfg80211 through CfgScanResult() like a user scan's do.
+ */
+static void join_cache_probe(struct WILC_WFI_priv *priv, const WILC_Uint8 *pu8ssid,
+			     WILC_Uint8 u8SsidLen, WILC_Uint8 u8channel)
+{
+	struct tstrHiddenNetwork strHiddenNetwork;
+	struct tstrHiddenNetworkInfo *pstrInfo;
+	WILC_Sint32 s32Error;
+
+	WILC_SemaphoreAcquire(&(priv->hSemScanReq), NULL);
+	if (priv->bCfgScanning) {
+		WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
+		return;
+	}
+
+	/* Handle_Scan() frees the list, keep the SSID in the same block */
+	pstrInfo = WILC_MALLOC(sizeof(*pstrInfo) + u8SsidLen);
+	if (pstrInfo == NULL) {
+		WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
+		return;
+	}
+	pstrInfo->pu8ssid = (WILC_Uint8 *)(pstrInfo + 1);
+	pstrInfo->u8ssidlen = u8SsidLen;
+	WILC_memcpy(pstrInfo->pu8ssid, pu8ssid, u8SsidLen);
+	strHiddenNetwork.pstrHiddenNetworkInfo = pstrInfo;
+	strHiddenNetwork.u8ssidnum = 1;
+
+	priv->u32RcvdChCount = 0;
+	priv->bCfgScanning = WILC_TRUE;
+	priv->bJoinProbe = WILC_TRUE;
+	WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
+
+	PRINT_D(CFG80211_DBG, "Probing channel %d for %s\n", u8channel, pu8ssid);
+	s32Error = host_int_scan(priv->hWILCWFIDrv, USER_SCAN, ACTIVE_SCAN,
+				 &u8channel, 1, NULL, 0, CfgScanResult, (void *)priv,
+				 &strHiddenNetwork);
+	if (s32Error != WILC_SUCCESS) {
+		WILC_FREE(pstrInfo);
+		WILC_SemaphoreAcquire(&(priv->hSemScanReq), NULL);
+		priv->bCfgScanning = WILC_FALSE;
+		priv->bJoinProbe = WILC_FALSE;
+		WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
+	}
+}
+
+/*
+ * Account for the time to connect and either commit the pending join to the
+ * cache or, if a cached join failed, drop that entry and probe its channel.
+ */
+static void join_pending_done(struct WILC_WFI_priv *priv, WILC_Bool bSuccess)
+{
+	struct wilc_join_cache_ent *pstrPending = &priv->strJoinPending;
+	struct wilc_join_cache_ent *pstrSlot = NULL;
+	struct wilc_join_stats *pstrStats;
+	WILC_Uint32 u32Ms;
+	int i;
+
+	mutex_lock(&join_cache_lock);
+	if (!pstrPending->bValid) {
+		mutex_unlock(&join_cache_lock);
+		return;
+	}
+
+	u32Ms = jiffies_to_msecs(jiffies - priv->u32JoinStart);
+	pstrStats = &astrJoinStats[priv->bJoinFromCache ? JOIN_VIA_CACHE : JOIN_VIA_SCAN];
+	if (bSuccess) {
+		pstrStats->u32Success++;
+		pstrStats->u32TotalMs += u32Ms;
+		pstrStats->u32LastMs = u32Ms;
+		if (u32Ms > pstrStats->u32MaxMs)
+			pstrStats->u32MaxMs = u32Ms;
+	} else {
+		pstrStats->u32Failed++;
+	}
+
+	for (i = 0; i < WILC_JOIN_CACHE_SIZE; i++) {
+		struct wilc_join_cache_ent *pstrEnt = &astrJoinCache[i];
+
+		if (pstrEnt->bValid &&
+		    WILC_memcmp(pstrEnt->au8bssid, pstrPending->au8bssid, ETH_ALEN) == 0) {
+			pstrSlot = pstrEnt;
+			break;
+		}
+	}
+
+	if (!bSuccess) {
+		WILC_Bool bProbe = priv->bJoinFromCache;
+		WILC_Uint8 au8ssid[MAX_SSID_LEN + 1];
+		WILC_Uint8 u8SsidLen = pstrPending->u8SsidLen;
+		WILC_Uint8 u8channel = pstrPending->u8channel;
+
+		if (priv->bJoinFromCache && pstrSlot != NULL) {
+			PRINT_D(CFG80211_DBG, "Cached join to %pM failed, dropping it\n", pstrSlot->au8bssid);
+			join_ent_free(pstrSlot);
+		}
+		WILC_memcpy(au8ssid, pstrPending->au8ssid, MAX_SSID_LEN);
+		au8ssid[MAX_SSID_LEN] = 0;
+		join_ent_free(pstrPending);
+		mutex_unlock(&join_cache_lock);
+
+		if (bProbe)
+			join_cache_probe(priv, au8ssid, u8SsidLen, u8channel);
+		return;
+	}
+
+	/* reuse the entry for this BSS, else a free one, else the oldest */
+	for (i = 0; pstrSlot == NULL && i < WILC_JOIN_CACHE_SIZE; i++) {
+		if (!astrJoinCache[i].bValid)
+			pstrSlot = &astrJoinCache[i];
+	}
+	if (pstrSlot == NULL) {
+		pstrSlot = &astrJoinCache[0];
+		for (i = 1; i < WILC_JOIN_CACHE_SIZE; i++) {
+			if (time_before(astrJoinCache[i].u32Stamp, pstrSlot->u32Stamp))
+				pstrSlot = &astrJoinCache[i];
+		}
+	}
+
+	join_ent_free(pstrSlot);
+	*pstrSlot = *pstrPending;
+	pstrSlot->u32Stamp = jiffies;
+	WILC_memset(pstrPending, 0, sizeof(*pstrPending));
+	mutex_unlock(&join_cache_lock);
+}
+
+/* Drop a join that never made it to the firmware */
+static void join_pending_abort(struct WILC_WFI_priv *priv)
+{
+	mutex_lock(&join_cache_lock);
+	if (priv->strJoinPending.bValid)
+		astrJoinStats[priv->bJoinFromCache ? JOIN_VIA_CACHE : JOIN_VIA_SCAN].u32Failed++;
+	join_ent_free(&priv->strJoinPending);
+	mutex_unlock(&join_cache_lock);
+}
+
+void WILC_WFI_join_cache_flush(void)
+{
+	int i;
+
+	mutex_lock(&join_cache_lock);
+	for (i = 0; i < WILC_JOIN_CACHE_SIZE; i++)
+		join_ent_free(&astrJoinCache[i]);
+	mutex_unlock(&join_cache_lock);
+}
+
+int WILC_WFI_join_stats_print(char *buf, int size)
+{
+	static const char *const apcVia[JOIN_VIA_MAX] = { "scan", "cache" };
+	int res = 0;
+	int i;
+
+	mutex_lock(&join_cache_lock);
+	for (i = 0; i < JOIN_VIA_MAX; i++) {
+		struct wilc_join_stats *pstrStats = &astrJoinStats[i];
+
+		res += scnprintf(buf + res, size - res,
+				 "%s: attempts: %u ok: %u failed: %u connect avg: %u ms last: %u ms max: %u ms\n",
+				 apcVia[i], pstrStats->u32Attempts, pstrStats->u32Success, pstrStats->u32Failed,
+				 pstrStats->u32Success ? pstrStats->u32TotalMs / pstrStats->u32Success : 0,
+				 pstrStats->u32LastMs, pstrStats->u32MaxMs);
+	}
+	res += scnprintf(buf + res, size - res, "cached:");
+	for (i = 0; i < WILC_JOIN_CACHE_SIZE; i++) {
+		if (astrJoinCache[i].bValid)
+			res += scnprintf(buf + res, size - res, " %pM/%u",
+					 astrJoinCache[i].au8bssid, astrJoinCache[i].u8channel);
+	}
+	res += scnprintf(buf + res, size - res, "\n");
+	mutex_unlock(&join_cache_lock);
+
+	return res;
+}
+
+void WILC_WFI_join_stats_reset(void)
+{
+	mutex_lock(&join_cache_lock);
+	WILC_memset(astrJoinStats, 0, sizeof(astrJoinStats));
+	mutex_unlock(&join_cache_lock);
+}
+
+
 
 /**
 *  @brief 	CfgConnectResult
@@ -696,10 +1189,13 @@ static void CfgConnectResult(enum tenuConnDisconnEvent enuConnDisconnEvent,
 				//RefreshScanResult(priv);
 				/*BugID_5418*/
 				/*Also, refrsh DIRECT- results if */
-				refresh_scan(priv, 1,WILC_TRUE);
+				refresh_scan(priv, 1,WILC_TRUE,WILC_TRUE);
 
 			}
 
+			/* joined from the join cache, cfg80211 may no longer know this BSS */
+			if(priv->bJoinFromCache && i == u32LastScannedNtwrksCountShadow)
+				join_pending_inform(priv);
 		}
 
 
@@ -712,6 +1208,11 @@ static void CfgConnectResult(enum tenuConnDisconnEvent enuConnDisconnEvent,
 								pstrConnectInfo->pu8RespIEs, pstrConnectInfo->u16RespIEsLen,
 								u16ConnectStatus, GFP_KERNEL); //TODO: mostafa: u16ConnectStatus to
 															   // be replaced by pstrConnectInfo->u16ConnectStatus
+
+		join_pending_done(priv, u16ConnectStatus == WLAN_STATUS_SUCCESS);
+
+		/* the supplicant knows about the connection, hand it the held EAPOL frames */
+		linux_wlan_eapol_flush(priv, u16ConnectStatus == WLAN_STATUS_SUCCESS);
 	}
 	else if(enuConnDisconnEvent == CONN_DISCONN_EVENT_DISCONN_NOTIF)
 	{
@@ -724,6 +1225,7 @@ static void CfgConnectResult(enum tenuConnDisconnEvent enuConnDisconnEvent,
 		u8P2Precvrandom=0x00;
 		bWilc_ie = WILC_FALSE;
 		WILC_memset(priv->au8AssociatedBss, 0, ETH_ALEN);
+		linux_wlan_eapol_flush(priv, WILC_FALSE);
 		linux_wlan_set_bssid(priv->dev,NullBssid,STATION_MODE);
 		WILC_memset(u8ConnectedSSID,0,ETH_ALEN);
 
@@ -876,6 +1378,14 @@ static int WILC_WFI_CfgScan(struct wiphy *wiphy,struct net_device *dev, struct c
 	}
 #endif
 #endif // end of if 0
+	/* the join probe may be running, it starts from the host IF thread */
+	WILC_SemaphoreAcquire(&(priv->hSemScanReq), NULL);
+	if(priv->bCfgScanning || priv->bJoinProbe)
+	{
+		WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
+		return -EBUSY;
+	}
+
 	priv->pstrScanReq = request;
 
 	priv->u32RcvdChCount = 0;
@@ -886,6 +1396,7 @@ static int WILC_WFI_CfgScan(struct wiphy *wiphy,struct net_device *dev, struct c
 	reset_shadow_found(priv);
 
 	priv->bCfgScanning = WILC_TRUE;
+	WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
 	if(request->n_channels <= MAX_NUM_SCANNED_NETWORKS) //TODO: mostafa: to be replaced by
 														//               max_scan_ssids
 	{
@@ -944,10 +1455,17 @@ static int WILC_WFI_CfgScan(struct wiphy *wiphy,struct net_device *dev, struct c
 	{
 		PRINT_ER("Requested num of scanned channels is greater than the max, supported"
 				  " channels \n");
+		s32Error = WILC_FAIL;
 	}
 
 	if(s32Error != WILC_SUCCESS)
 	{
+		/* no scan done event will come, don't lock out the next scan */
+		WILC_SemaphoreAcquire(&(priv->hSemScanReq), NULL);
+		priv->pstrScanReq = WILC_NULL;
+		priv->bCfgScanning = WILC_FALSE;
+		WILC_SemaphoreRelease(&(priv->hSemScanReq), NULL);
+
 		s32Error = -EBUSY;
 		PRINT_ER(CFG80211_DBG,"Device is busy: Error(%d)\n",s32Error);
 	}
@@ -988,6 +1506,7 @@ static int WILC_WFI_CfgConnect(struct wiphy *wiphy, struct net_device *dev,
 	connecting = 1;
 	priv = wiphy_priv(wiphy);
 	pstrWFIDrv = (struct WILC_WFIDrv *)(priv->hWILCWFIDrv);
+	priv->u32JoinStart = jiffies;
 
 
 	PRINT_D(CFG80211_DBG,"Connecting to SSID [%s] on netdev [%p] host if [%x]\n",sme->ssid,dev, (WILC_Uint32)priv->hWILCWFIDrv);
@@ -1060,6 +1579,21 @@ static int WILC_WFI_CfgConnect(struct wiphy *wiphy, struct net_device *dev,
 						pstrNetworkInfo->au8bssid[0], pstrNetworkInfo->au8bssid[1],
 						pstrNetworkInfo->au8bssid[2], pstrNetworkInfo->au8bssid[3],
 						pstrNetworkInfo->au8bssid[4], pstrNetworkInfo->au8bssid[5]);
+
+		s32Error = join_pending_from_shadow(priv, pstrNetworkInfo);
+		if(s32Error != WILC_SUCCESS)
+		{
+			PRINT_ER("Failed to save join parameters: Error(%d)\n",s32Error);
+			goto done;
+		}
+	}
+	else if(join_pending_from_cache(priv, sme) == WILC_SUCCESS)
+	{
+		PRINT_D(CFG80211_DBG, "Required bss not in scan results, joining %pM on channel %d from the join cache\n",
+			priv->strJoinPending.au8bssid, priv->strJoinPending.u8channel);
+
+		/* re-arm the firmware with the PMKID we hold for this BSS, if any */
+		WILC_WFI_Set_PMKSA(priv->strJoinPending.au8bssid, priv);
 	}
 	else
 	{
@@ -1242,26 +1776,27 @@ static int WILC_WFI_CfgConnect(struct wiphy *wiphy, struct net_device *dev,
 	}
 
 
-	PRINT_INFO(CFG80211_DBG, "Required Channel = %d\n", pstrNetworkInfo->u8channel);
+	PRINT_INFO(CFG80211_DBG, "Required Channel = %d\n", priv->strJoinPending.u8channel);
 
 	PRINT_INFO(CFG80211_DBG, "Group encryption value = %s\n Cipher Group = %s\n WPA version = %s\n",
 							      pcgroup_encrypt_val, pccipher_group,pcwpa_version);
 
 	/*BugID_5442*/
-	u8CurrChannel = pstrNetworkInfo->u8channel;
+	u8CurrChannel = priv->strJoinPending.u8channel;
 
 	if(!pstrWFIDrv->u8P2PConnect)
 	{
-		u8WLANChannel = pstrNetworkInfo->u8channel;
+		u8WLANChannel = priv->strJoinPending.u8channel;
 	}
 
-	linux_wlan_set_bssid(dev,pstrNetworkInfo->au8bssid,STATION_MODE);
+	linux_wlan_set_bssid(dev,priv->strJoinPending.au8bssid,STATION_MODE);
 
-	s32Error = host_int_set_join_req(priv->hWILCWFIDrv, pstrNetworkInfo->au8bssid, sme->ssid,
+	/* join with our own copy, the shadow entry may age out under us */
+	s32Error = host_int_set_join_req(priv->hWILCWFIDrv, priv->strJoinPending.au8bssid, sme->ssid,
 							  	    sme->ssid_len, sme->ie, sme->ie_len,
 							  	    CfgConnectResult, (void*)priv, u8security,
-							  	    tenuAuth_type, pstrNetworkInfo->u8channel,
-							  	    pstrNetworkInfo->pJoinParams);
+							  	    tenuAuth_type, priv->strJoinPending.u8channel,
+							  	    priv->strJoinPending.pJoinParams);
 	if(s32Error != WILC_SUCCESS)
 	{
 		PRINT_ER("host_int_set_join_req(): Error(%d) \n", s32Error);
@@ -1275,6 +1810,7 @@ done:
 		PRINT_ER("%s(): Error(%d) \n",__FUNCTION__,s32Error);
 		s32Error = -ENOENT;
 		connecting = 0;
+		join_pending_abort(priv);
 	}
 	
 	return s32Error;
@@ -1916,6 +2452,153 @@ static int WILC_WFI_dump_survey(struct wiphy *wiphy, struct net_device *netdev,
 *  @version	1.0
 */
 
+/*
+ * Station table of the AP/GO interface. The data path looks stations up by
+ * mac, dump_station walks the slots, so neither needs the firmware.
+ * All of it is under assoc_stainfo.lock.
+ */
+static inline WILC_Uint32 wilc_sta_hash(const u8 *mac)
+{
+	return (mac[4] ^ mac[5]) & (WILC_STA_HASH_SIZE - 1);
+}
+
+static struct wilc_sta_entry *wilc_sta_find(struct sta_info *pstrStaInfo, const u8 *mac)
+{
+	struct wilc_sta_entry *pstrSta;
+
+	for (pstrSta = pstrStaInfo->apstrStaHash[wilc_sta_hash(mac)]; pstrSta != NULL;
+	     pstrSta = pstrSta->pstrNext) {
+		if (!memcmp(pstrSta->mac, mac, ETH_ALEN))
+			return pstrSta;
+	}
+
+	return NULL;
+}
+
+static void wilc_sta_add(struct WILC_WFI_priv *priv, const u8 *mac, u16 aid)
+{
+	struct sta_info *pstrStaInfo = &priv->assoc_stainfo;
+	struct wilc_sta_entry *pstrSta;
+	unsigned long flags;
+	WILC_Uint32 i, u32Hash;
+
+	spin_lock_irqsave(&pstrStaInfo->lock, flags);
+	pstrSta = wilc_sta_find(pstrStaInfo, mac);
+	if (pstrSta == NULL) {
+		for (i = 0; i < MAX_NUM_STA; i++) {
+			if (!pstrStaInfo->astrSta[i].valid) {
+				pstrSta = &pstrStaInfo->astrSta[i];
+				break;
+			}
+		}
+		if (pstrSta == NULL) {
+			spin_unlock_irqrestore(&pstrStaInfo->lock, flags);
+			PRINT_ER("Station table full\n");
+			return;
+		}
+
+		memcpy(pstrSta->mac, mac, ETH_ALEN);
+		pstrSta->valid = WILC_TRUE;
+		u32Hash = wilc_sta_hash(mac);
+		pstrSta->pstrNext = pstrStaInfo->apstrStaHash[u32Hash];
+		pstrStaInfo->apstrStaHash[u32Hash] = pstrSta;
+	}
+
+	/* a reassociating station starts over */
+	pstrSta->aid = aid;
+	pstrSta->rx_packets = 0;
+	pstrSta->tx_packets = 0;
+	pstrSta->rx_bytes = 0;
+	pstrSta->tx_bytes = 0;
+	pstrSta->connected = jiffies;
+	pstrSta->last_seen = pstrSta->connected;
+	spin_unlock_irqrestore(&pstrStaInfo->lock, flags);
+}
+
+/* mac NULL removes all of them */
+static void wilc_sta_del(struct WILC_WFI_priv *priv, const u8 *mac)
+{
+	struct sta_info *pstrStaInfo = &priv->assoc_stainfo;
+	struct wilc_sta_entry **ppstrSta;
+	unsigned long flags;
+	WILC_Uint32 i, u32Last;
+
+	i = (mac != NULL) ? wilc_sta_hash(mac) : 0;
+	u32Last = (mac != NULL) ? i : WILC_STA_HASH_SIZE - 1;
+
+	spin_lock_irqsave(&pstrStaInfo->lock, flags);
+	for (; i <= u32Last; i++) {
+		ppstrSta = &pstrStaInfo->apstrStaHash[i];
+		while (*ppstrSta != NULL) {
+			if (mac == NULL || !memcmp((*ppstrSta)->mac, mac, ETH_ALEN)) {
+				(*ppstrSta)->valid = WILC_FALSE;
+				*ppstrSta = (*ppstrSta)->pstrNext;
+			} else {
+				ppstrSta = &(*ppstrSta)->pstrNext;
+			}
+		}
+	}
+	spin_unlock_irqrestore(&pstrStaInfo->lock, flags);
+}
+
+/*
+ * Copies the station with this mac, or the idx-th one when mac is NULL
+ */
+static int wilc_sta_snapshot(struct WILC_WFI_priv *priv, const u8 *mac, int idx,
+			     struct wilc_sta_entry *pstrOut)
+{
+	struct sta_info *pstrStaInfo = &priv->assoc_stainfo;
+	struct wilc_sta_entry *pstrSta = NULL;
+	unsigned long flags;
+	WILC_Uint32 i;
+
+	spin_lock_irqsave(&pstrStaInfo->lock, flags);
+	if (mac != NULL) {
+		pstrSta = wilc_sta_find(pstrStaInfo, mac);
+	} else {
+		for (i = 0; i < MAX_NUM_STA; i++) {
+			if (pstrStaInfo->astrSta[i].valid && idx-- == 0) {
+				pstrSta = &pstrStaInfo->astrSta[i];
+				break;
+			}
+		}
+	}
+	if (pstrSta != NULL)
+		memcpy(pstrOut, pstrSta, sizeof(struct wilc_sta_entry));
+	spin_unlock_irqrestore(&pstrStaInfo->lock, flags);
+
+	return (pstrSta != NULL) ? 0 : -ENOENT;
+}
+
+static void wilc_sta_fill(struct wilc_sta_entry *pstrSta, struct station_info *sinfo)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 19, 0)
+	sinfo->filled |= BIT(NL80211_STA_INFO_INACTIVE_TIME) |
+			 BIT(NL80211_STA_INFO_CONNECTED_TIME) |
+			 BIT(NL80211_STA_INFO_RX_PACKETS) |
+			 BIT(NL80211_STA_INFO_TX_PACKETS) |
+			 BIT(NL80211_STA_INFO_RX_BYTES) |
+			 BIT(NL80211_STA_INFO_TX_BYTES);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3, 0, 0)
+	sinfo->filled |= STATION_INFO_INACTIVE_TIME | STATION_INFO_CONNECTED_TIME
+		| STATION_INFO_RX_PACKETS | STATION_INFO_TX_PACKETS
+		| STATION_INFO_RX_BYTES | STATION_INFO_TX_BYTES;
+#else
+	sinfo->filled |= STATION_INFO_INACTIVE_TIME
+		| STATION_INFO_RX_PACKETS | STATION_INFO_TX_PACKETS
+		| STATION_INFO_RX_BYTES | STATION_INFO_TX_BYTES;
+#endif
+
+	sinfo->inactive_time = jiffies_to_msecs(jiffies - pstrSta->last_seen);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 0, 0)
+	sinfo->connected_time = jiffies_to_msecs(jiffies - pstrSta->connected) / 1000;
+#endif
+	sinfo->rx_packets = pstrSta->rx_packets;
+	sinfo->tx_packets = pstrSta->tx_packets;
+	sinfo->rx_bytes = pstrSta->rx_bytes;
+	sinfo->tx_bytes = pstrSta->tx_bytes;
+}
+
 extern  uint32_t Statisitcs_totalAcks,Statisitcs_DroppedAcks;
 static int WILC_WFI_get_station(struct wiphy *wiphy, struct net_device *dev,
 	u8 *mac, struct station_info *sinfo)
@@ -1924,9 +2607,7 @@ static int WILC_WFI_get_station(struct wiphy *wiphy, struct net_device *dev,
 	struct WILC_WFI_priv* priv;
 	perInterface_wlan_t* nic;
 	#ifdef WILC_AP_EXTERNAL_MLME
-	WILC_Uint32 i =0;
-	WILC_Uint32 associatedsta = 0;
-	WILC_Uint32 inactive_time=0;
+	struct wilc_sta_entry strSta;
 	#endif
 	priv = wiphy_priv(wiphy);
 	nic = netdev_priv(dev);
@@ -1938,33 +2619,16 @@ static int WILC_WFI_get_station(struct wiphy *wiphy, struct net_device *dev,
 
 		PRINT_INFO(HOSTAPD_DBG, ": %x%x%x%x%x\n",mac[0],mac[1],mac[2],mac[3],mac[4]);
 
-		for(i=0; i<NUM_STA_ASSOCIATED; i++)
-		{
-
-			if (!(memcmp(mac, priv->assoc_stainfo.au8Sta_AssociatedBss[i], ETH_ALEN)))
-			{
-			   associatedsta = i;
-			   break;
-			}
-
-		}
-
-		if(associatedsta == -1)
+		/* host side counters, inactive time comes from the RX path */
+		s32Error = wilc_sta_snapshot(priv, mac, 0, &strSta);
+		if(s32Error)
 		{
-			s32Error = -ENOENT;
 			PRINT_ER("Station required is not associated : Error(%d)\n",s32Error);
 
 			return s32Error;
 		}
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 19, 0)	//0421
-		sinfo->filled |= BIT(NL80211_STA_INFO_INACTIVE_TIME);
-#else
-		sinfo->filled |= STATION_INFO_INACTIVE_TIME;
-#endif
-
-		host_int_get_inactive_time(priv->hWILCWFIDrv, mac,&(inactive_time));
-		sinfo->inactive_time = 1000 * inactive_time;
+		wilc_sta_fill(&strSta, sinfo);
 		PRINT_D(CFG80211_DBG,"Inactive time %d\n",sinfo->inactive_time);
 
 	}
@@ -1973,7 +2637,12 @@ static int WILC_WFI_get_station(struct wiphy *wiphy, struct net_device *dev,
 	if(nic->iftype == STATION_MODE)
 	{
 		struct tstrStatistics strStatistics;
-		host_int_get_statistics(priv->hWILCWFIDrv,&strStatistics);
+		unsigned int u32AgeMs = 0;
+
+		/* served from the host interface cache, no firmware round trip */
+		s32Error = host_int_get_cached_statistics(priv->hWILCWFIDrv, &strStatistics, &u32AgeMs);
+		if (s32Error)
+			return (s32Error == -ENOENT) ? -ENOENT : -EBUSY;
 
 
 	#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 19, 0)	//0421
@@ -1981,15 +2650,21 @@ static int WILC_WFI_get_station(struct wiphy *wiphy, struct net_device *dev,
 						BIT( NL80211_STA_INFO_RX_PACKETS) |
 						BIT(NL80211_STA_INFO_TX_PACKETS) |
 						BIT(NL80211_STA_INFO_TX_FAILED) |
-						BIT(NL80211_STA_INFO_TX_BITRATE);
+						BIT(NL80211_STA_INFO_TX_BITRATE) |
+						BIT(NL80211_STA_INFO_RX_BYTES) |
+						BIT(NL80211_STA_INFO_TX_BYTES);
     #elif LINUX_VERSION_CODE >= KERNEL_VERSION(3, 0, 0)
 		sinfo->filled |= STATION_INFO_SIGNAL | STATION_INFO_RX_PACKETS | STATION_INFO_TX_PACKETS
-			| STATION_INFO_TX_FAILED | STATION_INFO_TX_BITRATE;
+			| STATION_INFO_TX_FAILED | STATION_INFO_TX_BITRATE
+			| STATION_INFO_RX_BYTES | STATION_INFO_TX_BYTES;
     #else
         sinfo->filled |= STATION_INFO_SIGNAL | STATION_INFO_RX_PACKETS | STATION_INFO_TX_PACKETS
-            | STATION_INFO_TX_BITRATE;
+            | STATION_INFO_TX_BITRATE | STATION_INFO_RX_BYTES | STATION_INFO_TX_BYTES;
     #endif
 
+		/* the firmware doesn't count bytes, take the host counters */
+		sinfo->rx_bytes		=  nic->netstats.rx_bytes;
+		sinfo->tx_bytes		=  nic->netstats.tx_bytes;
 		sinfo->signal  		=  strStatistics.s8RSSI;
 		sinfo->rx_packets   =  strStatistics.u32RxCount;
 		sinfo->tx_packets   =  strStatistics.u32TxCount + strStatistics.u32TxFailureCount;
@@ -2010,11 +2685,11 @@ static int WILC_WFI_get_station(struct wiphy *wiphy, struct net_device *dev,
 #endif
 
     #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,0,0)
-		PRINT_D(CORECONFIG_DBG, "*** stats[%d][%d][%d][%d][%d]\n",sinfo->signal,sinfo->rx_packets,sinfo->tx_packets,
-			sinfo->tx_failed,sinfo->txrate.legacy);
+		PRINT_D(CORECONFIG_DBG, "*** stats[%d][%d][%d][%d][%d] age %u ms\n",sinfo->signal,sinfo->rx_packets,sinfo->tx_packets,
+			sinfo->tx_failed,sinfo->txrate.legacy,u32AgeMs);
     #else
-        PRINT_D(CORECONFIG_DBG, "*** stats[%d][%d][%d][%d]\n",sinfo->signal,sinfo->rx_packets,sinfo->tx_packets,
-            sinfo->txrate.legacy);
+        PRINT_D(CORECONFIG_DBG, "*** stats[%d][%d][%d][%d] age %u ms\n",sinfo->signal,sinfo->rx_packets,sinfo->tx_packets,
+            sinfo->txrate.legacy,u32AgeMs);
     #endif
 	}
 	return s32Error;
@@ -3355,13 +4030,34 @@ static int WILC_WFI_dump_station(struct wiphy *wiphy, struct net_device *dev,
 	int idx, u8 *mac, struct station_info *sinfo)
 {
 	struct WILC_WFI_priv* priv;
+	perInterface_wlan_t* nic;
+	struct wilc_sta_entry strSta;
 	PRINT_D(CFG80211_DBG, "Dumping station information\n");
 
+	 priv = wiphy_priv(wiphy);
+	//priv = netdev_priv(priv->wdev->netdev);
+	nic = netdev_priv(dev);
+
+	/* every associated client, idx counts the used slots */
+	if(nic->iftype == AP_MODE || nic->iftype == GO_MODE)
+	{
+		if (wilc_sta_snapshot(priv, NULL, idx, &strSta))
+			return -ENOENT;
+
+		WILC_memcpy(mac, strSta.mac, ETH_ALEN);
+		wilc_sta_fill(&strSta, sinfo);
+		return 0;
+	}
+
 	if (idx != 0)
 		return -ENOENT;
 
-	 priv = wiphy_priv(wiphy);
-	//priv = netdev_priv(priv->wdev->netdev);
+	/* same cached snapshot as get_station for the AP we're connected to */
+	if(nic->iftype == STATION_MODE)
+	{
+		WILC_memcpy(mac, priv->au8AssociatedBss, ETH_ALEN);
+		return WILC_WFI_get_station(wiphy, dev, mac, sinfo);
+	}
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 19, 0))	//0421
 	sinfo->filled |= BIT(NL80211_STA_INFO_SIGNAL);
@@ -3489,6 +4185,8 @@ static int WILC_WFI_change_virt_intf(struct wiphy *wiphy,struct net_device *dev,
 			host_int_set_operation_mode(priv->hWILCWFIDrv,STATION_MODE);
 			/*Remove the enteries of the previously connected clients*/
 			memset(priv->assoc_stainfo.au8Sta_AssociatedBss, 0, MAX_NUM_STA * ETH_ALEN);
+			wilc_sta_del(priv, NULL);
+			linux_wlan_eapol_flush(priv, WILC_FALSE);
 	
 			bEnablePS = WILC_TRUE;
 			host_int_set_power_mgmt(priv_1->hWILCWFIDrv, 1, 0);
@@ -3896,6 +4594,7 @@ static int  WILC_WFI_add_station(struct wiphy *wiphy, struct net_device *dev,
 		WILC_ERRORCHECK(s32Error);
 		#endif //WILC_FULLY_HOSTING_AP
 
+		wilc_sta_add(priv, mac, params->aid);
 	}
 
 	WILC_CATCH(s32Error)
@@ -3954,6 +4653,7 @@ static int WILC_WFI_del_station(struct wiphy *wiphy, struct net_device *dev,
 		WILC_AP_RemoveSta(mac);
 		#endif //WILC_FULLY_HOSTING_AP
 
+		wilc_sta_del(priv, mac);
 		WILC_ERRORCHECK(s32Error);
 	}
 	WILC_CATCH(s32Error)
@@ -4352,6 +5052,47 @@ int WILC_WFI_update_stats(struct wiphy *wiphy, u32 pktlen , u8 changed)
 #endif
 	return 0;
 }
+
+/**
+*  @brief 	WILC_WFI_update_sta_stats
+*  @details 	Count a data frame to or from a station of our AP/GO.
+*  @param[in]	mac of the station, pktlen, WILC_WFI_RX_PKT or WILC_WFI_TX_PKT
+*  @return 	int : Return 0 on Success, -ENOENT if it is not associated.
+*/
+int WILC_WFI_update_sta_stats(struct wiphy *wiphy, const u8 *mac, u32 pktlen, u8 changed)
+{
+	struct WILC_WFI_priv *priv;
+	struct wilc_sta_entry *pstrSta;
+	unsigned long flags;
+
+	priv = wiphy_priv(wiphy);
+
+	spin_lock_irqsave(&priv->assoc_stainfo.lock, flags);
+	pstrSta = wilc_sta_find(&priv->assoc_stainfo, mac);
+	if (pstrSta == NULL) {
+		spin_unlock_irqrestore(&priv->assoc_stainfo.lock, flags);
+		return -ENOENT;
+	}
+
+	switch (changed) {
+	case WILC_WFI_RX_PKT:
+		pstrSta->rx_packets++;
+		pstrSta->rx_bytes += pktlen;
+		pstrSta->last_seen = jiffies;
+		break;
+
+	case WILC_WFI_TX_PKT:
+		pstrSta->tx_packets++;
+		pstrSta->tx_bytes += pktlen;
+		break;
+
+	default:
+		break;
+	}
+	spin_unlock_irqrestore(&priv->assoc_stainfo.lock, flags);
+
+	return 0;
+}
 /**
 *  @brief 	WILC_WFI_InitPriv
 *  @details 	Initialization of the net device, private data
@@ -4463,6 +5204,8 @@ struct wireless_dev* WILC_WFI_WiphyRegister(struct net_device *net)
 	/*Return hardware description structure (wiphy)'s priv*/
 	priv = wdev_priv(wdev);
 	WILC_SemaphoreCreate(&(priv->SemHandleUpdateStats),NULL);
+	spin_lock_init(&priv->assoc_stainfo.lock);
+	skb_queue_head_init(&priv->strEAPQueue);
 
 	/*Link the wiphy with wireless structure*/
 	priv->wdev = wdev;
@@ -4591,10 +5334,6 @@ int WILC_WFI_InitHostInt(struct net_device *net)
 		#ifdef DISABLE_PWRSAVE_AND_SCAN_DURING_IP
 		s32Error = WILC_TimerCreate(&(hDuringIpTimer), clear_duringIP, WILC_NULL);
 		#endif
-
-		/*TicketId1001*/
-		/*Timer to handle eapol 1/4 buffering if needed*/
-		setup_timer(&(hEAPFrameBuffTimer), EAP_buff_timeout, 0);
 	}
 	op_ifcs++;
 	if(s32Error < 0){
@@ -4656,9 +5395,13 @@ int WILC_WFI_DeInitHostInt(struct net_device *net)
 	{
 		PRINT_D(CORECONFIG_DBG, "destroy during ip\n");
 		WILC_TimerDestroy(&hDuringIpTimer,WILC_NULL);
-		del_timer_sync(&hEAPFrameBuffTimer);
 	}
 	#endif
+	linux_wlan_eapol_flush(priv, WILC_FALSE);
+	join_pending_abort(priv);
+	/* an aborted probe may not have been reported, don't block the next scan */
+	priv->bJoinProbe = WILC_FALSE;
+	priv->bCfgScanning = WILC_FALSE;
 
 	if(s32Error)
 	{
@@ -4698,6 +5441,7 @@ void WILC_WFI_WiphyFree(struct net_device *net)
 		}
 
 	wiphy_unregister(net->ieee80211_ptr->wiphy);
+	WILC_WFI_join_cache_flush();
 
 	PRINT_D(INIT_DBG,"Freeing wiphy\n");
 	wiphy_free(net->ieee80211_ptr->wiphy);
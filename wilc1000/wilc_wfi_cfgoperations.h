@@ -9,8 +9,6 @@
 #ifndef NM_WFI_CFGOPERATIONS
 #define NM_WFI_CFGOPERATIONS
 #include "wilc_wfi_netdevice.h"
-
-extern struct timer_list hEAPFrameBuffTimer;
 #ifdef WILC_FULLY_HOSTING_AP
 #include "wilc_host_ap.h"
 #endif
@@ -120,7 +118,9 @@ wilc_wfi_cfg80211_mgmt_types[NL80211_IFTYPE_MAX] =
 struct wireless_dev* WILC_WFI_CfgAlloc(void);
 struct wireless_dev * WILC_WFI_WiphyRegister(struct net_device *net);
 void WILC_WFI_WiphyFree(struct net_device *net);
+void WILC_WFI_join_cache_flush(void);
 int WILC_WFI_update_stats(struct wiphy *wiphy, u32 pktlen , u8 changed);
+int WILC_WFI_update_sta_stats(struct wiphy *wiphy, const u8 *mac, u32 pktlen, u8 changed);
 int WILC_WFI_DeInitHostInt(struct net_device *net);
 int WILC_WFI_InitHostInt(struct net_device *net);
 void WILC_WFI_monitor_rx(uint8_t *buff, uint32_t size);
@@ -115,9 +115,29 @@ struct wilc_wfi_wep_key {
   u8  key_idx;
 };  
 
+#define WILC_STA_HASH_SIZE 16
+
+/* Host side counters of a station associated to our AP/GO */
+struct wilc_sta_entry
+{
+	struct wilc_sta_entry *pstrNext;	/* hash chain */
+	WILC_Bool valid;
+	WILC_Uint8 mac[ETH_ALEN];
+	WILC_Uint16 aid;
+	unsigned long rx_packets;
+	unsigned long tx_packets;
+	unsigned long rx_bytes;
+	unsigned long tx_bytes;
+	unsigned long last_seen;	/* jiffies of the last frame from it */
+	unsigned long connected;	/* jiffies when it was added */
+};
+
 struct sta_info
 {
 	WILC_Uint8 au8Sta_AssociatedBss[MAX_NUM_STA][ETH_ALEN];
+	struct wilc_sta_entry astrSta[MAX_NUM_STA];
+	struct wilc_sta_entry *apstrStaHash[WILC_STA_HASH_SIZE];	/* by mac */
+	spinlock_t lock;
 };
 
 #ifdef WILC_P2P
@@ -133,11 +153,23 @@ struct wilc_wfi_p2pListenParams
 
 #endif	/*WILC_P2P*/
 
-/* Struct to buffer eapol 1/4 frame */
-struct wilc_buffered_eap {
-	unsigned int u32Size;
-	unsigned int u32PktOffset;
-	u8 *pu8buff;
+/* EAPOL frames held until the connection is reported */
+#define WILC_EAPOL_QUEUE_LEN 4
+
+/* What is needed to join a BSS again without scanning for it first */
+struct wilc_join_cache_ent {
+	WILC_Bool bValid;
+	WILC_Uint8 au8ssid[MAX_SSID_LEN];
+	WILC_Uint8 u8SsidLen;
+	WILC_Uint8 au8bssid[ETH_ALEN];
+	WILC_Uint8 u8channel;
+	WILC_Uint16 u16CapInfo;
+	WILC_Uint16 u16BeaconPeriod;
+	WILC_Sint8 s8rssi;
+	WILC_Uint8 *pu8IEs;
+	WILC_Uint16 u16IEsLen;
+	void *pJoinParams;
+	unsigned long u32Stamp;
 };
 
 struct WILC_WFI_priv {
@@ -190,7 +222,15 @@ struct WILC_WFI_priv {
 	WILC_Bool gbAutoRateAdjusted;
 
 	WILC_Bool bInP2PlistenState;
-	struct wilc_buffered_eap *pStrBufferedEAP;
+	/* TicketId1001: EAPOL 1/4 can arrive before the connect result */
+	struct sk_buff_head strEAPQueue;
+	WILC_Bool bConnReported;
+	/* join in flight, moved to the join cache when it succeeds */
+	struct wilc_join_cache_ent strJoinPending;
+	WILC_Bool bJoinFromCache;
+	unsigned long u32JoinStart;
+	/* single channel probe after a failed cached join */
+	WILC_Bool bJoinProbe;
 };
 
 typedef struct
@@ -202,6 +242,7 @@ typedef struct
 
 
 #define NUM_CONCURRENT_IFC 2
+#define WILC_MC_BLOOM_BITS 512
 typedef struct{
 uint8_t aSrcAddress[ETH_ALEN];
 uint8_t aBSSID[ETH_ALEN];
@@ -239,12 +280,11 @@ typedef struct{
 	struct semaphore txq_event;
 	//struct completion txq_event;
 
-#if (RX_BH_TYPE == RX_BH_WORK_QUEUE)
-		struct work_struct rx_work_queue;
-#elif (RX_BH_TYPE == RX_BH_KTHREAD)
-		struct task_struct* rx_bh_thread;
-		struct semaphore rx_sem;
-#endif
+	int rx_bh_type;		/* RX_BH_* picked at init */
+	struct workqueue_struct *rx_bh_wq;
+	struct work_struct rx_work_queue;
+	struct task_struct* rx_bh_thread;
+	struct semaphore rx_sem;
 
 
 	
@@ -280,6 +320,9 @@ typedef struct
 	#endif
 struct net_device* wilc_netdev;
 struct net_device_stats netstats; 
+	/* software multicast filter, when the list doesn't fit the firmware table */
+	int mc_sw_filter;
+	unsigned long mc_bloom[WILC_MC_BLOOM_BITS / BITS_PER_LONG];
 
 }perInterface_wlan_t;
 
@@ -26,6 +26,14 @@ int sdio_xfer_cnt(void);
 uint32_t wilc_get_chipid(uint8_t update);
 WILC_Uint16 Set_machw_change_vir_if(WILC_Bool bValue);
 
+/* deliver RX bursts from the bottom half when nothing is queued ahead of them */
+static int rx_direct = 1;
+module_param(rx_direct, int, 0644);
+
+/* give up waking the chip after this long and fail the bus access */
+static int wake_timeout_ms = 1000;
+module_param(wake_timeout_ms, int, 0644);
+
 //static uint32_t vmm_table[WILC_VMM_TBL_SIZE];
 //static uint32_t vmm_table_rbk[WILC_VMM_TBL_SIZE];
 
@@ -112,6 +120,7 @@ typedef struct {
 	struct rxq_entry_t *rxq_head;
 	struct rxq_entry_t *rxq_tail;
 	int rxq_entries;
+	int rxq_inflight;	/* queued or still being delivered by the rxq thread */
 	void *rxq_wait;
 	int rxq_exit;
 
@@ -122,9 +131,9 @@ static wilc_wlan_dev_t g_wlan;
 
 void chip_allow_sleep(void);
 #ifdef WILC_OPTIMIZE_SLEEP_INT
-void chip_wakeup(void);
+int chip_wakeup(void);
 #else
-INLINE void chip_wakeup(void);
+INLINE int chip_wakeup(void);
 
 #endif
 /********************************************
@@ -153,13 +162,354 @@ static void wilc_debug(uint32_t flag, char *fmt, ...)
 	return;
 }
 
+#ifdef WILC_PKT_LATENCY
+/********************************************
+
+	Packet latency
+
+********************************************/
+/*
+ * Per access category log2(usec) histograms of:
+ * - TX queue wait: wilc_wlan_txq_add_net_pkt() until the firmware grants
+ *   the VMM entries,
+ * - TX total: wilc_wlan_txq_add_net_pkt() until hif_block_tx_ext() is done,
+ * - RX: wilc_handle_isr() until the frame was handed to netif_rx().
+ * TX stages are only updated from the txq thread and RX from the rx path,
+ * so no locking is needed.
+ */
+#define LAT_HIST_BINS	16
+
+enum {
+	LAT_TX_QUEUE = 0,
+	LAT_TX_TOTAL,
+	LAT_RX,
+	LAT_MAX
+};
+
+struct wilc_lat_stats {
+	uint32_t count;
+	uint32_t max;		/* usec */
+	uint64_t sum;		/* usec */
+	uint32_t hist[LAT_HIST_BINS];
+};
+
+static const char *lat_name[LAT_MAX] = {
+	[LAT_TX_QUEUE]	= "tx_queue",
+	[LAT_TX_TOTAL]	= "tx_total",
+	[LAT_RX]	= "rx",
+};
+static const char *lat_ac_name[NQUEUES] = { "VO", "VI", "BE", "BK" };
+static struct wilc_lat_stats lat_stats[LAT_MAX][NQUEUES];
+
+/* enqueue time and AC of the packets of the current VMM transaction */
+static ktime_t lat_tx_stamp[WILC_VMM_TBL_SIZE];
+static uint8_t lat_tx_ac[WILC_VMM_TBL_SIZE];
+static ktime_t lat_rx_stamp;
+
+static void wilc_lat_record(int stage, uint8_t ac, ktime_t start, ktime_t end)
+{
+	struct wilc_lat_stats *st;
+	uint32_t usec;
+	int bin;
+
+	if (ac >= NQUEUES)
+		return;
+	st = &lat_stats[stage][ac];
+	usec = (uint32_t)ktime_us_delta(end, start);
+
+	st->count++;
+	st->sum += usec;
+	if (usec > st->max)
+		st->max = usec;
+	bin = fls(usec);
+	if (bin >= LAT_HIST_BINS)
+		bin = LAT_HIST_BINS - 1;
+	st->hist[bin]++;
+}
+
+int wilc_wlan_lat_print(char *buf, int size)
+{
+	int res = 0;
+	int i, ac, j;
+
+	for (i = 0; i < LAT_MAX; i++) {
+		for (ac = 0; ac < NQUEUES; ac++) {
+			struct wilc_lat_stats *st = &lat_stats[i][ac];
+
+			res += scnprintf(buf + res, size - res,
+					 "%s %s: count %u avg %u us max %u us\n  hist:",
+					 lat_name[i], lat_ac_name[ac], st->count,
+					 st->count ? (uint32_t)div_u64(st->sum, st->count) : 0,
+					 st->max);
+			for (j = 0; j < LAT_HIST_BINS; j++)
+				res += scnprintf(buf + res, size - res, " %u", st->hist[j]);
+			res += scnprintf(buf + res, size - res, "\n");
+		}
+	}
+
+	return res;
+}
+
+void wilc_wlan_lat_reset(void)
+{
+	memset(lat_stats, 0, sizeof(lat_stats));
+}
+#endif /* WILC_PKT_LATENCY */
+
+#ifdef WILC_BUS_TRACE
+/********************************************
+
+	Bus trace
+
+********************************************/
+/*
+ * Ring of the last WILC_BUS_TRACE_LEN calls through g_wlan.hif_func.
+ * The real bus functions are kept in bus_trace_hif and g_wlan.hif_func
+ * points at the wrappers below, recording only costs a flag test until
+ * it is switched on through debugfs. Records are exported oldest first
+ * as a raw stream, tools/wilc_bustrace.c decodes it; keep the layout of
+ * wilc_bus_trace_rec_t in sync with it.
+ */
+#define WILC_BUS_TRACE_LEN	4096	/* power of 2 */
+
+enum {
+	BT_READ_REG = 1,
+	BT_WRITE_REG,
+	BT_BLOCK_RX,
+	BT_BLOCK_TX,
+	BT_SYNC,
+	BT_CLEAR_INT,
+	BT_READ_INT,
+	BT_CLEAR_INT_EXT,
+	BT_READ_SIZE,
+	BT_BLOCK_TX_EXT,
+	BT_BLOCK_RX_EXT,
+	BT_SYNC_EXT,
+	BT_MAX_SPEED,
+	BT_DEFAULT_SPEED,
+};
+
+typedef struct {
+	uint64_t start;		/* ns */
+	uint32_t dur;		/* ns */
+	uint32_t addr;		/* address, or the value for int/size ops */
+	uint32_t len;		/* bytes */
+	uint16_t op;
+	int16_t result;
+} wilc_bus_trace_rec_t;
+
+static wilc_hif_func_t bus_trace_hif;
+static wilc_bus_trace_rec_t bus_trace[WILC_BUS_TRACE_LEN];
+static atomic_t bus_trace_head = ATOMIC_INIT(0);
+static int bus_trace_on;
+
+static inline uint64_t bus_trace_begin(void)
+{
+	if (!bus_trace_on)
+		return 0;
+	return ktime_to_ns(ktime_get());
+}
+
+static void bus_trace_end(uint16_t op, uint32_t addr, uint32_t len, int ret, uint64_t start)
+{
+	wilc_bus_trace_rec_t *rec;
+
+	if (!bus_trace_on || !start)
+		return;
+
+	rec = &bus_trace[(atomic_inc_return(&bus_trace_head) - 1) & (WILC_BUS_TRACE_LEN - 1)];
+	rec->start = start;
+	rec->dur = (uint32_t)(ktime_to_ns(ktime_get()) - start);
+	rec->addr = addr;
+	rec->len = len;
+	rec->op = op;
+	rec->result = (int16_t)ret;
+}
+
+static int bt_read_reg(uint32_t addr, uint32_t *data)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_read_reg(addr, data);
+
+	bus_trace_end(BT_READ_REG, addr, 4, ret, t);
+	return ret;
+}
+
+static int bt_write_reg(uint32_t addr, uint32_t data)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_write_reg(addr, data);
+
+	bus_trace_end(BT_WRITE_REG, addr, 4, ret, t);
+	return ret;
+}
+
+static int bt_block_rx(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_block_rx(addr, buf, size);
+
+	bus_trace_end(BT_BLOCK_RX, addr, size, ret, t);
+	return ret;
+}
+
+static int bt_block_tx(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_block_tx(addr, buf, size);
+
+	bus_trace_end(BT_BLOCK_TX, addr, size, ret, t);
+	return ret;
+}
+
+static int bt_sync(void)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_sync();
+
+	bus_trace_end(BT_SYNC, 0, 0, ret, t);
+	return ret;
+}
+
+static int bt_clear_int(void)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_clear_int();
+
+	bus_trace_end(BT_CLEAR_INT, 0, 0, ret, t);
+	return ret;
+}
+
+static int bt_read_int(uint32_t *int_status)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_read_int(int_status);
+
+	bus_trace_end(BT_READ_INT, *int_status, 0, ret, t);
+	return ret;
+}
+
+static int bt_clear_int_ext(uint32_t val)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_clear_int_ext(val);
+
+	bus_trace_end(BT_CLEAR_INT_EXT, val, 0, ret, t);
+	return ret;
+}
+
+static int bt_read_size(uint32_t *size)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_read_size(size);
+
+	bus_trace_end(BT_READ_SIZE, *size, 0, ret, t);
+	return ret;
+}
+
+static int bt_block_tx_ext(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_block_tx_ext(addr, buf, size);
+
+	bus_trace_end(BT_BLOCK_TX_EXT, addr, size, ret, t);
+	return ret;
+}
+
+static int bt_block_rx_ext(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_block_rx_ext(addr, buf, size);
+
+	bus_trace_end(BT_BLOCK_RX_EXT, addr, size, ret, t);
+	return ret;
+}
+
+static int bt_sync_ext(int nint)
+{
+	uint64_t t = bus_trace_begin();
+	int ret = bus_trace_hif.hif_sync_ext(nint);
+
+	bus_trace_end(BT_SYNC_EXT, 0, nint, ret, t);
+	return ret;
+}
+
+static void bt_set_max_bus_speed(void)
+{
+	uint64_t t = bus_trace_begin();
+
+	bus_trace_hif.hif_set_max_bus_speed();
+	bus_trace_end(BT_MAX_SPEED, 0, 0, 1, t);
+}
+
+static void bt_set_default_bus_speed(void)
+{
+	uint64_t t = bus_trace_begin();
+
+	bus_trace_hif.hif_set_default_bus_speed();
+	bus_trace_end(BT_DEFAULT_SPEED, 0, 0, 1, t);
+}
+
+static void wilc_bus_trace_install(wilc_hif_func_t *hif)
+{
+	memcpy(&bus_trace_hif, hif, sizeof(wilc_hif_func_t));
+
+	hif->hif_read_reg = bt_read_reg;
+	hif->hif_write_reg = bt_write_reg;
+	hif->hif_block_rx = bt_block_rx;
+	hif->hif_block_tx = bt_block_tx;
+	hif->hif_sync = bt_sync;
+	hif->hif_clear_int = bt_clear_int;
+	hif->hif_read_int = bt_read_int;
+	hif->hif_clear_int_ext = bt_clear_int_ext;
+	hif->hif_read_size = bt_read_size;
+	hif->hif_block_tx_ext = bt_block_tx_ext;
+	hif->hif_block_rx_ext = bt_block_rx_ext;
+	hif->hif_sync_ext = bt_sync_ext;
+	if (hif->hif_set_max_bus_speed)
+		hif->hif_set_max_bus_speed = bt_set_max_bus_speed;
+	if (hif->hif_set_default_bus_speed)
+		hif->hif_set_default_bus_speed = bt_set_default_bus_speed;
+}
+
+/* starting the recorder drops whatever was recorded before */
+void wilc_bus_trace_enable(int on)
+{
+	if (on && !bus_trace_on)
+		atomic_set(&bus_trace_head, 0);
+	bus_trace_on = on;
+}
+
+/* copy the records oldest first, pos is the byte offset in that stream */
+int wilc_bus_trace_copy(char *buf, int size, loff_t pos)
+{
+	uint32_t head = atomic_read(&bus_trace_head);
+	uint32_t count, first, idx;
+	int res = 0;
+
+	count = (head < WILC_BUS_TRACE_LEN) ? head : WILC_BUS_TRACE_LEN;
+	first = head - count;
+	idx = (uint32_t)div_u64(pos, sizeof(wilc_bus_trace_rec_t));
+
+	while ((idx < count) && (res + (int)sizeof(wilc_bus_trace_rec_t) <= size)) {
+		memcpy(buf + res, &bus_trace[(first + idx) & (WILC_BUS_TRACE_LEN - 1)],
+		       sizeof(wilc_bus_trace_rec_t));
+		res += sizeof(wilc_bus_trace_rec_t);
+		idx++;
+	}
+
+	return res;
+}
+#endif /* WILC_BUS_TRACE */
+
 static CHIP_PS_STATE_T genuChipPSstate = CHIP_WAKEDUP;
 
 /*BugID_5213*/
 /*acquire_bus() and release_bus() are made INLINE functions*/
 /*as a temporary workaround to fix a problem of receiving*/
 /*unknown interrupt from FW*/
-INLINE void acquire_bus(BUS_ACQUIRE_T acquire)
+/* the bus lock is held on return, even when the chip didn't wake up */
+INLINE int acquire_bus(BUS_ACQUIRE_T acquire)
 {
 
 	g_wlan.os_func.os_enter_cs(g_wlan.hif_lock);
@@ -168,9 +518,10 @@ INLINE void acquire_bus(BUS_ACQUIRE_T acquire)
 	#endif
 		{
 			if(acquire == ACQUIRE_AND_WAKEUP)
-				chip_wakeup();
+				return chip_wakeup();
 		}
 
+	return 1;
 }
 INLINE void release_bus(BUS_RELEASE_T release)
 {
@@ -180,6 +531,210 @@ INLINE void release_bus(BUS_RELEASE_T release)
 	#endif
 	g_wlan.os_func.os_leave_cs(g_wlan.hif_lock);
 }
+
+#ifdef WILC_BUS_GOVERNOR
+/********************************************
+
+	Bus clock governor
+
+********************************************/
+/*
+ * Once the firmware runs the bus clock follows the load: it goes to the
+ * max clock after GOV_UP_HOLD periods above GOV_UP_BPS and back to the
+ * default clock after GOV_DOWN_HOLD periods below GOV_DOWN_BPS. Bus
+ * errors (CRC or response failures reported by the bus drivers) at the
+ * max clock fall back to the default one, which is then kept for
+ * GOV_ERR_BACKOFF periods. Everything but wilc_bus_gov_error() runs
+ * under the bus lock.
+ */
+#define GOV_PERIOD_MS	100
+#define GOV_UP_BPS	(1024 * 1024)		/* bytes per second */
+#define GOV_DOWN_BPS	(128 * 1024)
+#define GOV_UP_HOLD	2
+#define GOV_DOWN_HOLD	20
+#define GOV_ERR_MAX	3			/* per period */
+#define GOV_ERR_BACKOFF	100
+
+enum {
+	GOV_DEFAULT = 0,
+	GOV_MAX,
+	GOV_LEVELS
+};
+
+static struct {
+	int running;
+	int parked;		/* stopped for a system suspend */
+	int level;
+	int up_cnt;
+	int down_cnt;
+	int backoff;
+	uint32_t bytes;
+	atomic_t errors;
+	unsigned long since;	/* jiffies of the last time accounting */
+
+	uint64_t time_ms[GOV_LEVELS];
+	uint32_t ups;
+	uint32_t downs;
+	uint32_t err_fallbacks;
+	uint32_t total_errors;
+} bus_gov;
+static struct delayed_work bus_gov_work;
+
+static inline void wilc_bus_gov_account(uint32_t bytes)
+{
+	bus_gov.bytes += bytes;
+}
+
+void wilc_bus_gov_error(void)
+{
+	atomic_inc(&bus_gov.errors);
+}
+
+static void bus_gov_set(int level)
+{
+	unsigned long now = jiffies;
+
+	bus_gov.time_ms[bus_gov.level] += jiffies_to_msecs(now - bus_gov.since);
+	bus_gov.since = now;
+	if (level == bus_gov.level)
+		return;
+
+	if (level == GOV_MAX) {
+		g_wlan.hif_func.hif_set_max_bus_speed();
+		bus_gov.ups++;
+	} else {
+		g_wlan.hif_func.hif_set_default_bus_speed();
+		bus_gov.downs++;
+	}
+	bus_gov.level = level;
+	bus_gov.up_cnt = 0;
+	bus_gov.down_cnt = 0;
+}
+
+static void bus_gov_work_fn(struct work_struct *work)
+{
+	uint32_t bps, errors;
+	int level;
+
+	acquire_bus(ACQUIRE_ONLY);
+
+	bps = bus_gov.bytes * (1000 / GOV_PERIOD_MS);
+	bus_gov.bytes = 0;
+	errors = atomic_xchg(&bus_gov.errors, 0);
+	bus_gov.total_errors += errors;
+	if (bus_gov.backoff)
+		bus_gov.backoff--;
+
+	level = bus_gov.level;
+	if (level == GOV_MAX) {
+		if (errors >= GOV_ERR_MAX) {
+			level = GOV_DEFAULT;
+			bus_gov.backoff = GOV_ERR_BACKOFF;
+			bus_gov.err_fallbacks++;
+			PRINT_WRN(BUS_DBG, "%u bus errors, back to the default bus clock\n", errors);
+		} else if (bps < GOV_DOWN_BPS) {
+			if (++bus_gov.down_cnt >= GOV_DOWN_HOLD)
+				level = GOV_DEFAULT;
+		} else {
+			bus_gov.down_cnt = 0;
+		}
+	} else {
+		if ((bps >= GOV_UP_BPS) && !bus_gov.backoff) {
+			if (++bus_gov.up_cnt >= GOV_UP_HOLD)
+				level = GOV_MAX;
+		} else {
+			bus_gov.up_cnt = 0;
+		}
+	}
+	bus_gov_set(level);
+
+	release_bus(RELEASE_ONLY);
+
+	if (bus_gov.running)
+		schedule_delayed_work(&bus_gov_work, msecs_to_jiffies(GOV_PERIOD_MS));
+}
+
+/* start at the max clock, as the driver did before the governor */
+static void wilc_bus_gov_start(void)
+{
+	if (bus_gov.running)
+		return;
+
+	g_wlan.hif_func.hif_set_max_bus_speed();
+	bus_gov.level = GOV_MAX;
+	bus_gov.up_cnt = 0;
+	bus_gov.down_cnt = 0;
+	bus_gov.backoff = 0;
+	bus_gov.bytes = 0;
+	atomic_set(&bus_gov.errors, 0);
+	bus_gov.since = jiffies;
+	bus_gov.running = 1;
+
+	INIT_DELAYED_WORK(&bus_gov_work, bus_gov_work_fn);
+	schedule_delayed_work(&bus_gov_work, msecs_to_jiffies(GOV_PERIOD_MS));
+}
+
+static void wilc_bus_gov_stop(void)
+{
+	if (!bus_gov.running)
+		return;
+
+	bus_gov.running = 0;
+	cancel_delayed_work_sync(&bus_gov_work);
+	bus_gov.time_ms[bus_gov.level] += jiffies_to_msecs(jiffies - bus_gov.since);
+	bus_gov.since = jiffies;
+}
+
+/*
+ * Suspend keeps the SDIO host claimed until resume, a clock change from
+ * the work would block in sdio_claim_host() with the bus lock held.
+ */
+void wilc_bus_gov_suspend(void)
+{
+	bus_gov.parked = bus_gov.running;
+	wilc_bus_gov_stop();
+}
+
+void wilc_bus_gov_resume(void)
+{
+	if (!bus_gov.parked)
+		return;
+
+	bus_gov.parked = 0;
+	wilc_bus_gov_start();
+}
+
+int wilc_bus_gov_print(char *buf, int size)
+{
+	uint64_t time_ms[GOV_LEVELS];
+
+	memcpy(time_ms, bus_gov.time_ms, sizeof(time_ms));
+	if (bus_gov.running)
+		time_ms[bus_gov.level] += jiffies_to_msecs(jiffies - bus_gov.since);
+
+	return scnprintf(buf, size,
+			 "clock %s%s\n"
+			 "time default %llu ms max %llu ms\n"
+			 "up %u down %u error fallbacks %u bus errors %u\n",
+			 (bus_gov.level == GOV_MAX) ? "max" : "default",
+			 bus_gov.running ? "" : " (stopped)",
+			 (unsigned long long)time_ms[GOV_DEFAULT],
+			 (unsigned long long)time_ms[GOV_MAX],
+			 bus_gov.ups, bus_gov.downs, bus_gov.err_fallbacks,
+			 bus_gov.total_errors);
+}
+
+void wilc_bus_gov_reset(void)
+{
+	memset(bus_gov.time_ms, 0, sizeof(bus_gov.time_ms));
+	bus_gov.ups = 0;
+	bus_gov.downs = 0;
+	bus_gov.err_fallbacks = 0;
+	bus_gov.total_errors = 0;
+	bus_gov.since = jiffies;
+}
+#endif /* WILC_BUS_GOVERNOR */
+
 /********************************************
 
 	Queue
@@ -257,6 +812,7 @@ static void wilc_wlan_txq_add_to_tail(uint8_t q_num, struct txq_entry_t *tqe)
 {
 	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
 		unsigned long flags;
+	tqe->stamp = ktime_get();
 	/*Added by Amr - BugID_4720*/
 	p->os_func.os_spin_lock(p->txq_spinlock, &flags);
 
@@ -300,6 +856,7 @@ static int wilc_wlan_txq_add_to_head(uint8_t q_num, struct txq_entry_t *tqe)
 	if(p->os_func.os_wait(p->txq_add_to_head_lock, CFG_PKTS_TIMEOUT))
 		return -1;
 
+	tqe->stamp = ktime_get();
 	p->os_func.os_spin_lock(p->txq_spinlock, &flags);
 
 	//p->os_func.os_enter_cs(p->txq_lock);
@@ -770,6 +1327,34 @@ int wilc_FH_wlan_txq_add_net_pkt(void *priv, uint8_t *buffer, uint32_t buffer_si
 }
 #endif	/* WILC_FULLY_HOSTING_AP*/
 #endif /*WILC_AP_EXTERNAL_MLME*/
+/*
+ * TX backlog as seen by the background scan: returns the number of queued
+ * frames and how long the oldest of them has been waiting
+ */
+int wilc_wlan_txq_pressure(uint32_t *pu32OldestMs)
+{
+	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	ktime_t oldest = now;
+	int entries;
+	int i;
+
+	p->os_func.os_spin_lock(p->txq_spinlock, &flags);
+	entries = p->txq_entries;
+	for (i = 0; i < NQUEUES; i++) {
+		struct txq_entry_t *tqe = p->txq[i].txq_head;
+
+		if (tqe != NULL && ktime_us_delta(tqe->stamp, oldest) < 0)
+			oldest = tqe->stamp;
+	}
+	p->os_func.os_spin_unlock(p->txq_spinlock, &flags);
+
+	*pu32OldestMs = (uint32_t)(ktime_us_delta(now, oldest) / 1000);
+
+	return entries;
+}
+
 static struct txq_entry_t *wilc_wlan_txq_get_first(uint8_t q_num)
 {
 	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
@@ -828,11 +1413,28 @@ static int wilc_wlan_rxq_add(struct rxq_entry_t *rqe)
 		p->rxq_tail = rqe;
 	}
 	p->rxq_entries+=1;
+	p->rxq_inflight++;
 	PRINT_D(RX_DBG,"Number of queue entries: %d\n",p->rxq_entries);
 	p->os_func.os_leave_cs(p->rxq_lock);
 	return p->rxq_entries;
 }
 
+/**
+	Bursts still queued or being delivered by the rxq thread, a burst
+	read after them must not overtake them. Only the bottom half adds,
+	so the count can only drop between the check and the delivery.
+**/
+static int wilc_wlan_rxq_busy(void)
+{
+	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
+	int busy;
+
+	p->os_func.os_enter_cs(p->rxq_lock);
+	busy = p->rxq_inflight;
+	p->os_func.os_leave_cs(p->rxq_lock);
+	return busy;
+}
+
 static struct rxq_entry_t *wilc_wlan_rxq_remove(void)
 {
 	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
@@ -862,6 +1464,66 @@ static struct rxq_entry_t *wilc_wlan_rxq_remove(void)
 
 
 
+/*
+ * Both wake up routines give up after wake_timeout_ms. They run with
+ * hif_lock (a mutex) held, so the waits sleep instead of spinning. A
+ * chip that still doesn't come up is reported to the caller through
+ * acquire_bus(), which drops the transfer, and stays in its sleep state
+ * so the next access tries again. Wake up latencies go to a log2(usec)
+ * histogram in debugfs to help tuning the sleep policy.
+ */
+#define WAKE_HIST_BINS	16
+
+static struct {
+	uint32_t count;
+	uint32_t max;		/* usec */
+	uint64_t sum;		/* usec */
+	uint32_t timeouts;
+	uint32_t hist[WAKE_HIST_BINS];
+} wake_stats;
+
+static void chip_wakeup_record(ktime_t start)
+{
+	uint32_t usec = (uint32_t)ktime_us_delta(ktime_get(), start);
+	int bin;
+
+	wake_stats.count++;
+	wake_stats.sum += usec;
+	if (usec > wake_stats.max)
+		wake_stats.max = usec;
+	bin = fls(usec);
+	if (bin >= WAKE_HIST_BINS)
+		bin = WAKE_HIST_BINS - 1;
+	wake_stats.hist[bin]++;
+}
+
+static int chip_wakeup_failed(void)
+{
+	PRINT_ER("Chip didn't wake up within %d ms\n", wake_timeout_ms);
+	wake_stats.timeouts++;
+	return 0;
+}
+
+int wilc_wlan_wake_print(char *buf, int size)
+{
+	int res, j;
+
+	res = scnprintf(buf, size, "wake up: count %u avg %u us max %u us timeouts %u\n  hist:",
+			wake_stats.count,
+			wake_stats.count ? (uint32_t)div_u64(wake_stats.sum, wake_stats.count) : 0,
+			wake_stats.max, wake_stats.timeouts);
+	for (j = 0; j < WAKE_HIST_BINS; j++)
+		res += scnprintf(buf + res, size - res, " %u", wake_stats.hist[j]);
+	res += scnprintf(buf + res, size - res, "\n");
+
+	return res;
+}
+
+void wilc_wlan_wake_reset(void)
+{
+	memset(&wake_stats, 0, sizeof(wake_stats));
+}
+
 #ifdef WILC_OPTIMIZE_SLEEP_INT
 
 void chip_allow_sleep(void)
@@ -875,49 +1537,43 @@ void chip_allow_sleep(void)
 	g_wlan.hif_func.hif_write_reg(WILC_FROM_INTERFACE_TO_WF_REG , 0);
 }
 
-void chip_wakeup(void)
+int chip_wakeup(void)
 {
-	uint32_t reg , clk_status_reg; 
-	uint32_t trials = 0; 
+	uint32_t reg , clk_status_reg = 0; 
+	uint32_t trials; 
 	uint32_t val32;
+	ktime_t start = ktime_get();
+	unsigned long timeout = jiffies + msecs_to_jiffies(wake_timeout_ms);
 	
 	g_wlan.hif_func.hif_write_reg(WILC_FROM_INTERFACE_TO_WF_REG , 1);
-	udelay(200);
+	usleep_range(200, 300);
 	g_wlan.hif_func.hif_read_reg(WILC_WAKEUP_REG , &reg);
 	do
 	{
 		/* Set bit 1 */
 		g_wlan.hif_func.hif_write_reg(WILC_WAKEUP_REG , reg | (WILC_WAKEUP_BIT));
 
-		// Check the clock status
-		g_wlan.hif_func.hif_read_reg(WILC_CLK_STATUS_REG , &clk_status_reg);
-
-		// in case of clocks off, wait 2ms, and check it again.
-		// if still off, wait for another 2ms, for a total wait of 6ms.
-		// If still off, redo the wake up sequence
-		while( ((clk_status_reg & (WILC_CLK_STATUS_BIT)) == 0) && ((trials%3) != 0))
+		// Check the clock status, in case of clocks off, wait 2ms, and check it again.
+		// If still off after 3 checks, redo the wake up sequence
+		for (trials = 0; ; trials++)
 		{
-			/* Wait for the chip to stabilize*/
-			WILC_Sleep(2);
-
-			// Make sure chip is awake. This is an extra step that can be removed
-			// later to avoid the bus access overhead
 			g_wlan.hif_func.hif_read_reg(WILC_CLK_STATUS_REG , &clk_status_reg);
-			if((clk_status_reg & (WILC_CLK_STATUS_BIT)) == 0)
-			{
-				wilc_debug(N_ERR, "clocks still OFF. Wake up failed\n");
-			}
-			
-			trials++;
+			if ((clk_status_reg & (WILC_CLK_STATUS_BIT)) || (trials == 2))
+				break;
+			/* Wait for the chip to stabilize*/
+			usleep_range(2000, 2500);
 		}
 		
-		// in case of failure, Reset the wakeup bit to introduce a new edge on the next loop
-		if((clk_status_reg & (WILC_CLK_STATUS_BIT)) == 0)
-		{
-			// Reset bit 0
-			g_wlan.hif_func.hif_write_reg(WILC_WAKEUP_REG , reg & (~ (WILC_WAKEUP_BIT)));
-		}
-	}while((clk_status_reg & (WILC_CLK_STATUS_BIT)) == 0);
+		if (clk_status_reg & (WILC_CLK_STATUS_BIT))
+			break;
+
+		wilc_debug(N_ERR, "clocks still OFF. Wake up failed\n");
+		// Reset bit 1 to introduce a new edge on the next loop
+		g_wlan.hif_func.hif_write_reg(WILC_WAKEUP_REG , reg & (~ (WILC_WAKEUP_BIT)));
+	}while(time_before(jiffies, timeout));
+
+	if ((clk_status_reg & (WILC_CLK_STATUS_BIT)) == 0)
+		return chip_wakeup_failed();
 
 	if(genuChipPSstate == CHIP_SLEEPING_MANUAL)
 	{
@@ -934,11 +1590,17 @@ void chip_wakeup(void)
 		}
 	}
 	genuChipPSstate = CHIP_WAKEDUP;
+	chip_wakeup_record(start);
+	return 1;
 }
 #else
-INLINE void chip_wakeup(void)
+INLINE int chip_wakeup(void)
 {
-	uint32_t reg, trials=0;
+	uint32_t reg, trials;
+	int awake = 0;
+	ktime_t start = ktime_get();
+	unsigned long timeout = jiffies + msecs_to_jiffies(wake_timeout_ms);
+
 	do
 	{
 		if ((g_wlan.io_func.io_type & 0x1) == HIF_SPI)
@@ -962,23 +1624,27 @@ INLINE void chip_wakeup(void)
 			 g_wlan.hif_func.hif_write_reg(0xf0, reg  & ~(1 << 0));
 		}
 
-		do
+		// The chip id reads back as 0 until the chip is up, check it 3 times
+		// 3ms apart before toggling the wake bit again
+		for (trials = 0; trials < 3; trials++)
 		{
 			/* Wait for the chip to stabilize*/
-//			WILC_Sleep(2);
-			mdelay(3);
+			usleep_range(3000, 3500);
 
-			// Make sure chip is awake. This is an extra step that can be removed
-			// later to avoid the bus access overhead
-			if((wilc_get_chipid(WILC_TRUE) == 0))
-			{
-				wilc_debug(N_ERR, "Couldn't read chip id. Wake up failed\n");
+			if (wilc_get_chipid(WILC_TRUE) != 0) {
+				awake = 1;
+				break;
 			}
-		}while((wilc_get_chipid(WILC_TRUE) == 0) && ((++trials %3) == 0));
+			wilc_debug(N_ERR, "Couldn't read chip id. Wake up failed\n");
+		}
+	}while(!awake && time_before(jiffies, timeout));
 
-	}while(wilc_get_chipid(WILC_TRUE) == 0);
+	if (!awake)
+		return chip_wakeup_failed();
 
 	genuChipPSstate = CHIP_WAKEDUP;
+	chip_wakeup_record(start);
+	return 1;
 }
 #endif
 void chip_sleep_manually(WILC_Uint32 u32SleepTime)
@@ -1022,25 +1688,18 @@ void host_sleep_notify(void)
 	Tx, Rx queue handle functions
 
 ********************************************/
-static uint8_t inline ac_classify(struct txq_entry_t * tqe)
+static inline uint8_t eth_frame_to_ac(uint8_t *buffer)
 {
 	uint8_t *eth_hdr_ptr;
-	uint8_t * buffer=tqe->buffer;
 	unsigned short h_proto;
 	uint8_t ac;
-	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
-	unsigned long flags;
-	p->os_func.os_spin_lock(p->txq_spinlock, &flags);
 	eth_hdr_ptr = &buffer[0];
 	h_proto = ntohs(*((unsigned short*)&eth_hdr_ptr[12]));
 	if(h_proto == 0x0800) 
 	{ /* IP */
 		uint8_t * ip_hdr_ptr;
-		uint8_t protocol;
-		uint8_t * tcp_hdr_ptr;
-		uint32_t IHL,DSCP ;
+		uint32_t DSCP ;
 		ip_hdr_ptr = &buffer[ETHERNET_HDR_LEN];
-		IHL=(ip_hdr_ptr[0]&0xf)<<2;
 		DSCP=(ip_hdr_ptr[1]&0xfc);
 		switch (DSCP)
 		{
@@ -1078,7 +1737,16 @@ static uint8_t inline ac_classify(struct txq_entry_t * tqe)
 	{
 		ac  = AC_BE_Q;
 	}
-	
+	return ac;
+}
+
+static uint8_t inline ac_classify(struct txq_entry_t * tqe)
+{
+	uint8_t ac;
+	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
+	unsigned long flags;
+	p->os_func.os_spin_lock(p->txq_spinlock, &flags);
+	ac = eth_frame_to_ac(tqe->buffer);
 	tqe->q_num = ac;
 	p->os_func.os_spin_unlock(p->txq_spinlock, &flags);
 	return ac;
@@ -1167,6 +1835,10 @@ static int wilc_wlan_handle_txq(uint32_t* pu32TxqCount)
 	uint32_t vmm_table[WILC_VMM_TBL_SIZE];
 	static uint8_t ac_fw_actual_pkt_count[NQUEUES] = {0, 0, 0, 0};
 	uint8_t ac_pkt_num_to_chip[NQUEUES] = {0, 0, 0, 0};
+#ifdef WILC_PKT_LATENCY
+	ktime_t lat_now;
+	int lat_cnt = 0;
+#endif
 	
 	p->txq_exit = 0;
 	if(p->txq_entries) {
@@ -1221,7 +1893,7 @@ static int wilc_wlan_handle_txq(uint32_t* pu32TxqCount)
 								if (vmm_sz & 0x3) {		/* has to be word aligned */
 									vmm_sz = (vmm_sz + 4) & ~0x3;
 								}
-								if((sum+vmm_sz) > p->tx_buffer_size) {
+								if((sum+vmm_sz) > (p->tx_buffer_size - WILC_BUS_XFER_PAD)) {
 									is_max_capacity_reached = 1;	
 									break;
 								}
@@ -1261,7 +1933,11 @@ static int wilc_wlan_handle_txq(uint32_t* pu32TxqCount)
 				PRINT_D(TX_DBG,"Mark the last entry in VMM table - number of previous entries = %d\n",i);
 				vmm_table[i] = 0x0;	/* mark the last element to 0 */
 			}
-			acquire_bus(ACQUIRE_AND_WAKEUP);
+			if (!acquire_bus(ACQUIRE_AND_WAKEUP)) {
+				/* chip asleep, leave the packets queued */
+				ret = 0;
+				goto _end_;
+			}
 			counter = 0;
 			do {
 
@@ -1384,6 +2060,9 @@ static int wilc_wlan_handle_txq(uint32_t* pu32TxqCount)
 				ret = WILC_TX_ERR_NO_BUF;
 				goto _end_;
 			}
+#ifdef WILC_PKT_LATENCY
+			lat_now = ktime_get();
+#endif
 
 			/* since copying data into txb takes some time, then
 			allow the bus lock to be released let the RX task go. */
@@ -1452,6 +2131,14 @@ static int wilc_wlan_handle_txq(uint32_t* pu32TxqCount)
 					memcpy(&txb[offset+buffer_offset], tqe->buffer, tqe->buffer_size);
 					offset += vmm_sz;
 					i++;
+#ifdef WILC_PKT_LATENCY
+					if (tqe->type == WILC_NET_PKT) {
+						wilc_lat_record(LAT_TX_QUEUE, tqe->q_num, tqe->stamp, lat_now);
+						lat_tx_stamp[lat_cnt] = tqe->stamp;
+						lat_tx_ac[lat_cnt] = tqe->q_num;
+						lat_cnt++;
+					}
+#endif
 					tqe->status = 1;				/* mark the packet send */
 					if (tqe->tx_complete_func)
 						tqe->tx_complete_func(tqe->priv, tqe->status);
@@ -1475,7 +2162,11 @@ static int wilc_wlan_handle_txq(uint32_t* pu32TxqCount)
 			/**
 				lock the bus
 			**/
-			acquire_bus(ACQUIRE_AND_WAKEUP);
+			if (!acquire_bus(ACQUIRE_AND_WAKEUP)) {
+				wilc_debug(N_ERR, "[wilc txq]: chip didn't wake up, drop the tx buffer...\n");
+				ret = 0;
+				goto _end_;
+			}
 
 			ret = p->hif_func.hif_clear_int_ext(ENABLE_TX_VMM);
 			if (!ret) {
@@ -1491,6 +2182,14 @@ static int wilc_wlan_handle_txq(uint32_t* pu32TxqCount)
 				wilc_debug(N_ERR, "[wilc txq]: fail can't block tx ext...\n");
 				goto _end_;
 			}
+#ifdef WILC_BUS_GOVERNOR
+			wilc_bus_gov_account(offset);
+#endif
+#ifdef WILC_PKT_LATENCY
+			lat_now = ktime_get();
+			for (i = 0; i < lat_cnt; i++)
+				wilc_lat_record(LAT_TX_TOTAL, lat_tx_ac[i], lat_tx_stamp[i], lat_now);
+#endif
 
 _end_:
 
@@ -1509,126 +2208,173 @@ _end_:
 	return ret;
 }
 
-static void wilc_wlan_handle_rxq(void)
+/**
+	Hand the frames of one RX burst to the network and config layers,
+	returns 1 if a data frame went up
+**/
+static int wilc_wlan_rx_burst(struct rxq_entry_t *rqe)
 {
 	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
-	int offset = 0, size, has_packet = 0;
-	uint8_t *buffer;
-	struct rxq_entry_t *rqe;
+	uint8_t *buffer = rqe->buffer;
+	int size = rqe->buffer_size;
+	int offset = 0, has_packet = 0;
 
-	p->rxq_exit = 0;
+	do {
+		uint32_t header;
+		uint32_t pkt_len, pkt_offset, tp_len;
+		int is_cfg_packet;
+		PRINT_D(RX_DBG,"In the 2nd do-while\n");
+		memcpy(&header, &buffer[offset], 4);
+#ifdef BIG_ENDIAN
+		header = BYTE_SWAP(header);
+#endif
+		PRINT_D(RX_DBG,"Header = %04x - Offset = %d\n",header,offset);
 
 
 
+		is_cfg_packet = (header >> 31) & 0x1;
+		pkt_offset = (header >> 22) & 0x1ff;
+		tp_len = (header >> 11)&0x7ff;
+		pkt_len = header & 0x7ff;
 
-	do {
-		if (p->quit){
-			PRINT_D(RX_DBG,"exit 1st do-while due to Clean_UP function \n");
-			p->os_func.os_signal(p->cfg_wait);
-			break;
-		}
-		rqe = wilc_wlan_rxq_remove();
-		if (rqe == NULL){
-			PRINT_D(RX_DBG,"nothing in the queue - exit 1st do-while\n");
+		if (pkt_len == 0 || tp_len == 0) {
+			wilc_debug(N_RXQ, "[wilc rxq]: data corrupt, packet len or tp_len is 0 [%d][%d]\n", pkt_len, tp_len);
 			break;
 		}
-		buffer = rqe->buffer;
-		size = rqe->buffer_size;
-		PRINT_D(RX_DBG,"rxQ entery Size = %d - Address = %p\n",size,buffer);
-		offset = 0;
 
+/*bug 3887: [AP] Allow Management frames to be passed to the host*/
+		#if defined(WILC_AP_EXTERNAL_MLME) || defined(WILC_P2P)
+		#define IS_MANAGMEMENT 				0x100
+		#define IS_MANAGMEMENT_CALLBACK 		0x080
+		#define IS_MGMT_STATUS_SUCCES			0x040
 
 
-		do {
-			uint32_t header;
-			uint32_t pkt_len, pkt_offset, tp_len;
-			int is_cfg_packet;
-			PRINT_D(RX_DBG,"In the 2nd do-while\n");
-			memcpy(&header, &buffer[offset], 4);
-#ifdef BIG_ENDIAN
-			header = BYTE_SWAP(header);
+		if(pkt_offset & IS_MANAGMEMENT)
+			{
+				//reset mgmt indicator bit, to use pkt_offeset in furthur calculations
+				pkt_offset &= ~(IS_MANAGMEMENT | IS_MANAGMEMENT_CALLBACK | IS_MGMT_STATUS_SUCCES);
+
+#ifdef USE_WIRELESS
+				WILC_WFI_mgmt_rx(&buffer[offset+HOST_HDR_OFFSET],pkt_len);
+
 #endif
-			PRINT_D(RX_DBG,"Header = %04x - Offset = %d\n",header,offset);
 
+			}
 
+		//BUG4530 fix
+		else
+		#endif
+	{
+		//wilc_debug(N_RXQ, "[wilc rxq]: packet, tp len(%d), len (%d), offset (%d), cfg (%d)\n", tp_len, pkt_len, pkt_offset, is_cfg_packet);
 
-			is_cfg_packet = (header >> 31) & 0x1;
-			pkt_offset = (header >> 22) & 0x1ff;
-			tp_len = (header >> 11)&0x7ff;
-			pkt_len = header & 0x7ff;
+		if (!is_cfg_packet) {
 
-			if (pkt_len == 0 || tp_len == 0) {
-				wilc_debug(N_RXQ, "[wilc rxq]: data corrupt, packet len or tp_len is 0 [%d][%d]\n", pkt_len, tp_len);
-				break;
+			if (p->net_func.rx_indicate) {
+				if (pkt_len > 0) {
+					p->net_func.rx_indicate(&buffer[offset], pkt_len,pkt_offset);
+					has_packet = 1;
+#ifdef WILC_PKT_LATENCY
+					wilc_lat_record(LAT_RX, eth_frame_to_ac(&buffer[offset + pkt_offset]), rqe->stamp, ktime_get());
+#endif
+				}
 			}
+		} else {
+			wilc_cfg_rsp_t rsp;
 
-/*bug 3887: [AP] Allow Management frames to be passed to the host*/
-			#if defined(WILC_AP_EXTERNAL_MLME) || defined(WILC_P2P)
-			#define IS_MANAGMEMENT 				0x100
-			#define IS_MANAGMEMENT_CALLBACK 		0x080
-			#define IS_MGMT_STATUS_SUCCES			0x040
 
 
-			if(pkt_offset & IS_MANAGMEMENT)
-				{
-					//reset mgmt indicator bit, to use pkt_offeset in furthur calculations
-					pkt_offset &= ~(IS_MANAGMEMENT | IS_MANAGMEMENT_CALLBACK | IS_MGMT_STATUS_SUCCES);
+			p->cif_func.rx_indicate(&buffer[pkt_offset+offset], pkt_len, &rsp);
+			if (rsp.type == WILC_CFG_RSP) {
+				/**
+					wake up the waiting task...
+				**/
+			PRINT_D(RX_DBG,"p->cfg_seq_no = %d - rsp.seq_no = %d\n",p->cfg_seq_no,rsp.seq_no);
+				if (p->cfg_seq_no == rsp.seq_no) {
+					p->os_func.os_signal(p->cfg_wait);
+				}
+				//p->os_func.os_signal(p->cfg_wait);
+			} else if (rsp.type == WILC_CFG_RSP_STATUS) {
+				/**
+					Call back to indicate status...
+				**/
+				if (p->indicate_func.mac_indicate) {
+					p->indicate_func.mac_indicate(WILC_MAC_INDICATE_STATUS);
+				}
 
-#ifdef USE_WIRELESS
-					WILC_WFI_mgmt_rx(&buffer[offset+HOST_HDR_OFFSET],pkt_len);
+			} else if (rsp.type == WILC_CFG_RSP_SCAN) {
+				if (p->indicate_func.mac_indicate)
+					p->indicate_func.mac_indicate(WILC_MAC_INDICATE_SCAN);
+			}
+		}
+	}
+		offset += tp_len;
+		if (offset >= size)
+			break;
+	} while (1);
 
-#endif
+	return has_packet;
+}
 
-				}
+/**
+	Config responses wake up and call back into the host interface,
+	bursts carrying one keep going through the rx queue
+**/
+static int wilc_wlan_rx_has_cfg(uint8_t *buffer, uint32_t size)
+{
+	uint32_t offset = 0;
 
-			//BUG4530 fix
-			else
-			#endif
-		{
-			//wilc_debug(N_RXQ, "[wilc rxq]: packet, tp len(%d), len (%d), offset (%d), cfg (%d)\n", tp_len, pkt_len, pkt_offset, is_cfg_packet);
+	while (offset < size) {
+		uint32_t header, tp_len;
 
-			if (!is_cfg_packet) {
+		memcpy(&header, &buffer[offset], 4);
+#ifdef BIG_ENDIAN
+		header = BYTE_SWAP(header);
+#endif
+		tp_len = (header >> 11) & 0x7ff;
+		/* corrupt burst, let the queue path report it */
+		if ((tp_len == 0) || ((header >> 31) & 0x1))
+			return 1;
+		offset += tp_len;
+	}
 
-				if (p->net_func.rx_indicate) {
-					if (pkt_len > 0) {
-						p->net_func.rx_indicate(&buffer[offset], pkt_len,pkt_offset);
-						has_packet = 1;
-					}
-				}
-			} else {
-				wilc_cfg_rsp_t rsp;
+	return 0;
+}
+
+static void wilc_wlan_handle_rxq(void)
+{
+	wilc_wlan_dev_t *p = (wilc_wlan_dev_t *)&g_wlan;
+	int size, has_packet = 0;
+	uint8_t *buffer;
+	struct rxq_entry_t *rqe;
 
+	p->rxq_exit = 0;
 
 
-				p->cif_func.rx_indicate(&buffer[pkt_offset+offset], pkt_len, &rsp);
-				if (rsp.type == WILC_CFG_RSP) {
-					/**
-						wake up the waiting task...
-					**/
-				PRINT_D(RX_DBG,"p->cfg_seq_no = %d - rsp.seq_no = %d\n",p->cfg_seq_no,rsp.seq_no);
-					if (p->cfg_seq_no == rsp.seq_no) {
-						p->os_func.os_signal(p->cfg_wait);
-					}
-					//p->os_func.os_signal(p->cfg_wait);
-				} else if (rsp.type == WILC_CFG_RSP_STATUS) {
-					/**
-						Call back to indicate status...
-					**/
-					if (p->indicate_func.mac_indicate) {
-						p->indicate_func.mac_indicate(WILC_MAC_INDICATE_STATUS);
-					}
 
-				} else if (rsp.type == WILC_CFG_RSP_SCAN) {
-					if (p->indicate_func.mac_indicate)
-						p->indicate_func.mac_indicate(WILC_MAC_INDICATE_SCAN);
-				}
-			}
+
+	do {
+		if (p->quit){
+			PRINT_D(RX_DBG,"exit 1st do-while due to Clean_UP function \n");
+			p->os_func.os_signal(p->cfg_wait);
+			break;
 		}
-			offset += tp_len;
-			if (offset >= size)
-				break;
-		} while (1);
+		rqe = wilc_wlan_rxq_remove();
+		if (rqe == NULL){
+			PRINT_D(RX_DBG,"nothing in the queue - exit 1st do-while\n");
+			break;
+		}
+		buffer = rqe->buffer;
+		size = rqe->buffer_size;
+		PRINT_D(RX_DBG,"rxQ entery Size = %d - Address = %p\n",size,buffer);
+
+
+
+		if (wilc_wlan_rx_burst(rqe))
+			has_packet = 1;
 
+		p->os_func.os_enter_cs(p->rxq_lock);
+		p->rxq_inflight--;
+		p->os_func.os_leave_cs(p->rxq_lock);
 
 #ifndef MEMORY_STATIC
 		if (buffer != NULL)
@@ -1713,7 +2459,7 @@ static void wilc_wlan_handle_isr_ext(uint32_t int_status)
 
 	if (size > 0) {
 #ifdef MEMORY_STATIC
-		if (p->rx_buffer_size - offset < size)
+		if (p->rx_buffer_size - offset < size + WILC_BUS_XFER_PAD)
 			offset = 0;
 
 		if(p->rx_buffer)
@@ -1725,7 +2471,7 @@ static void wilc_wlan_handle_isr_ext(uint32_t int_status)
 		}
 
 #else
-		buffer = p->os_func.os_malloc(size);
+		buffer = p->os_func.os_malloc(size + WILC_BUS_XFER_PAD);
 		if (buffer == NULL) {
 			wilc_debug(N_ERR, "[wilc isr]: fail alloc host memory...drop the packets (%d)\n", size);
 			WILC_Sleep(100);
@@ -1748,6 +2494,9 @@ static void wilc_wlan_handle_isr_ext(uint32_t int_status)
 			wilc_debug(N_ERR, "[wilc isr]: fail block rx...\n");
 			goto _end_;
 		}
+#ifdef WILC_BUS_GOVERNOR
+		wilc_bus_gov_account(size);
+#endif
 _end_:
 
 
@@ -1756,16 +2505,38 @@ _end_:
 			offset += size;
 			p->rx_buffer_offset = offset;
 #endif
-			/**
-				add to rx queue
-			**/
-			rqe = (struct rxq_entry_t *)p->os_func.os_malloc(sizeof(struct rxq_entry_t));
-			if (rqe != NULL) {
-				rqe->buffer = buffer;
-				rqe->buffer_size = size;
-				PRINT_D(RX_DBG,"rxq entery Size= %d - Address = %p\n",rqe->buffer_size,rqe->buffer);
-				wilc_wlan_rxq_add(rqe);
-				p->os_func.os_signal(p->rxq_wait);
+			if (rx_direct && !p->quit && !wilc_wlan_rx_has_cfg(buffer, size) &&
+			    !wilc_wlan_rxq_busy()) {
+				struct rxq_entry_t rx;
+
+				/**
+					deliver right away, no rx queue hop
+				**/
+				rx.buffer = buffer;
+				rx.buffer_size = size;
+#ifdef WILC_PKT_LATENCY
+				rx.stamp = lat_rx_stamp;
+#endif
+				if (wilc_wlan_rx_burst(&rx) && p->net_func.rx_complete)
+					p->net_func.rx_complete();
+#ifndef MEMORY_STATIC
+				p->os_func.os_free(buffer);
+#endif
+			} else {
+				/**
+					add to rx queue
+				**/
+				rqe = (struct rxq_entry_t *)p->os_func.os_malloc(sizeof(struct rxq_entry_t));
+				if (rqe != NULL) {
+					rqe->buffer = buffer;
+					rqe->buffer_size = size;
+#ifdef WILC_PKT_LATENCY
+					rqe->stamp = lat_rx_stamp;
+#endif
+					PRINT_D(RX_DBG,"rxq entery Size= %d - Address = %p\n",rqe->buffer_size,rqe->buffer);
+					wilc_wlan_rxq_add(rqe);
+					p->os_func.os_signal(p->rxq_wait);
+				}
 			}
 		} else {
 #ifndef MEMORY_STATIC
@@ -1783,7 +2554,16 @@ void wilc_handle_isr(void)
 {
 	uint32_t int_status;
 
-	acquire_bus(ACQUIRE_AND_WAKEUP);
+#ifdef WILC_PKT_LATENCY
+	lat_rx_stamp = ktime_get();
+#endif
+	if (!acquire_bus(ACQUIRE_AND_WAKEUP)) {
+#if ((!defined WILC_SDIO) || (defined WILC_SDIO_IRQ_GPIO))
+		linux_wlan_enable_irq();
+#endif
+		release_bus(RELEASE_ALLOW_SLEEP);
+		return;
+	}
 	g_wlan.hif_func.hif_read_int(&int_status);
 
 	if(int_status & PLL_INT_EXT){
@@ -2131,6 +2911,10 @@ static void wilc_wlan_cleanup(void)
 	int ret;
 	uint8_t ac;
 
+#ifdef WILC_BUS_GOVERNOR
+	/* not every platform goes through wilc_bus_set_default_speed() */
+	wilc_bus_gov_stop();
+#endif
 	p->quit = 1;
 	/**
 		wait for queue end
@@ -2168,6 +2952,7 @@ static void wilc_wlan_cleanup(void)
 #endif
 		p->os_func.os_free((void *)rqe);
 	} while (1);
+	p->rxq_inflight = 0;
 
 	/**
 		clean up buffer
@@ -2341,12 +3126,20 @@ static int wilc_wlan_cfg_get_val(uint32_t wid, uint8_t *buffer, uint32_t buffer_
 
 void wilc_bus_set_max_speed(void){
 
+#ifdef WILC_BUS_GOVERNOR
+	/* The governor picks the bus speed from now on.  */
+	wilc_bus_gov_start();
+#else
 	/* Increase bus speed to max possible.  */
 	g_wlan.hif_func.hif_set_max_bus_speed();
+#endif
 }
 
 void wilc_bus_set_default_speed(void){
 
+#ifdef WILC_BUS_GOVERNOR
+	wilc_bus_gov_stop();
+#endif
 	/* Restore bus speed to default.  */
 	g_wlan.hif_func.hif_set_default_bus_speed();
 }
@@ -2568,6 +3361,9 @@ int wilc_wlan_init(wilc_wlan_inp_t *inp, wilc_wlan_oup_t *oup)
 		goto _fail_;
 	}
 	}
+#ifdef WILC_BUS_TRACE
+	wilc_bus_trace_install(&g_wlan.hif_func);
+#endif
 
 	/***
 		mac interface init
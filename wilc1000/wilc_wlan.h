@@ -2,6 +2,10 @@
 #define WILC_WLAN_H
 
 #include "wilc_type.h"
+#include <linux/ktime.h>
+#ifdef WILC_BUS_GOVERNOR
+#include <linux/workqueue.h>
+#endif
 
 
 #define ISWILC1000(id)   (((id & 0xfffff000) == 0x100000) ? 1 : 0) 
@@ -80,6 +84,13 @@
 #define WILC_INTR_STATUS (WILC_INTR_REG_BASE+0x40)
 
 #define WILC_VMM_TBL_SIZE 64
+
+/* room kept past the end of TX/RX bus transfers, SDIO may pad them to its 512 byte func 1 block */
+#ifdef WILC_SDIO
+#define WILC_BUS_XFER_PAD 512
+#else
+#define WILC_BUS_XFER_PAD 0
+#endif
 #define WILC_VMM_TX_TBL_BASE (0x150400)
 #define WILC_VMM_RX_TBL_BASE (0x150500)
 
@@ -275,12 +286,16 @@ struct txq_entry_t {
 	void *priv;
 	int status;
 	void (*tx_complete_func)(void *, int);
+	ktime_t stamp;		/* time it was queued */
 };
 
 struct rxq_entry_t  {
 	struct rxq_entry_t *next;
 	uint8_t *buffer;
 	int buffer_size;
+#ifdef WILC_PKT_LATENCY
+	ktime_t stamp;		/* time of the interrupt it was read in */
+#endif
 };
 
 /********************************************
@@ -343,6 +358,11 @@ typedef struct {
 #ifdef USE_ANTNENNA_SWITCHING
 uint32_t wilc_switch_current_antenna(unsigned char antenna_num);
 #endif
+#ifdef WILC_BUS_GOVERNOR
+void wilc_bus_gov_error(void);
+#else
+#define wilc_bus_gov_error()
+#endif
 
 #define NQUEUES 4
 #define VO_AC_COUNT_POS		25
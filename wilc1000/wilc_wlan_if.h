@@ -114,12 +114,18 @@ typedef struct {
 			int (*sdio_cmd53)(sdio_cmd53_t *);
 			int (*sdio_set_max_speed)(void);
 			int (*sdio_set_default_speed)(void);
+			void (*sdio_claim)(void);
+			void (*sdio_release)(void);
+			int (*sdio_max_block_size)(void);
 		} sdio;
 		struct {
 			int (*spi_max_speed)(void);
+			int (*spi_default_speed)(void);
 			int (*spi_tx)(uint8_t *, uint32_t);
 			int (*spi_rx)(uint8_t *, uint32_t);
 			int (*spi_trx)(uint8_t *, uint8_t *, uint32_t);
+			int (*spi_tx_async)(uint8_t *, uint32_t, uint8_t *, uint32_t, uint8_t *, uint32_t);
+			int (*spi_tx_async_flush)(void);
 		} spi;
 	} u;
 } wilc_wlan_io_func_t;